@@ -0,0 +1,24 @@
+#include <rest.hpp>
+#include <rest/ssl_server.hpp>
+#include <iostream>
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <certificate.pem> <key.pem>\n";
+        return 1;
+    }
+
+    rest::ssl::context ctx(rest::ssl::context::tls_server);
+    ctx.use_certificate_chain_file(argv[1]);
+    ctx.use_private_key_file(argv[2], rest::ssl::context::pem);
+
+    boost::asio::io_context ioc(1);
+    rest::ssl_server app(ioc, ctx);
+
+    app.get("/", [](const rest::request&, rest::response& resp) {
+        resp.send("Hello World!");
+    });
+
+    app.listen(8443);
+    ioc.run();
+}
@@ -0,0 +1,91 @@
+# Packs a directory into a bundle served by rest::static_bundle.
+#
+# Layout (little endian):
+#   "RSTBNDL1"                      magic
+#   uint32 count, uint32 reserved
+#   count entries of
+#     uint64 path offset, uint32 path size, uint32 reserved
+#     uint64 data offset, uint64 data size
+#     uint64 gzip offset, uint64 gzip size (0 if not compressed)
+#     uint64 etag
+#   paths and contents
+
+import argparse
+import gzip
+import hashlib
+import os
+import struct
+
+
+parser = argparse.ArgumentParser(
+    description = 'Packs files of a directory into a static bundle')
+parser.add_argument('directory', help = 'directory to pack')
+parser.add_argument('--output', '-o', default = 'static.bundle',
+    help = 'path to output file', metavar = 'file')
+parser.add_argument('--no-gzip', action = 'store_true',
+    help = 'do not add precompressed content')
+args = parser.parse_args()
+
+# Already compressed formats are not worth compressing again
+compressed = { '.gif', '.gz', '.jpe', '.jpeg', '.jpg', '.mp4', '.png',
+    '.svgz', '.webp', '.woff', '.woff2', '.zip' }
+
+header_size = 16
+entry_size = 56
+
+
+def collect(root):
+    files = []
+    for dirpath, dirnames, filenames in os.walk(root):
+        dirnames.sort()
+        for name in sorted(filenames):
+            full = os.path.join(dirpath, name)
+            rel = os.path.relpath(full, root).replace(os.sep, '/')
+            files.append(('/' + rel, full))
+    return files
+
+
+def compress(path, data):
+    if args.no_gzip or os.path.splitext(path)[1].lower() in compressed:
+        return b''
+    gz = gzip.compress(data, compresslevel = 9, mtime = 0)
+    # Keep only if it saves at least a tenth
+    return gz if len(gz) < len(data) * 0.9 else b''
+
+
+files = collect(args.directory)
+entries = []
+blobs = []
+offset = header_size + entry_size * len(files)
+
+
+def add_blob(data):
+    global offset
+    start = offset
+    blobs.append(data)
+    offset += len(data)
+    return start
+
+
+for path, full in files:
+    with open(full, 'rb') as f:
+        data = f.read()
+    name = path.encode('utf-8')
+    gz = compress(path, data)
+    etag = struct.unpack('<Q', hashlib.sha1(data).digest()[:8])[0]
+
+    path_offset = add_blob(name)
+    data_offset = add_blob(data)
+    gzip_offset = add_blob(gz) if gz else 0
+    entries.append(struct.pack('<QIIQQQQQ', path_offset, len(name), 0,
+        data_offset, len(data), gzip_offset, len(gz), etag))
+
+with open(args.output, 'wb') as out:
+    out.write(b'RSTBNDL1')
+    out.write(struct.pack('<II', len(entries), 0))
+    for e in entries:
+        out.write(e)
+    for b in blobs:
+        out.write(b)
+
+print('{}: {} files, {} bytes'.format(args.output, len(entries), offset))
@@ -22,15 +22,28 @@
 #define REST_HPP
 
 #include <rest/forward.hpp>
+#include <rest/body_parser.hpp>
+#include <rest/cache.hpp>
+#include <rest/coroutine.hpp>
 #include <rest/error.hpp>
+#include <rest/event_stream.hpp>
+#include <rest/hpack.hpp>
+#include <rest/http2.hpp>
+#include <rest/json.hpp>
+#include <rest/locals.hpp>
 #include <rest/mime_type.hpp>
 #include <rest/next.hpp>
+#include <rest/offload.hpp>
 #include <rest/path.hpp>
+#include <rest/rate_limit.hpp>
 #include <rest/router.hpp>
 #include <rest/request.hpp>
 #include <rest/response.hpp>
 #include <rest/server.hpp>
+#include <rest/shared_buffer.hpp>
+#include <rest/static_bundle.hpp>
 #include <rest/static_files.hpp>
+#include <rest/websocket.hpp>
 
 #endif // REST_HPP
 
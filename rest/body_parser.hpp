@@ -0,0 +1,178 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef REST_BODY_PARSER_HPP
+#define REST_BODY_PARSER_HPP
+
+#include <rest/router.hpp>
+
+#include <algorithm>
+
+namespace rest {
+
+    struct json_options {
+        // Maximum body size, larger is responded with 413 Payload Too Large
+        size_t limit = 100 * 1024;
+
+        // Maximum nesting of arrays and objects
+        unsigned max_depth = 64;
+
+        // Media type of requests to parse
+        boost::string_view type { "application/json" };
+    };
+
+
+    // Validates JSON request body and makes it available as
+    // request::json(). Values are decoded on access, see json_value.
+    struct json {
+    private:
+        const json_options opt;
+
+    public:
+        json(json_options options = { }) noexcept
+        : opt(std::move(options))
+        { }
+
+        void operator()(const request& req, response&, next& n) const
+        {
+            if (!req.is(opt.type) || req.message().body().size() == 0) {
+                n();
+                return;
+            }
+            if (req.message().body().size() > opt.limit) {
+                n(error(http::status::payload_too_large));
+                return;
+            }
+
+            auto body = req.body();
+            auto value = json_value::parse(
+                { static_cast<const char*>(body.data()), body.size() }, opt.max_depth);
+            if (!value) {
+                n(error(http::status::bad_request, "Invalid JSON"));
+                return;
+            }
+            req.json() = value;
+            n();
+        }
+    };
+
+
+    struct urlencoded_options {
+        // Maximum body size, larger is responded with 413 Payload Too Large
+        size_t limit = 100 * 1024;
+
+        // Maximum number of fields, more is responded with 413
+        size_t parameter_limit = 1000;
+
+        // Media type of requests to parse
+        boost::string_view type { "application/x-www-form-urlencoded" };
+    };
+
+
+    // Parses form fields of request body into request::form(). Fields
+    // are decoded in place, names and values refer to the body.
+    struct urlencoded {
+    private:
+        const urlencoded_options opt;
+
+        static int hex(char c) noexcept {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            c |= 0x20;
+            return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        }
+
+        // Decode range in place, return end of decoded
+        static char* decode(char* first, char* last) noexcept
+        {
+            auto out = first;
+            for (auto p = first; p != last; ++p) {
+                int hi, lo;
+                if (*p == '+')
+                    *out++ = ' ';
+                else if (*p == '%' && last - p > 2 &&
+                    (hi = hex(p[1])) >= 0 && (lo = hex(p[2])) >= 0)
+                {
+                    *out++ = char(hi << 4 | lo);
+                    p += 2;
+                }
+                else
+                    *out++ = *p;
+            }
+            return out;
+        }
+
+    public:
+        urlencoded(urlencoded_options options = { }) noexcept
+        : opt(std::move(options))
+        { }
+
+        void operator()(const request& req, response&, next& n) const
+        {
+            if (!req.is(opt.type) || req.message().body().size() == 0) {
+                n();
+                return;
+            }
+            if (req.message().body().size() > opt.limit) {
+                n(error(http::status::payload_too_large));
+                return;
+            }
+
+            auto body = req.body();
+            auto first = static_cast<char*>(body.data());
+            auto last = first + body.size();
+
+            // Names are null terminated in place of '=' or '&'. If the
+            // last field has neither, terminate by copy of body.
+            auto tail = std::find(
+                std::reverse_iterator<char*>(last),
+                std::reverse_iterator<char*>(first), '&').base();
+            if (tail != last && std::find(tail, last, '=') == last) {
+                body = req.body(true);
+                first = static_cast<char*>(body.data());
+                last = first + body.size();
+            }
+
+            auto& form = req.form();
+            size_t count = 0;
+            for (auto p = first; p != last; ) {
+                auto amp = std::find(p, last, '&');
+                if (amp != p) {
+                    if (++count > opt.parameter_limit) {
+                        form.clear();
+                        n(error(http::status::payload_too_large, "Too many parameters"));
+                        return;
+                    }
+                    auto eq = std::find(p, amp, '=');
+                    boost::string_view value;
+                    if (eq != amp)
+                        value = { eq + 1, size_t(decode(eq + 1, amp) - eq - 1) };
+                    *decode(p, eq) = 0;
+                    form.emplace(p, value);
+                }
+                p = amp == last ? last : amp + 1;
+            }
+            n();
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_BODY_PARSER_HPP
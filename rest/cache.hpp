@@ -0,0 +1,257 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_CACHE_HPP
+#define REST_CACHE_HPP
+
+#include <rest/router.hpp>
+
+#include <boost/beast/core/string.hpp>
+#include <boost/functional/hash.hpp>
+#include <algorithm>
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+namespace rest {
+
+    struct cache_options {
+        // Time for a response to stay in cache
+        std::chrono::steady_clock::duration ttl = std::chrono::seconds(60);
+
+        // Maximum total size of cached responses in bytes
+        size_t max_size = 64 * 1024 * 1024;
+
+        // Request headers that select a response in addition to the url,
+        // ex. "Accept-Encoding"
+        std::vector<std::string> vary;
+    };
+
+
+    struct cache {
+    private:
+        using clock = std::chrono::steady_clock;
+        using data_ptr = std::shared_ptr<const std::string>;
+
+        static constexpr size_t shard_count = 16;
+
+        struct entry {
+            std::string key;
+            data_ptr data;
+            clock::time_point expires;
+            // Marked public, may be served to authorized requests
+            bool shared;
+        };
+
+        // Least recently used entry is at the back of the list
+        struct shard {
+            std::mutex mtx;
+            std::list<entry> lru;
+            std::unordered_map<boost::string_view, std::list<entry>::iterator,
+                boost::hash<boost::string_view>> index;
+            size_t size = 0;
+
+            void erase(std::list<entry>::iterator it) {
+                size -= it->key.size() + it->data->size();
+                index.erase(it->key);
+                lru.erase(it);
+            }
+
+            data_ptr find(const std::string& key, clock::time_point now,
+                bool authorized)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = index.find(key);
+                if (it == index.end())
+                    return { };
+
+                auto pos = it->second;
+                if (pos->expires <= now) {
+                    erase(pos);
+                    return { };
+                }
+                if (authorized && !pos->shared)
+                    return { };
+                lru.splice(lru.begin(), lru, pos);
+                return pos->data;
+            }
+
+            void insert(std::string&& key, data_ptr&& data,
+                clock::time_point expires, bool shared, size_t max_size)
+            {
+                size_t esize = key.size() + data->size();
+                if (esize > max_size)
+                    return;
+
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = index.find(key);
+                if (it != index.end())
+                    erase(it->second);
+
+                while (size + esize > max_size)
+                    erase(std::prev(lru.end()));
+
+                lru.push_front({ std::move(key), std::move(data), expires, shared });
+                index.emplace(lru.front().key, lru.begin());
+                size += esize;
+            }
+        };
+
+        struct table {
+            shard shards[shard_count];
+            // Request headers responses are selected by
+            const std::vector<std::string> vary;
+
+            table(std::vector<std::string> v)
+            : vary(std::move(v))
+            { }
+
+            shard& get(const std::string& key) {
+                return shards[std::hash<std::string>()(key) % shard_count];
+            }
+        };
+
+        std::shared_ptr<table> tbl;
+        const cache_options opt;
+
+        std::string make_key(const request& req) const
+        {
+            auto url = req.original_url();
+            std::string key(url.data(), url.size());
+            for (auto& name : tbl->vary) {
+                key.push_back('\0');
+                auto value = req.get(name);
+                if (value)
+                    key.append(value->data(), value->size());
+            }
+            return key;
+        }
+
+        // Return true if pred is true for any token of comma separated
+        // header value, ex. "max-age" of "max-age=60, private"
+        template <class Pred>
+        static bool any_token(boost::string_view value, const Pred& pred)
+        {
+            auto ws = [](char c) { return c == ' ' || c == '\t'; };
+            while (!value.empty()) {
+                size_t end = std::min(value.find(','), value.size());
+                auto token = value.substr(0, end);
+                value.remove_prefix(std::min(end + 1, value.size()));
+
+                // Directive may have argument, ex. private="Set-Cookie"
+                token = token.substr(0, token.find('='));
+                while (!token.empty() && ws(token.front()))
+                    token.remove_prefix(1);
+                while (!token.empty() && ws(token.back()))
+                    token.remove_suffix(1);
+                if (!token.empty() && pred(token))
+                    return true;
+            }
+            return false;
+        }
+
+        static bool has_directive(const response::message_type& msg,
+            boost::string_view name)
+        {
+            auto it = msg.find(http::field::cache_control);
+            return it != msg.end() && any_token(it->value(),
+                [&](boost::string_view t) { return boost::beast::iequals(t, name); });
+        }
+
+        // Only complete successful responses not forbidden to be stored.
+        // Responses setting cookies are personal, so are responses to
+        // authorized requests unless marked public. Responses varying
+        // by headers the key is not made of are not stored either.
+        static bool cacheable(const response::message_type& msg,
+            bool authorized, const std::vector<std::string>& vary)
+        {
+            if (msg.result() != http::status::ok)
+                return false;
+            if (msg.find(http::field::set_cookie) != msg.end())
+                return false;
+
+            // Vary of "*" is never in the list
+            auto known = [&](boost::string_view name) {
+                for (auto& v : vary)
+                    if (boost::beast::iequals(v, name))
+                        return true;
+                return false;
+            };
+            auto it = msg.find(http::field::vary);
+            if (it != msg.end() && any_token(it->value(),
+                [&](boost::string_view name) { return !known(name); }))
+            {
+                return false;
+            }
+
+            if (has_directive(msg, "no-store") || has_directive(msg, "private"))
+                return false;
+            return !authorized || has_directive(msg, "public");
+        }
+
+    public:
+        cache(cache_options options = { })
+        : tbl(std::make_shared<table>(options.vary))
+        , opt(std::move(options))
+        { }
+
+        void operator()(const request& req, response& resp, next& n) const
+        {
+            if (req.method() != http::verb::get) {
+                n();
+                return;
+            }
+
+            auto key = make_key(req);
+            auto& sh = tbl->get(key);
+
+            // Authorized requests are served only public responses
+            bool authorized = !!req.get(http::field::authorization);
+            auto data = sh.find(key, clock::now(), authorized);
+            if (data) {
+                resp.send_raw(std::move(data));
+                return;
+            }
+
+            // Store response produced by the following handlers
+            auto t = tbl;
+            auto ttl = opt.ttl;
+            auto max_size = opt.max_size / shard_count;
+            resp.on_send([t, key, ttl, max_size, authorized](
+                const response::message_type& msg)
+            {
+                if (!cacheable(msg, authorized, t->vary))
+                    return;
+
+                std::ostringstream os;
+                os << msg;
+                auto k = key;
+                t->get(k).insert(std::move(k),
+                    std::make_shared<const std::string>(os.str()),
+                    clock::now() + ttl, has_directive(msg, "public"), max_size);
+            });
+            n();
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_CACHE_HPP
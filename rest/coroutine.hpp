@@ -0,0 +1,66 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_COROUTINE_HPP
+#define REST_COROUTINE_HPP
+
+#include <rest/router.hpp>
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+
+namespace rest {
+
+    template <class T = void>
+    using awaitable = boost::asio::awaitable<T>;
+
+    // Make route handler of a coroutine with signature
+    //   awaitable<void>(request, response, next)
+    // Arguments are taken by value to stay valid across suspension points.
+    // The coroutine runs on executor of the connection, the chain of
+    // handlers continues when it calls next. Exception thrown by the
+    // coroutine is passed to error handlers.
+    template <class F>
+    req_resp_next co_handler(F&& fn)
+    {
+        auto f = std::make_shared<typename std::decay<F>::type>(
+            std::forward<F>(fn));
+
+        return [f](const request& req, response& resp, next& n) {
+            next nx = n;
+            boost::asio::co_spawn(req.connection()->get_executor(),
+                (*f)(req, resp, n),
+                [nx](std::exception_ptr ep) mutable {
+                    if (!ep)
+                        return;
+                    try { std::rethrow_exception(ep); }
+                    catch (const std::exception& ex) { nx(ex); }
+                    catch (const boost::system::error_code& ec) { nx(ec); }
+                    catch (...) { nx("unknown error"); }
+                });
+        };
+    }
+
+} // namespace rest
+
+#endif // BOOST_ASIO_HAS_CO_AWAIT
+
+#endif // REST_COROUTINE_HPP
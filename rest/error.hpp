@@ -26,37 +26,67 @@
 
 namespace rest {
 
+    // Error passed to error handlers. An error code or HTTP status is
+    // stored as is, its message is formatted only if what() is called.
     struct error {
     private:
-        std::string err;
+        boost::system::error_code ec;
+        http::status st = http::status::unknown;
+        // Message given or formatted on demand
+        mutable std::string msg;
 
     public:
         error() noexcept = default;
 
         error(const char* s) noexcept
-        : err(s)
+        : msg(s)
         { }
 
         error(std::string s) noexcept
-        : err(std::move(s))
+        : msg(std::move(s))
         { }
 
         error(const std::exception& ex) noexcept
-        : err(ex.what())
+        : msg(ex.what())
         { }
 
         error(const boost::system::error_code& ec) noexcept
-        : err(ec.message())
+        : ec(ec)
+        { }
+
+        // Error responded with status if no error handler sends
+        // a response
+        error(http::status status) noexcept
+        : st(status)
+        { }
+
+        error(http::status status, std::string s) noexcept
+        : st(status)
+        , msg(std::move(s))
         { }
 
         operator bool() const noexcept {
-            return !err.empty();
+            return ec || st != http::status::unknown || !msg.empty();
         }
 
-        const std::string& what() const noexcept {
-            return err;
+        const boost::system::error_code& code() const noexcept {
+            return ec;
         }
 
+        // HTTP status of error, http::status::unknown if not set
+        http::status status() const noexcept {
+            return st;
+        }
+
+        const std::string& what() const {
+            if (msg.empty()) {
+                if (ec)
+                    msg = ec.message();
+                else if (st != http::status::unknown)
+                    msg = http::obsolete_reason(st).to_string();
+            }
+            return msg;
+        }
     };
 
 } // namespace rest
@@ -0,0 +1,349 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_EVENT_STREAM_HPP
+#define REST_EVENT_STREAM_HPP
+
+#include <rest/session.hpp>
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+
+namespace rest {
+
+    struct event_stream_options {
+        // Interval of comment lines sent to keep the connection open
+        // through proxies and to detect closed connections. Zero
+        // disables heartbeats.
+        std::chrono::steady_clock::duration heartbeat = std::chrono::seconds(15);
+
+        // Maximum number of events queued for sending to a client.
+        // A client not keeping up is disconnected when its queue is full.
+        size_t max_queue = 64;
+    };
+
+
+    // Open text/event-stream response (Server-Sent Events). Copies refer
+    // to the same stream.
+    struct event_stream {
+        using message_ptr = std::shared_ptr<const std::string>;
+        using close_handler = std::function<void(event_stream&)>;
+
+        struct impl;
+
+    private:
+        std::shared_ptr<impl> self;
+
+        friend struct event_stream_group;
+
+    public:
+        event_stream(std::shared_ptr<impl> s) noexcept
+        : self(std::move(s))
+        { }
+
+        // Start stream on connection. Header is the serialized response
+        // header.
+        static event_stream start(const session_ptr&, std::string header,
+            const event_stream_options& = { });
+
+        // Format event once to be sent to any number of streams
+        static message_ptr format(boost::string_view data,
+            boost::string_view event = { }, boost::string_view id = { })
+        {
+            std::string msg;
+            msg.reserve(data.size() + event.size() + id.size() + 32);
+            if (!event.empty())
+                msg.append("event: ").append(event.data(), event.size()).append("\n");
+            if (!id.empty())
+                msg.append("id: ").append(id.data(), id.size()).append("\n");
+
+            // Every line of data is a separate field
+            for (;;) {
+                size_t n = data.find('\n');
+                msg.append("data: ").append(data.data(), std::min(n, data.size()));
+                msg.append("\n");
+                if (n == boost::string_view::npos)
+                    break;
+                data.remove_prefix(n + 1);
+            }
+            msg.append("\n");
+            return std::make_shared<const std::string>(std::move(msg));
+        }
+
+        // Queue event for sending. May be called from any thread.
+        void send(boost::string_view data,
+            boost::string_view event = { }, boost::string_view id = { })
+        {
+            send(format(data, event, id));
+        }
+        void send(message_ptr msg);
+
+        // Function called when connection is closed
+        void on_close(close_handler handler);
+
+        // End the response when queued events are sent
+        void close();
+
+        bool operator==(const event_stream& other) const noexcept {
+            return self == other.self;
+        }
+    };
+
+
+    struct event_stream::impl : std::enable_shared_from_this<impl> {
+        using strand_type =
+            boost::asio::strand<boost::asio::io_context::executor_type>;
+
+        session_ptr conn;
+        strand_type strand;
+        boost::asio::steady_timer timer;
+        event_stream_options opt;
+        close_handler on_close;
+
+        std::deque<message_ptr> queue;
+        bool closing = false;
+        bool closed = false;
+
+        // Stream owns itself until shutdown, groups hold only weak
+        // references and there may be no write or heartbeat pending
+        std::shared_ptr<impl> keep;
+
+        impl(const session_ptr& c, const event_stream_options& o)
+        : conn(c)
+        , strand(static_cast<boost::asio::io_context&>(
+            boost::asio::query(c->get_executor(),
+                boost::asio::execution::context)).get_executor())
+        , timer(c->get_executor())
+        , opt(o)
+        { }
+
+        template <class F>
+        void post(F&& f) {
+            boost::asio::post(strand, std::forward<F>(f));
+        }
+
+        void push(message_ptr msg)
+        {
+            if (closed || closing)
+                return;
+            // Slow consumer
+            if (queue.size() >= opt.max_queue) {
+                shutdown();
+                return;
+            }
+            queue.push_back(std::move(msg));
+            if (queue.size() == 1)
+                write();
+        }
+
+        void write()
+        {
+            if (queue.empty()) {
+                if (closing)
+                    shutdown();
+                return;
+            }
+            auto s = shared_from_this();
+            // Message is kept alive by the handler, queue is cleared
+            // on shutdown while it is written
+            auto msg = queue.front();
+            conn->async_write(boost::asio::buffer(*msg),
+                [s, msg](boost::beast::error_code ec) {
+                    boost::asio::dispatch(s->strand, [s, ec] {
+                        if (s->closed)
+                            return;
+                        if (ec) {
+                            s->shutdown();
+                            return;
+                        }
+                        s->queue.pop_front();
+                        s->write();
+                    });
+                });
+        }
+
+        void heartbeat()
+        {
+            if (opt.heartbeat == std::chrono::steady_clock::duration::zero())
+                return;
+
+            auto s = shared_from_this();
+            timer.expires_after(opt.heartbeat);
+            timer.async_wait(boost::asio::bind_executor(strand,
+                [s](boost::beast::error_code ec) {
+                    if (ec || s->closed)
+                        return;
+                    static const auto ping =
+                        std::make_shared<const std::string>(":\n\n");
+                    // Nothing to add if events are still queued
+                    if (s->queue.empty())
+                        s->push(ping);
+                    s->heartbeat();
+                }));
+        }
+
+        void shutdown()
+        {
+            if (closed)
+                return;
+            closed = true;
+            queue.clear();
+            timer.cancel();
+            conn->shutdown();
+
+            if (on_close) {
+                event_stream h(shared_from_this());
+                on_close(h);
+            }
+            // Break reference cycles through user handler
+            on_close = nullptr;
+            keep.reset();
+        }
+    };
+
+
+    inline event_stream event_stream::start(const session_ptr& conn,
+        std::string header, const event_stream_options& options)
+    {
+        auto s = std::make_shared<impl>(conn, options);
+        s->keep = s;
+        auto head = std::make_shared<const std::string>(std::move(header));
+        s->post([s, head] {
+            s->push(head);
+            s->heartbeat();
+        });
+
+        // Without heartbeats a closed connection is only noticed here
+        std::weak_ptr<impl> w = s;
+        conn->on_disconnect([w] {
+            if (auto sp = w.lock())
+                sp->post([sp] { sp->shutdown(); });
+        });
+        return { s };
+    }
+
+    inline void event_stream::send(message_ptr msg) {
+        auto s = self;
+        self->post([s, msg] { s->push(msg); });
+    }
+
+    inline void event_stream::on_close(close_handler handler) {
+        auto s = self;
+        self->post([s, handler] {
+            if (s->closed) {
+                event_stream h(s);
+                handler(h);
+            }
+            else
+                s->on_close = handler;
+        });
+    }
+
+    inline void event_stream::close() {
+        auto s = self;
+        self->post([s] {
+            if (s->closed || s->closing)
+                return;
+            s->closing = true;
+            if (s->queue.empty())
+                s->shutdown();
+        });
+    }
+
+
+    // Set of event streams receiving the same events
+    struct event_stream_group {
+    private:
+        struct impl {
+            std::mutex mtx;
+            std::vector<std::weak_ptr<event_stream::impl>> members;
+        };
+
+        std::shared_ptr<impl> self;
+
+    public:
+        event_stream_group()
+        : self(std::make_shared<impl>())
+        { }
+
+        // Add stream to group. Closed streams are removed automatically.
+        void join(const event_stream& es) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            self->members.emplace_back(es.self);
+        }
+
+        void leave(const event_stream& es) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            auto& m = self->members;
+            m.erase(std::remove_if(m.begin(), m.end(),
+                [&](const std::weak_ptr<event_stream::impl>& p) {
+                    auto sp = p.lock();
+                    return !sp || sp == es.self;
+                }), m.end());
+        }
+
+        // Send event to all streams of the group. The event is formatted
+        // once and shared between streams. Return number of streams the
+        // event was queued to.
+        size_t broadcast(boost::string_view data,
+            boost::string_view event = { }, boost::string_view id = { })
+        {
+            return broadcast(event_stream::format(data, event, id));
+        }
+
+        size_t broadcast(const event_stream::message_ptr& msg)
+        {
+            std::vector<std::shared_ptr<event_stream::impl>> targets;
+            {
+                std::lock_guard<std::mutex> lock(self->mtx);
+                auto& m = self->members;
+                targets.reserve(m.size());
+                // Collect open streams and drop closed ones
+                m.erase(std::remove_if(m.begin(), m.end(),
+                    [&](const std::weak_ptr<event_stream::impl>& p) {
+                        auto sp = p.lock();
+                        if (!sp)
+                            return true;
+                        targets.push_back(std::move(sp));
+                        return false;
+                    }), m.end());
+            }
+
+            for (auto& t : targets)
+                event_stream(t).send(msg);
+            return targets.size();
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            return self->members.size();
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_EVENT_STREAM_HPP
@@ -25,20 +25,49 @@
 #define REST_VERSION_MINOR 0
 #define REST_VERSION_PATCH 0
 
+#include <boost/version.hpp>
 #include <boost/beast.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/utility/string_view.hpp>
 #include <boost/filesystem.hpp>
 
+#include <cstring>
 #include <map>
 
+#if BOOST_VERSION < 107400
+#error "Rest requires Boost 1.74 or later"
+#endif
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && BOOST_VERSION < 107800
+#error "io_uring backend of Asio requires Boost 1.78 or later"
+#endif
+
+// Sockets are served by io_uring rather than epoll reactor
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+#define REST_IO_URING
+#endif
+
 namespace rest {
 
     namespace fs = boost::filesystem;
 
     namespace http = boost::beast::http;
     using tcp = boost::asio::ip::tcp;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    namespace local = boost::asio::local;
+#endif
+
+    // Compare names by content, not by address
+    struct name_less {
+        bool operator()(const char* a, const char* b) const noexcept {
+            return std::strcmp(a, b) < 0;
+        }
+    };
+
+    using name_value_map = std::map<const char*, boost::string_view, name_less>;
 
-    using name_value_map = std::map<const char*, boost::string_view>;
+    using request_message = http::request<http::dynamic_body>;
+    using response_message = http::response<http::dynamic_body>;
 
 } // namespace rest
 
@@ -0,0 +1,442 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_HPACK_HPP
+#define REST_HPACK_HPP
+
+#include <rest/forward.hpp>
+
+#include <deque>
+#include <vector>
+
+namespace rest {
+
+    // Header compression of HTTP/2 (RFC 7541)
+    struct hpack {
+    private:
+        struct entry {
+            std::string name;
+            std::string value;
+        };
+
+        struct static_entry {
+            const char* name;
+            const char* value;
+        };
+
+        static const static_entry* static_table() noexcept {
+            static const static_entry t[] = {
+                { ":authority", "" },
+                { ":method", "GET" },
+                { ":method", "POST" },
+                { ":path", "/" },
+                { ":path", "/index.html" },
+                { ":scheme", "http" },
+                { ":scheme", "https" },
+                { ":status", "200" },
+                { ":status", "204" },
+                { ":status", "206" },
+                { ":status", "304" },
+                { ":status", "400" },
+                { ":status", "404" },
+                { ":status", "500" },
+                { "accept-charset", "" },
+                { "accept-encoding", "gzip, deflate" },
+                { "accept-language", "" },
+                { "accept-ranges", "" },
+                { "accept", "" },
+                { "access-control-allow-origin", "" },
+                { "age", "" },
+                { "allow", "" },
+                { "authorization", "" },
+                { "cache-control", "" },
+                { "content-disposition", "" },
+                { "content-encoding", "" },
+                { "content-language", "" },
+                { "content-length", "" },
+                { "content-location", "" },
+                { "content-range", "" },
+                { "content-type", "" },
+                { "cookie", "" },
+                { "date", "" },
+                { "etag", "" },
+                { "expect", "" },
+                { "expires", "" },
+                { "from", "" },
+                { "host", "" },
+                { "if-match", "" },
+                { "if-modified-since", "" },
+                { "if-none-match", "" },
+                { "if-range", "" },
+                { "if-unmodified-since", "" },
+                { "last-modified", "" },
+                { "link", "" },
+                { "location", "" },
+                { "max-forwards", "" },
+                { "proxy-authenticate", "" },
+                { "proxy-authorization", "" },
+                { "range", "" },
+                { "referer", "" },
+                { "refresh", "" },
+                { "retry-after", "" },
+                { "server", "" },
+                { "set-cookie", "" },
+                { "strict-transport-security", "" },
+                { "transfer-encoding", "" },
+                { "user-agent", "" },
+                { "vary", "" },
+                { "via", "" },
+                { "www-authenticate", "" },
+            };
+            return t;
+        }
+
+        static constexpr size_t static_size = 61;
+
+        // Huffman code (right aligned) and its length in bits for every
+        // octet and EOS
+        struct code {
+            uint32_t bits;
+            uint8_t size;
+        };
+
+        static const code* huffman_codes() noexcept {
+            static const code t[257] = {
+            {0x1ff8,13}, {0x7fffd8,23}, {0xfffffe2,28}, {0xfffffe3,28},
+            {0xfffffe4,28}, {0xfffffe5,28}, {0xfffffe6,28}, {0xfffffe7,28},
+            {0xfffffe8,28}, {0xffffea,24}, {0x3ffffffc,30}, {0xfffffe9,28},
+            {0xfffffea,28}, {0x3ffffffd,30}, {0xfffffeb,28}, {0xfffffec,28},
+            {0xfffffed,28}, {0xfffffee,28}, {0xfffffef,28}, {0xffffff0,28},
+            {0xffffff1,28}, {0xffffff2,28}, {0x3ffffffe,30}, {0xffffff3,28},
+            {0xffffff4,28}, {0xffffff5,28}, {0xffffff6,28}, {0xffffff7,28},
+            {0xffffff8,28}, {0xffffff9,28}, {0xffffffa,28}, {0xffffffb,28},
+            {0x14,6}, {0x3f8,10}, {0x3f9,10}, {0xffa,12}, {0x1ff9,13},
+            {0x15,6}, {0xf8,8}, {0x7fa,11}, {0x3fa,10}, {0x3fb,10}, {0xf9,8},
+            {0x7fb,11}, {0xfa,8}, {0x16,6}, {0x17,6}, {0x18,6}, {0x0,5},
+            {0x1,5}, {0x2,5}, {0x19,6}, {0x1a,6}, {0x1b,6}, {0x1c,6}, {0x1d,6},
+            {0x1e,6}, {0x1f,6}, {0x5c,7}, {0xfb,8}, {0x7ffc,15}, {0x20,6},
+            {0xffb,12}, {0x3fc,10}, {0x1ffa,13}, {0x21,6}, {0x5d,7}, {0x5e,7},
+            {0x5f,7}, {0x60,7}, {0x61,7}, {0x62,7}, {0x63,7}, {0x64,7},
+            {0x65,7}, {0x66,7}, {0x67,7}, {0x68,7}, {0x69,7}, {0x6a,7},
+            {0x6b,7}, {0x6c,7}, {0x6d,7}, {0x6e,7}, {0x6f,7}, {0x70,7},
+            {0x71,7}, {0x72,7}, {0xfc,8}, {0x73,7}, {0xfd,8}, {0x1ffb,13},
+            {0x7fff0,19}, {0x1ffc,13}, {0x3ffc,14}, {0x22,6}, {0x7ffd,15},
+            {0x3,5}, {0x23,6}, {0x4,5}, {0x24,6}, {0x5,5}, {0x25,6}, {0x26,6},
+            {0x27,6}, {0x6,5}, {0x74,7}, {0x75,7}, {0x28,6}, {0x29,6},
+            {0x2a,6}, {0x7,5}, {0x2b,6}, {0x76,7}, {0x2c,6}, {0x8,5}, {0x9,5},
+            {0x2d,6}, {0x77,7}, {0x78,7}, {0x79,7}, {0x7a,7}, {0x7b,7},
+            {0x7ffe,15}, {0x7fc,11}, {0x3ffd,14}, {0x1ffd,13}, {0xffffffc,28},
+            {0xfffe6,20}, {0x3fffd2,22}, {0xfffe7,20}, {0xfffe8,20},
+            {0x3fffd3,22}, {0x3fffd4,22}, {0x3fffd5,22}, {0x7fffd9,23},
+            {0x3fffd6,22}, {0x7fffda,23}, {0x7fffdb,23}, {0x7fffdc,23},
+            {0x7fffdd,23}, {0x7fffde,23}, {0xffffeb,24}, {0x7fffdf,23},
+            {0xffffec,24}, {0xffffed,24}, {0x3fffd7,22}, {0x7fffe0,23},
+            {0xffffee,24}, {0x7fffe1,23}, {0x7fffe2,23}, {0x7fffe3,23},
+            {0x7fffe4,23}, {0x1fffdc,21}, {0x3fffd8,22}, {0x7fffe5,23},
+            {0x3fffd9,22}, {0x7fffe6,23}, {0x7fffe7,23}, {0xffffef,24},
+            {0x3fffda,22}, {0x1fffdd,21}, {0xfffe9,20}, {0x3fffdb,22},
+            {0x3fffdc,22}, {0x7fffe8,23}, {0x7fffe9,23}, {0x1fffde,21},
+            {0x7fffea,23}, {0x3fffdd,22}, {0x3fffde,22}, {0xfffff0,24},
+            {0x1fffdf,21}, {0x3fffdf,22}, {0x7fffeb,23}, {0x7fffec,23},
+            {0x1fffe0,21}, {0x1fffe1,21}, {0x3fffe0,22}, {0x1fffe2,21},
+            {0x7fffed,23}, {0x3fffe1,22}, {0x7fffee,23}, {0x7fffef,23},
+            {0xfffea,20}, {0x3fffe2,22}, {0x3fffe3,22}, {0x3fffe4,22},
+            {0x7ffff0,23}, {0x3fffe5,22}, {0x3fffe6,22}, {0x7ffff1,23},
+            {0x3ffffe0,26}, {0x3ffffe1,26}, {0xfffeb,20}, {0x7fff1,19},
+            {0x3fffe7,22}, {0x7ffff2,23}, {0x3fffe8,22}, {0x1ffffec,25},
+            {0x3ffffe2,26}, {0x3ffffe3,26}, {0x3ffffe4,26}, {0x7ffffde,27},
+            {0x7ffffdf,27}, {0x3ffffe5,26}, {0xfffff1,24}, {0x1ffffed,25},
+            {0x7fff2,19}, {0x1fffe3,21}, {0x3ffffe6,26}, {0x7ffffe0,27},
+            {0x7ffffe1,27}, {0x3ffffe7,26}, {0x7ffffe2,27}, {0xfffff2,24},
+            {0x1fffe4,21}, {0x1fffe5,21}, {0x3ffffe8,26}, {0x3ffffe9,26},
+            {0xffffffd,28}, {0x7ffffe3,27}, {0x7ffffe4,27}, {0x7ffffe5,27},
+            {0xfffec,20}, {0xfffff3,24}, {0xfffed,20}, {0x1fffe6,21},
+            {0x3fffe9,22}, {0x1fffe7,21}, {0x1fffe8,21}, {0x7ffff3,23},
+            {0x3fffea,22}, {0x3fffeb,22}, {0x1ffffee,25}, {0x1ffffef,25},
+            {0xfffff4,24}, {0xfffff5,24}, {0x3ffffea,26}, {0x7ffff4,23},
+            {0x3ffffeb,26}, {0x7ffffe6,27}, {0x3ffffec,26}, {0x3ffffed,26},
+            {0x7ffffe7,27}, {0x7ffffe8,27}, {0x7ffffe9,27}, {0x7ffffea,27},
+            {0x7ffffeb,27}, {0xffffffe,28}, {0x7ffffec,27}, {0x7ffffed,27},
+            {0x7ffffee,27}, {0x7ffffef,27}, {0x7fffff0,27}, {0x3ffffee,26},
+            {0x3fffffff,30}
+            };
+            return t;
+        }
+
+        // Binary tree of Huffman codes for decoding. Leaves have negative
+        // children, symbol is stored in the first one.
+        struct node {
+            int child[2];
+        };
+
+        static const std::vector<node>& huffman_tree() {
+            static const std::vector<node> tree = [] {
+                std::vector<node> t(1, node { { 0, 0 } });
+                const code* codes = huffman_codes();
+                for (int sym = 0; sym < 257; ++sym) {
+                    size_t n = 0;
+                    for (int i = codes[sym].size - 1; i >= 0; --i) {
+                        int bit = (codes[sym].bits >> i) & 1;
+                        if (i == 0) {
+                            t[n].child[bit] = -sym - 1;
+                            break;
+                        }
+                        if (t[n].child[bit] == 0) {
+                            t[n].child[bit] = int(t.size());
+                            t.push_back(node { { 0, 0 } });
+                        }
+                        n = t[n].child[bit];
+                    }
+                }
+                return t;
+            }();
+            return tree;
+        }
+
+        // Read integer with N-bit prefix
+        static bool read_int(const uint8_t*& p, const uint8_t* end,
+            unsigned prefix, size_t& value) noexcept
+        {
+            if (p == end)
+                return false;
+            size_t mask = (1u << prefix) - 1;
+            value = *p++ & mask;
+            if (value < mask)
+                return true;
+
+            for (unsigned shift = 0; p != end && shift < 32; shift += 7) {
+                uint8_t b = *p++;
+                value += size_t(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        static bool read_huffman(const uint8_t* p, size_t n, std::string& out)
+        {
+            auto& tree = huffman_tree();
+            size_t state = 0;
+            // Bits read since last symbol and whether they were all ones
+            unsigned pad = 0;
+            bool ones = true;
+
+            for (const uint8_t* end = p + n; p != end; ++p) {
+                for (int i = 7; i >= 0; --i) {
+                    int bit = (*p >> i) & 1;
+                    int next = tree[state].child[bit];
+                    ++pad;
+                    ones = ones && bit;
+                    if (next < 0) {
+                        // EOS must not be encoded
+                        if (next == -257)
+                            return false;
+                        out.push_back(char(-next - 1));
+                        state = 0;
+                        pad = 0;
+                        ones = true;
+                    }
+                    else if (next == 0)
+                        return false;
+                    else
+                        state = next;
+                }
+            }
+            // Padding is a prefix of EOS shorter than an octet
+            return pad < 8 && ones;
+        }
+
+        static bool read_string(const uint8_t*& p, const uint8_t* end,
+            std::string& out)
+        {
+            if (p == end)
+                return false;
+            bool huffman = *p & 0x80;
+            size_t n;
+            if (!read_int(p, end, 7, n) || size_t(end - p) < n)
+                return false;
+
+            out.clear();
+            if (huffman) {
+                if (!read_huffman(p, n, out))
+                    return false;
+            }
+            else
+                out.assign(reinterpret_cast<const char*>(p), n);
+            p += n;
+            return true;
+        }
+
+        static void write_int(std::string& out, uint8_t flags,
+            unsigned prefix, size_t value)
+        {
+            size_t mask = (1u << prefix) - 1;
+            if (value < mask) {
+                out.push_back(char(flags | value));
+                return;
+            }
+            out.push_back(char(flags | mask));
+            for (value -= mask; value >= 0x80; value >>= 7)
+                out.push_back(char(0x80 | (value & 0x7f)));
+            out.push_back(char(value));
+        }
+
+        // Literal without Huffman coding
+        static void write_string(std::string& out, boost::string_view s) {
+            write_int(out, 0, 7, s.size());
+            out.append(s.data(), s.size());
+        }
+
+    public:
+        // Decoder state of a connection
+        struct decoder {
+        private:
+            std::deque<entry> dynamic;
+            size_t size = 0;
+            size_t max_size;
+            size_t limit;
+
+            void evict() {
+                while (size > max_size) {
+                    auto& e = dynamic.back();
+                    size -= e.name.size() + e.value.size() + 32;
+                    dynamic.pop_back();
+                }
+            }
+
+            void insert(const std::string& name, const std::string& value) {
+                size += name.size() + value.size() + 32;
+                dynamic.push_front({ name, value });
+                evict();
+            }
+
+            bool lookup(size_t index, std::string& name, std::string* value) const
+            {
+                if (index == 0)
+                    return false;
+                if (index <= static_size) {
+                    auto& e = static_table()[index - 1];
+                    name = e.name;
+                    if (value)
+                        *value = e.value;
+                    return true;
+                }
+                index -= static_size + 1;
+                if (index >= dynamic.size())
+                    return false;
+                name = dynamic[index].name;
+                if (value)
+                    *value = dynamic[index].value;
+                return true;
+            }
+
+        public:
+            // Limit is the table size advertised in settings
+            decoder(size_t limit = 4096) noexcept
+            : max_size(limit), limit(limit)
+            { }
+
+            // Decode header block calling f(name, value) for each field.
+            // Return false on compression error.
+            template <class F>
+            bool decode(const uint8_t* p, size_t n, F&& f)
+            {
+                const uint8_t* end = p + n;
+                std::string name, value;
+
+                while (p != end) {
+                    uint8_t b = *p;
+                    size_t index;
+
+                    // Indexed field
+                    if (b & 0x80) {
+                        if (!read_int(p, end, 7, index) ||
+                            !lookup(index, name, &value))
+                            return false;
+                        f(name, value);
+                        continue;
+                    }
+
+                    // Dynamic table size update
+                    if ((b & 0xe0) == 0x20) {
+                        if (!read_int(p, end, 5, index) || index > limit)
+                            return false;
+                        max_size = index;
+                        evict();
+                        continue;
+                    }
+
+                    // Literal, with incremental indexing or not
+                    bool indexing = (b & 0xc0) == 0x40;
+                    if (!read_int(p, end, indexing ? 6 : 4, index))
+                        return false;
+                    if (index == 0) {
+                        if (!read_string(p, end, name))
+                            return false;
+                    }
+                    else if (!lookup(index, name, nullptr))
+                        return false;
+                    if (!read_string(p, end, value))
+                        return false;
+
+                    if (indexing)
+                        insert(name, value);
+                    f(name, value);
+                }
+                return true;
+            }
+        };
+
+        // Encode status pseudo header
+        static void encode_status(std::string& out, unsigned status)
+        {
+            auto s = std::to_string(status);
+            // Fully indexed if in static table
+            for (size_t i = 7; i < 14; ++i) {
+                if (s == static_table()[i].value) {
+                    write_int(out, 0x80, 7, i + 1);
+                    return;
+                }
+            }
+            write_int(out, 0, 4, 8);
+            write_string(out, s);
+        }
+
+        // Encode field as literal without indexing, name must be lower case.
+        // Encoder never adds to dynamic table, so no state is needed.
+        static void encode(std::string& out,
+            boost::string_view name, boost::string_view value)
+        {
+            // Name from static table if present
+            for (size_t i = 14; i < static_size; ++i) {
+                if (name == static_table()[i].name) {
+                    write_int(out, 0, 4, i + 1);
+                    write_string(out, value);
+                    return;
+                }
+            }
+            out.push_back(0);
+            write_string(out, name);
+            write_string(out, value);
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_HPACK_HPP
@@ -0,0 +1,973 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_HTTP2_HPP
+#define REST_HTTP2_HPP
+
+#include <rest/hpack.hpp>
+#include <rest/session.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core/detail/base64.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+
+namespace rest {
+
+    struct http2_options {
+        // Maximum number of requests in progress on a connection
+        uint32_t max_concurrent_streams = 100;
+
+        // Flow control window of request body, i.e. number of bytes
+        // client may send before the server has read them
+        uint32_t initial_window_size = 65535;
+
+        // Maximum size of request headers
+        uint32_t max_header_list_size = 64 * 1024;
+
+        // Requests with larger body are reset
+        size_t max_body_size = 1024 * 1024;
+    };
+
+
+    struct http2_connection;
+
+    // Stream (request-response exchange) of HTTP/2 connection. Looks like
+    // a connection of its own to request and response.
+    struct http2_stream : session {
+        std::shared_ptr<http2_connection> owner;
+        const uint32_t id;
+        request_message req;
+
+        bool end_remote = false;   // request received
+        bool headers_sent = false;
+        bool end_pending = false;  // end stream when data is sent
+        bool end_local = false;    // response sent
+        bool reset = false;
+
+        // Response body not yet sent due to flow control
+        std::string data;
+        size_t data_sent = 0;
+        int64_t window;
+
+        // Serialized HTTP/1 header written by send_raw or event_stream
+        std::string raw;
+
+        // Called when stream is reset or connection is lost
+        std::function<void()> disconnected;
+
+        http2_stream(std::shared_ptr<http2_connection> c, uint32_t id,
+            int64_t window) noexcept
+        : owner(std::move(c)), id(id), window(window)
+        { }
+
+        executor_type get_executor() override;
+        tcp::socket* socket() override;
+
+        void async_read(boost::beast::flat_buffer&,
+            request_message&, handler) override;
+        void async_read_some(boost::asio::mutable_buffer, read_handler) override;
+        void async_write(response_message&, handler) override;
+        void async_write(shared_response_message&, handler) override;
+        void async_write(boost::asio::const_buffer, handler) override;
+        void shutdown() override;
+        void on_disconnect(std::function<void()>) override;
+
+        // Stream is dropped, response is not sent
+        void cancel() {
+            reset = true;
+            auto h = std::move(disconnected);
+            disconnected = nullptr;
+            if (h)
+                h();
+        }
+    };
+
+
+    // HTTP/2 connection without TLS (h2c)
+    struct http2_connection : std::enable_shared_from_this<http2_connection> {
+        using dispatcher = std::function<void(const session_ptr&)>;
+        using strand_type =
+            boost::asio::strand<boost::asio::io_context::executor_type>;
+        using stream_ptr = std::shared_ptr<http2_stream>;
+
+        enum frame_type : uint8_t {
+            data_frame = 0x0,
+            headers_frame = 0x1,
+            priority_frame = 0x2,
+            rst_stream_frame = 0x3,
+            settings_frame = 0x4,
+            push_promise_frame = 0x5,
+            ping_frame = 0x6,
+            goaway_frame = 0x7,
+            window_update_frame = 0x8,
+            continuation_frame = 0x9
+        };
+
+        enum frame_flag : uint8_t {
+            end_stream = 0x1,
+            ack = 0x1,
+            end_headers = 0x4,
+            padded = 0x8,
+            priority = 0x20
+        };
+
+        enum error_code : uint32_t {
+            no_error = 0x0,
+            protocol_error = 0x1,
+            internal_error = 0x2,
+            flow_control_error = 0x3,
+            stream_closed = 0x5,
+            frame_size_error = 0x6,
+            refused_stream = 0x7,
+            cancel = 0x8,
+            compression_error = 0x9
+        };
+
+        // Largest frame payload accepted, the default of protocol
+        static constexpr size_t max_frame_size = 16384;
+        static constexpr int64_t max_window = 0x7fffffff;
+
+        // First bytes sent by client
+        static boost::string_view preface() noexcept {
+            return { "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24 };
+        }
+
+    private:
+        session_ptr conn;
+        strand_type strand;
+        http2_options opt;
+        dispatcher dispatch_request;
+
+        boost::beast::flat_buffer in;
+        bool preface_received = false;
+
+        // Frames to send, all written together by one write operation
+        std::string out;
+        std::string writing;
+        bool write_scheduled = false;
+        bool write_busy = false;
+
+        hpack::decoder decoder;
+        // Header block being received in HEADERS and CONTINUATION frames
+        uint32_t header_stream = 0;
+        uint8_t header_flags = 0;
+        std::string header_block;
+
+        std::map<uint32_t, stream_ptr> streams;
+        uint32_t last_stream = 0;
+
+        // Send flow control set by client
+        int64_t send_window = 65535;
+        int64_t peer_window = 65535;
+        size_t peer_frame_size = max_frame_size;
+
+        bool going_away = false;
+        bool closing = false;
+        bool closed = false;
+
+        friend struct http2_stream;
+
+        static uint32_t read32(const uint8_t* p) noexcept {
+            return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 |
+                uint32_t(p[2]) << 8 | p[3];
+        }
+
+        static void write32(char* p, uint32_t v) noexcept {
+            p[0] = char(v >> 24);
+            p[1] = char(v >> 16);
+            p[2] = char(v >> 8);
+            p[3] = char(v);
+        }
+
+        void frame(uint8_t type, uint8_t flags, uint32_t id,
+            const void* payload, size_t size)
+        {
+            char head[9] = {
+                char(size >> 16), char(size >> 8), char(size),
+                char(type), char(flags) };
+            write32(head + 5, id & 0x7fffffff);
+            out.append(head, 9);
+            out.append(static_cast<const char*>(payload), size);
+
+            // Frames queued in the same handler are written at once
+            if (!write_busy && !write_scheduled) {
+                write_scheduled = true;
+                auto s = shared_from_this();
+                boost::asio::post(strand, [s] {
+                    s->write_scheduled = false;
+                    s->write();
+                });
+            }
+        }
+
+        void write()
+        {
+            if (write_busy)
+                return;
+            if (out.empty()) {
+                if (closing)
+                    close();
+                return;
+            }
+
+            write_busy = true;
+            writing.swap(out);
+            auto s = shared_from_this();
+            conn->async_write(boost::asio::buffer(writing),
+                [s](boost::beast::error_code ec) {
+                    boost::asio::dispatch(s->strand, [s, ec] {
+                        s->write_busy = false;
+                        s->writing.clear();
+                        if (ec) {
+                            s->close();
+                            return;
+                        }
+                        s->write();
+                    });
+                });
+        }
+
+        void read()
+        {
+            auto s = shared_from_this();
+            conn->async_read_some(in.prepare(max_frame_size + 9),
+                [s](boost::beast::error_code ec, size_t n) {
+                    boost::asio::dispatch(s->strand, [s, ec, n] {
+                        if (ec || s->closed) {
+                            s->close();
+                            return;
+                        }
+                        s->in.commit(n);
+                        if (s->process())
+                            s->read();
+                    });
+                });
+        }
+
+        void close()
+        {
+            if (closed)
+                return;
+            closed = true;
+            // Streams still in progress drop their responses
+            auto dropped = std::move(streams);
+            streams.clear();
+            for (auto& st : dropped)
+                st.second->cancel();
+            conn->shutdown();
+        }
+
+        // Connection error, tell the client and stop reading
+        bool fail(error_code code)
+        {
+            char payload[8];
+            write32(payload, last_stream);
+            write32(payload + 4, code);
+            frame(goaway_frame, 0, 0, payload, sizeof(payload));
+            going_away = true;
+            closing = true;
+            return false;
+        }
+
+        // Stream error
+        void reset(uint32_t id, error_code code)
+        {
+            char payload[4];
+            write32(payload, code);
+            frame(rst_stream_frame, 0, id, payload, sizeof(payload));
+
+            auto it = streams.find(id);
+            if (it != streams.end()) {
+                auto st = it->second;
+                streams.erase(it);
+                st->cancel();
+            }
+        }
+
+        void window_update(uint32_t id, uint32_t size)
+        {
+            char payload[4];
+            write32(payload, size);
+            frame(window_update_frame, 0, id, payload, sizeof(payload));
+        }
+
+        void send_settings()
+        {
+            const std::pair<uint16_t, uint32_t> settings[] = {
+                { 0x3, opt.max_concurrent_streams },
+                { 0x4, opt.initial_window_size },
+                { 0x6, opt.max_header_list_size }
+            };
+            char payload[sizeof(settings) / sizeof(settings[0]) * 6];
+            char* p = payload;
+            for (auto& s : settings) {
+                p[0] = char(s.first >> 8);
+                p[1] = char(s.first);
+                write32(p + 2, s.second);
+                p += 6;
+            }
+            frame(settings_frame, 0, 0, payload, sizeof(payload));
+        }
+
+        bool apply_settings(const uint8_t* p, size_t size)
+        {
+            for (; size >= 6; p += 6, size -= 6) {
+                uint16_t id = uint16_t(p[0] << 8 | p[1]);
+                uint32_t value = read32(p + 2);
+
+                switch (id) {
+                case 0x2: // SETTINGS_ENABLE_PUSH
+                    if (value > 1)
+                        return fail(protocol_error);
+                    break;
+                case 0x4: { // SETTINGS_INITIAL_WINDOW_SIZE
+                    if (value > max_window)
+                        return fail(flow_control_error);
+                    int64_t delta = int64_t(value) - peer_window;
+                    peer_window = value;
+                    for (auto& st : streams)
+                        st.second->window += delta;
+                    break;
+                }
+                case 0x5: // SETTINGS_MAX_FRAME_SIZE
+                    if (value < 16384 || value > 16777215)
+                        return fail(protocol_error);
+                    peer_frame_size = value;
+                    break;
+                default:
+                    // Encoder does not use dynamic table, header table
+                    // size does not matter
+                    break;
+                }
+            }
+            return true;
+        }
+
+        // Handle complete frames in input buffer. Return false on
+        // connection error.
+        bool process()
+        {
+            if (!preface_received) {
+                if (in.size() < preface().size())
+                    return true;
+                if (std::memcmp(in.data().data(),
+                    preface().data(), preface().size()) != 0)
+                {
+                    close();
+                    return false;
+                }
+                in.consume(preface().size());
+                preface_received = true;
+            }
+
+            while (in.size() >= 9) {
+                auto p = static_cast<const uint8_t*>(in.data().data());
+                size_t size = size_t(p[0]) << 16 | size_t(p[1]) << 8 | p[2];
+                if (size > max_frame_size)
+                    return fail(frame_size_error);
+                if (in.size() < size + 9)
+                    break;
+
+                bool ok = on_frame(p[3], p[4], read32(p + 5) & 0x7fffffff,
+                    p + 9, size);
+                in.consume(size + 9);
+                if (!ok)
+                    return false;
+            }
+            return !closing;
+        }
+
+        bool on_frame(uint8_t type, uint8_t flags, uint32_t id,
+            const uint8_t* p, size_t size)
+        {
+            // Header block must not be interrupted by other frames
+            if (header_stream && (type != continuation_frame || id != header_stream))
+                return fail(protocol_error);
+
+            switch (type) {
+            case data_frame:
+                return on_data(flags, id, p, size);
+            case headers_frame:
+                return on_headers(flags, id, p, size);
+            case continuation_frame:
+                if (!header_stream)
+                    return fail(protocol_error);
+                header_block.append(reinterpret_cast<const char*>(p), size);
+                if (header_block.size() > opt.max_header_list_size)
+                    return fail(protocol_error);
+                return (flags & end_headers) ? on_header_block() : true;
+            case priority_frame:
+                if (size != 5)
+                    reset(id, frame_size_error);
+                return true;
+            case rst_stream_frame: {
+                if (id == 0 || size != 4)
+                    return fail(id ? frame_size_error : protocol_error);
+                auto it = streams.find(id);
+                if (it != streams.end()) {
+                    auto st = it->second;
+                    streams.erase(it);
+                    st->cancel();
+                }
+                return true;
+            }
+            case settings_frame:
+                if (id != 0)
+                    return fail(protocol_error);
+                if (flags & ack)
+                    return size == 0 || fail(frame_size_error);
+                if (size % 6)
+                    return fail(frame_size_error);
+                if (!apply_settings(p, size))
+                    return false;
+                frame(settings_frame, ack, 0, nullptr, 0);
+                flush_all();
+                return true;
+            case ping_frame:
+                if (id != 0)
+                    return fail(protocol_error);
+                if (size != 8)
+                    return fail(frame_size_error);
+                if (!(flags & ack))
+                    frame(ping_frame, ack, 0, p, size);
+                return true;
+            case goaway_frame:
+                // Finish requests in progress
+                going_away = true;
+                if (streams.empty())
+                    closing = true;
+                return true;
+            case window_update_frame:
+                return on_window_update(id, p, size);
+            case push_promise_frame:
+                return fail(protocol_error);
+            default:
+                // Unknown frames are ignored
+                return true;
+            }
+        }
+
+        // Remove padding and priority fields from payload
+        static bool strip(uint8_t flags, const uint8_t*& p, size_t& size,
+            bool has_priority) noexcept
+        {
+            size_t pad = 0;
+            if (flags & padded) {
+                if (size < 1)
+                    return false;
+                pad = *p++;
+                --size;
+            }
+            if (has_priority && (flags & priority)) {
+                if (size < 5)
+                    return false;
+                p += 5;
+                size -= 5;
+            }
+            if (pad > size)
+                return false;
+            size -= pad;
+            return true;
+        }
+
+        bool on_headers(uint8_t flags, uint32_t id, const uint8_t* p, size_t size)
+        {
+            if (id == 0 || !(id & 1) || !strip(flags, p, size, true))
+                return fail(protocol_error);
+
+            header_stream = id;
+            header_flags = flags;
+            header_block.assign(reinterpret_cast<const char*>(p), size);
+            return (flags & end_headers) ? on_header_block() : true;
+        }
+
+        bool on_header_block()
+        {
+            uint32_t id = header_stream;
+            header_stream = 0;
+
+            stream_ptr st;
+            auto it = streams.find(id);
+            bool trailers = it != streams.end();
+            if (trailers)
+                st = it->second;
+            else if (id <= last_stream)
+                return fail(stream_closed);
+            else {
+                last_stream = id;
+                st = std::make_shared<http2_stream>(
+                    shared_from_this(), id, peer_window);
+            }
+
+            // Block is decoded even if stream is refused to keep
+            // decoder state
+            bool valid = true;
+            bool ok = decoder.decode(
+                reinterpret_cast<const uint8_t*>(header_block.data()),
+                header_block.size(),
+                [&](const std::string& name, const std::string& value) {
+                    if (trailers)
+                        return;
+                    if (name.empty() || name[0] != ':')
+                        st->req.insert(name, value);
+                    else if (name == ":method")
+                        st->req.method_string(value);
+                    else if (name == ":path")
+                        st->req.target(value);
+                    else if (name == ":authority")
+                        st->req.set(http::field::host, value);
+                    else if (name != ":scheme")
+                        valid = false;
+                });
+            header_block.clear();
+            if (!ok)
+                return fail(compression_error);
+
+            if (!trailers) {
+                if (!valid || st->req.target().empty()) {
+                    reset(id, protocol_error);
+                    return true;
+                }
+                if (going_away || streams.size() >= opt.max_concurrent_streams) {
+                    reset(id, refused_stream);
+                    return true;
+                }
+                st->req.version(20);
+                streams.emplace(id, st);
+            }
+            else if (!(header_flags & end_stream)) {
+                reset(id, protocol_error);
+                return true;
+            }
+
+            if (header_flags & end_stream)
+                submit(st);
+            return true;
+        }
+
+        bool on_data(uint8_t flags, uint32_t id, const uint8_t* p, size_t size)
+        {
+            if (id == 0)
+                return fail(protocol_error);
+
+            // Data is consumed right away, give the window back
+            if (size)
+                window_update(0, uint32_t(size));
+
+            uint32_t frame_size = uint32_t(size);
+            if (!strip(flags, p, size, false))
+                return fail(protocol_error);
+
+            auto it = streams.find(id);
+            if (it == streams.end() || it->second->end_remote) {
+                if (id > last_stream)
+                    return fail(protocol_error);
+                reset(id, stream_closed);
+                return true;
+            }
+
+            auto st = it->second;
+            auto& body = st->req.body();
+            if (body.size() + size > opt.max_body_size) {
+                reset(id, cancel);
+                return true;
+            }
+            boost::asio::buffer_copy(body.prepare(size),
+                boost::asio::buffer(p, size));
+            body.commit(size);
+
+            if (flags & end_stream)
+                submit(st);
+            else if (frame_size)
+                window_update(id, frame_size);
+            return true;
+        }
+
+        bool on_window_update(uint32_t id, const uint8_t* p, size_t size)
+        {
+            if (size != 4)
+                return fail(frame_size_error);
+            uint32_t inc = read32(p) & 0x7fffffff;
+
+            if (id == 0) {
+                if (inc == 0)
+                    return fail(protocol_error);
+                send_window += inc;
+                if (send_window > max_window)
+                    return fail(flow_control_error);
+                flush_all();
+                return true;
+            }
+
+            auto it = streams.find(id);
+            if (it == streams.end())
+                return true;
+            auto st = it->second;
+            if (inc == 0 || st->window + inc > max_window) {
+                reset(id, inc ? flow_control_error : protocol_error);
+                return true;
+            }
+            st->window += inc;
+            flush(st);
+            return true;
+        }
+
+        // Request is complete, pass it to router
+        void submit(const stream_ptr& st)
+        {
+            st->end_remote = true;
+            auto& req = st->req;
+            if (req.body().size() && req.find(http::field::content_length) == req.end())
+                req.content_length(req.body().size());
+            dispatch_request(st);
+        }
+
+        template <class Fields>
+        void send_headers(const stream_ptr& st,
+            const http::header<false, Fields>& h, bool end)
+        {
+            std::string block;
+            hpack::encode_status(block, h.result_int());
+            std::string name;
+            for (auto& f : h) {
+                // Connection specific fields are not allowed
+                switch (f.name()) {
+                case http::field::connection:
+                case http::field::keep_alive:
+                case http::field::proxy_connection:
+                case http::field::transfer_encoding:
+                case http::field::upgrade:
+                    continue;
+                default:
+                    break;
+                }
+                auto n = f.name_string();
+                name.assign(n.data(), n.size());
+                std::transform(name.begin(), name.end(), name.begin(),
+                    [](char c) { return char(std::tolower(c)); });
+                hpack::encode(block, name, f.value());
+            }
+
+            // Split block to HEADERS and CONTINUATION frames
+            size_t pos = 0;
+            uint8_t type = headers_frame;
+            uint8_t flags = end ? end_stream : 0;
+            do {
+                size_t size = std::min(block.size() - pos, peer_frame_size);
+                if (pos + size == block.size())
+                    flags |= end_headers;
+                frame(type, flags, st->id, block.data() + pos, size);
+                pos += size;
+                type = continuation_frame;
+                flags = 0;
+            } while (pos < block.size());
+
+            st->headers_sent = true;
+            if (end) {
+                st->end_local = true;
+                finish(st);
+            }
+        }
+
+        // Send as much of response body as flow control allows
+        void flush(stream_ptr st)
+        {
+            while (st->data_sent < st->data.size() || st->end_pending) {
+                size_t left = st->data.size() - st->data_sent;
+                int64_t window = std::min(st->window, send_window);
+                size_t size = std::min(left, peer_frame_size);
+                size = std::min<size_t>(size, std::max<int64_t>(window, 0));
+                if (size == 0 && left > 0)
+                    break;
+
+                bool last = st->end_pending && size == left;
+                frame(data_frame, last ? end_stream : 0, st->id,
+                    st->data.data() + st->data_sent, size);
+                st->data_sent += size;
+                st->window -= size;
+                send_window -= size;
+                if (last) {
+                    st->end_pending = false;
+                    st->end_local = true;
+                }
+            }
+
+            if (st->data_sent == st->data.size()) {
+                st->data.clear();
+                st->data_sent = 0;
+            }
+            finish(st);
+        }
+
+        void flush_all()
+        {
+            for (auto it = streams.begin(); it != streams.end(); ) {
+                auto st = (it++)->second;
+                if (st->data_sent < st->data.size())
+                    flush(st);
+            }
+        }
+
+        // Forget stream when response is sent
+        void finish(const stream_ptr& st)
+        {
+            if (!st->end_local)
+                return;
+            streams.erase(st->id);
+            if (going_away && streams.empty()) {
+                closing = true;
+                write();
+            }
+        }
+
+        // Response of stream
+        void respond(const stream_ptr& st, const response_message& msg)
+        {
+            if (st->reset || st->headers_sent || closed)
+                return;
+
+            bool empty = msg.body().size() == 0;
+            send_headers(st, msg, empty);
+            if (empty)
+                return;
+
+            st->data.reserve(msg.body().size());
+            for (auto b : msg.body().data())
+                st->data.append(static_cast<const char*>(b.data()), b.size());
+            st->end_pending = true;
+            flush(st);
+        }
+
+        // Response of stream with shared body, copied as frames are
+        // flow controlled per stream
+        void respond(const stream_ptr& st, const shared_response_message& msg)
+        {
+            if (st->reset || st->headers_sent || closed)
+                return;
+
+            auto body = msg.body().data();
+            send_headers(st, msg, body.size() == 0);
+            if (body.size() == 0)
+                return;
+
+            st->data.append(static_cast<const char*>(body.data()), body.size());
+            st->end_pending = true;
+            flush(st);
+        }
+
+        // Response of stream written as serialized HTTP/1 message in parts
+        void respond_raw(const stream_ptr& st, boost::string_view chunk)
+        {
+            if (st->reset || st->end_pending || st->end_local || closed)
+                return;
+
+            if (st->headers_sent) {
+                st->data.append(chunk.data(), chunk.size());
+                flush(st);
+                return;
+            }
+
+            st->raw.append(chunk.data(), chunk.size());
+            size_t pos = st->raw.find("\r\n\r\n");
+            if (pos == std::string::npos)
+                return;
+
+            http::response_parser<http::empty_body> parser;
+            boost::beast::error_code ec;
+            parser.put(boost::asio::buffer(st->raw.data(), pos + 4), ec);
+            if (!parser.is_header_done()) {
+                reset(st->id, internal_error);
+                return;
+            }
+            send_headers(st, parser.get(), false);
+            st->data.append(st->raw, pos + 4, std::string::npos);
+            st->raw.clear();
+            flush(st);
+        }
+
+        // End response of stream
+        void end(const stream_ptr& st)
+        {
+            if (st->reset || st->end_pending || st->end_local || closed)
+                return;
+            if (!st->headers_sent) {
+                reset(st->id, internal_error);
+                return;
+            }
+            st->end_pending = true;
+            flush(st);
+        }
+
+    public:
+        http2_connection(const session_ptr& c, const http2_options& o,
+            dispatcher d)
+        : conn(c)
+        , strand(static_cast<boost::asio::io_context&>(
+            boost::asio::query(c->get_executor(),
+                boost::asio::execution::context)).get_executor())
+        , opt(o)
+        , dispatch_request(std::move(d))
+        { }
+
+        // Start connection where client sent the preface right away
+        // (prior knowledge)
+        void start()
+        {
+            auto s = shared_from_this();
+            boost::asio::dispatch(strand, [s] {
+                s->send_settings();
+                s->read();
+            });
+        }
+
+        // Start connection upgraded from HTTP/1.1 request. The request
+        // becomes the first stream. Unread is data received after the
+        // request, settings is value of HTTP2-Settings header.
+        void start(const request_message& req,
+            boost::asio::const_buffer unread, boost::string_view settings)
+        {
+            auto st = std::make_shared<http2_stream>(shared_from_this(), 1, 0);
+            st->req = req;
+            st->req.erase(http::field::upgrade);
+            st->req.erase(http::field::connection);
+            st->req.erase("HTTP2-Settings");
+
+            boost::asio::buffer_copy(in.prepare(unread.size()), unread);
+            in.commit(unread.size());
+
+            // Settings are base64url encoded payload of SETTINGS frame
+            std::string b64(settings.data(), settings.size());
+            std::replace(b64.begin(), b64.end(), '-', '+');
+            std::replace(b64.begin(), b64.end(), '_', '/');
+            std::string payload(
+                boost::beast::detail::base64::decoded_size(b64.size()), '\0');
+            auto n = boost::beast::detail::base64::decode(
+                &payload[0], b64.data(), b64.size());
+            payload.resize(n.first);
+
+            auto s = shared_from_this();
+            boost::asio::dispatch(strand, [s, st, payload] {
+                static const char switching[] =
+                    "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Upgrade: h2c\r\n\r\n";
+                s->out.append(switching, sizeof(switching) - 1);
+                s->send_settings();
+
+                if (payload.size() % 6) {
+                    s->fail(protocol_error);
+                    return;
+                }
+                if (!s->apply_settings(
+                    reinterpret_cast<const uint8_t*>(payload.data()),
+                    payload.size()))
+                    return;
+
+                st->window = s->peer_window;
+                s->last_stream = 1;
+                s->streams.emplace(1, st);
+                s->submit(st);
+
+                if (s->process())
+                    s->read();
+            });
+        }
+    };
+
+
+    inline http2_stream::executor_type http2_stream::get_executor() {
+        return owner->strand;
+    }
+
+    inline tcp::socket* http2_stream::socket() {
+        return owner->conn->socket();
+    }
+
+    inline void http2_stream::async_read(boost::beast::flat_buffer&,
+        request_message& msg, handler h)
+    {
+        // Request is already received by connection
+        msg = std::move(req);
+        boost::asio::post(owner->strand, [h] { h({ }); });
+    }
+
+    inline void http2_stream::async_read_some(
+        boost::asio::mutable_buffer, read_handler h)
+    {
+        boost::asio::post(owner->strand, [h] {
+            h(boost::asio::error::operation_not_supported, 0);
+        });
+    }
+
+    inline void http2_stream::async_write(response_message& msg, handler h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st, &msg, h] {
+            st->owner->respond(st, msg);
+            h({ });
+        });
+    }
+
+    inline void http2_stream::async_write(shared_response_message& msg, handler h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st, &msg, h] {
+            st->owner->respond(st, msg);
+            h({ });
+        });
+    }
+
+    inline void http2_stream::async_write(boost::asio::const_buffer buf, handler h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        std::string chunk(static_cast<const char*>(buf.data()), buf.size());
+        boost::asio::dispatch(owner->strand, [st, chunk, h] {
+            st->owner->respond_raw(st, chunk);
+            h({ });
+        });
+    }
+
+    inline void http2_stream::shutdown()
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st] {
+            st->owner->end(st);
+        });
+    }
+
+    inline void http2_stream::on_disconnect(std::function<void()> h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st, h] {
+            if (st->reset)
+                h();
+            else
+                st->disconnected = h;
+        });
+    }
+
+} // namespace rest
+
+#endif // REST_HTTP2_HPP
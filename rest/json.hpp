@@ -0,0 +1,819 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef REST_JSON_HPP
+#define REST_JSON_HPP
+
+#include <rest/forward.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+namespace rest {
+
+    // Read-only view of a value in a JSON document. The document is
+    // validated once by parse(), nothing else is decoded until accessed.
+    // Members and elements are found by skipping over the text, views
+    // refer to the text and are valid as long as it is.
+    struct json_value {
+        enum class kind { null, boolean, number, string, array, object };
+
+        struct iterator;
+
+    private:
+        boost::string_view text;
+        // Name of object member as in document
+        boost::string_view key;
+
+        json_value(boost::string_view t, boost::string_view k = { }) noexcept
+        : text(t)
+        , key(k)
+        { }
+
+        static bool is_space(char c) noexcept {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+        }
+
+        static void skip_space(const char*& p, const char* end) noexcept {
+            while (p != end && is_space(*p))
+                ++p;
+        }
+
+        static bool is_digit(char c) noexcept {
+            return c >= '0' && c <= '9';
+        }
+
+        static int hex(char c) noexcept {
+            if (is_digit(c))
+                return c - '0';
+            c |= 0x20;
+            return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        }
+
+        // Skip string of valid document, p is at the opening quote.
+        // Looks for quotes only, escapes are rare.
+        static void skip_string(const char*& p, const char* end) noexcept
+        {
+            for (++p; ; ) {
+                auto q = static_cast<const char*>(std::memchr(p, '"', end - p));
+                p = q + 1;
+                // Quote is escaped if preceded by odd number of backslashes
+                size_t n = 0;
+                while (q[-1 - n] == '\\')
+                    ++n;
+                if (n % 2 == 0)
+                    return;
+            }
+        }
+
+        // Skip value of valid document
+        static void skip_value(const char*& p, const char* end) noexcept
+        {
+            if (*p == '"') {
+                skip_string(p, end);
+                return;
+            }
+            if (*p != '{' && *p != '[') {
+                while (p != end && *p != ',' && *p != ']' && *p != '}' && !is_space(*p))
+                    ++p;
+                return;
+            }
+            for (int depth = 0; ; ) {
+                switch (*p) {
+                case '"':
+                    skip_string(p, end);
+                    continue;
+                case '{': case '[':
+                    ++depth;
+                    break;
+                case '}': case ']':
+                    if (--depth == 0) {
+                        ++p;
+                        return;
+                    }
+                    break;
+                }
+                ++p;
+            }
+        }
+
+        // Validation of untrusted document
+
+        static bool check_string(const char*& p, const char* end) noexcept
+        {
+            for (++p; p != end; ++p) {
+                auto c = static_cast<unsigned char>(*p);
+                if (c == '"') {
+                    ++p;
+                    return true;
+                }
+                if (c < 0x20)
+                    return false;
+                if (c != '\\')
+                    continue;
+                if (++p == end)
+                    return false;
+                switch (*p) {
+                case '"': case '\\': case '/': case 'b':
+                case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    if (end - p < 5)
+                        return false;
+                    for (int i = 1; i <= 4; ++i) {
+                        if (hex(p[i]) < 0)
+                            return false;
+                    }
+                    p += 4;
+                    break;
+                default:
+                    return false;
+                }
+            }
+            return false;
+        }
+
+        static bool check_digits(const char*& p, const char* end) noexcept
+        {
+            auto start = p;
+            while (p != end && is_digit(*p))
+                ++p;
+            return p != start;
+        }
+
+        static bool check_number(const char*& p, const char* end) noexcept
+        {
+            if (*p == '-')
+                ++p;
+            if (p != end && *p == '0')
+                ++p;
+            else if (!check_digits(p, end))
+                return false;
+            if (p != end && *p == '.') {
+                if (!check_digits(++p, end))
+                    return false;
+            }
+            if (p != end && (*p == 'e' || *p == 'E')) {
+                if (++p != end && (*p == '+' || *p == '-'))
+                    ++p;
+                if (!check_digits(p, end))
+                    return false;
+            }
+            return true;
+        }
+
+        static bool check_literal(const char*& p, const char* end,
+            boost::string_view lit) noexcept
+        {
+            if (size_t(end - p) < lit.size() || lit.compare(0, lit.size(), p, lit.size()))
+                return false;
+            p += lit.size();
+            return true;
+        }
+
+        static bool check_value(const char*& p, const char* end, unsigned depth) noexcept
+        {
+            skip_space(p, end);
+            if (p == end)
+                return false;
+
+            switch (*p) {
+            case '"':
+                return check_string(p, end);
+            case 't':
+                return check_literal(p, end, "true");
+            case 'f':
+                return check_literal(p, end, "false");
+            case 'n':
+                return check_literal(p, end, "null");
+            case '{': case '[':
+                break;
+            default:
+                return check_number(p, end);
+            }
+
+            if (depth == 0)
+                return false;
+            const char close = *p == '{' ? '}' : ']';
+            ++p;
+            skip_space(p, end);
+            if (p != end && *p == close) {
+                ++p;
+                return true;
+            }
+
+            for (;;) {
+                if (close == '}') {
+                    skip_space(p, end);
+                    if (p == end || *p != '"' || !check_string(p, end))
+                        return false;
+                    skip_space(p, end);
+                    if (p == end || *p++ != ':')
+                        return false;
+                }
+                if (!check_value(p, end, depth - 1))
+                    return false;
+                skip_space(p, end);
+                if (p == end)
+                    return false;
+                if (*p == close) {
+                    ++p;
+                    return true;
+                }
+                if (*p++ != ',')
+                    return false;
+            }
+        }
+
+        static void append_utf8(std::string& out, unsigned long cp)
+        {
+            if (cp < 0x80)
+                out += char(cp);
+            else if (cp < 0x800) {
+                out += char(0xc0 | cp >> 6);
+                out += char(0x80 | (cp & 0x3f));
+            }
+            else if (cp < 0x10000) {
+                out += char(0xe0 | cp >> 12);
+                out += char(0x80 | (cp >> 6 & 0x3f));
+                out += char(0x80 | (cp & 0x3f));
+            }
+            else {
+                out += char(0xf0 | cp >> 18);
+                out += char(0x80 | (cp >> 12 & 0x3f));
+                out += char(0x80 | (cp >> 6 & 0x3f));
+                out += char(0x80 | (cp & 0x3f));
+            }
+        }
+
+        static unsigned long read_hex4(const char* p) noexcept {
+            return hex(p[0]) << 12 | hex(p[1]) << 8 | hex(p[2]) << 4 | hex(p[3]);
+        }
+
+        // Unescaped content of string without quotes
+        static std::string unescape(boost::string_view s)
+        {
+            std::string out;
+            out.reserve(s.size());
+            for (auto p = s.begin(), end = s.end(); p != end; ++p) {
+                if (*p != '\\') {
+                    out += *p;
+                    continue;
+                }
+                switch (*++p) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned long cp = read_hex4(p + 1);
+                    p += 4;
+                    // Surrogate pair
+                    if (cp >= 0xd800 && cp < 0xdc00 && end - p > 6 &&
+                        p[1] == '\\' && p[2] == 'u')
+                    {
+                        unsigned long lo = read_hex4(p + 3);
+                        if (lo >= 0xdc00 && lo < 0xe000) {
+                            cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                            p += 6;
+                        }
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default:
+                    out += *p;
+                }
+            }
+            return out;
+        }
+
+    public:
+        // Missing value
+        json_value() noexcept = default;
+
+        // Validate document, return missing value if it is not valid
+        // JSON or nested deeper than max_depth
+        static json_value parse(boost::string_view doc, unsigned max_depth = 64) noexcept
+        {
+            auto p = doc.begin(), end = doc.end();
+            if (!check_value(p, end, max_depth))
+                return { };
+            skip_space(p, end);
+            if (p != end)
+                return { };
+
+            auto first = doc.begin();
+            skip_space(first, end);
+            auto last = end;
+            while (is_space(last[-1]))
+                --last;
+            return json_value({ first, size_t(last - first) });
+        }
+
+        // False if value is missing (ex. member not found)
+        explicit operator bool() const noexcept {
+            return !text.empty();
+        }
+
+        // Type of value, null if missing
+        kind type() const noexcept
+        {
+            if (text.empty())
+                return kind::null;
+            switch (text.front()) {
+            case 'n': return kind::null;
+            case 't': case 'f': return kind::boolean;
+            case '"': return kind::string;
+            case '[': return kind::array;
+            case '{': return kind::object;
+            default: return kind::number;
+            }
+        }
+
+        bool is_null() const noexcept {
+            return type() == kind::null;
+        }
+
+        // Text of value as in document
+        boost::string_view raw() const noexcept {
+            return text;
+        }
+
+        // Name of object member as in document, without quotes
+        boost::string_view name() const noexcept {
+            return key;
+        }
+
+        bool as_bool() const noexcept {
+            return !text.empty() && text.front() == 't';
+        }
+
+        // Number value, 0 if not a number
+        double as_double() const
+        {
+            if (type() != kind::number)
+                return 0;
+            // Copy for null terminated string
+            char buf[64];
+            if (text.size() < sizeof(buf)) {
+                std::memcpy(buf, text.data(), text.size());
+                buf[text.size()] = 0;
+                return std::strtod(buf, nullptr);
+            }
+            return std::strtod(text.to_string().c_str(), nullptr);
+        }
+
+        // Integral part of number value, 0 if not a number. Values out
+        // of range are saturated.
+        long long as_int() const
+        {
+            using limits = std::numeric_limits<long long>;
+            if (type() != kind::number)
+                return 0;
+            auto p = text.begin(), end = text.end();
+            bool neg = *p == '-';
+            if (neg)
+                ++p;
+            // Magnitude of the minimum is one more than of the maximum
+            const unsigned long long max =
+                static_cast<unsigned long long>(limits::max()) + neg;
+            unsigned long long v = 0;
+            for (; p != end && is_digit(*p); ++p) {
+                unsigned d = *p - '0';
+                if (v > (max - d) / 10)
+                    return neg ? limits::min() : limits::max();
+                v = v * 10 + d;
+            }
+            // Exponent, let strtod deal with it
+            if (p != end && *p != '.') {
+                double d = as_double();
+                if (d >= 9223372036854775807.0)
+                    return limits::max();
+                if (d <= -9223372036854775808.0)
+                    return limits::min();
+                return static_cast<long long>(d);
+            }
+            if (!neg)
+                return static_cast<long long>(v);
+            return v == max ? limits::min() : -static_cast<long long>(v);
+        }
+
+        // Content of string with escapes resolved, text of other values
+        std::string as_string() const
+        {
+            if (type() != kind::string)
+                return text.to_string();
+            auto s = text.substr(1, text.size() - 2);
+            if (s.find('\\') == boost::string_view::npos)
+                return s.to_string();
+            return unescape(s);
+        }
+
+        // Content of string as in document (escapes are not resolved)
+        boost::string_view as_string_view() const noexcept {
+            if (type() != kind::string)
+                return text;
+            return text.substr(1, text.size() - 2);
+        }
+
+        // Elements of array or members of object
+        iterator begin() const noexcept;
+        iterator end() const noexcept;
+
+        // Number of elements of array or members of object
+        size_t size() const noexcept;
+
+        // Member of object, missing value if not found
+        json_value operator[](boost::string_view name) const;
+
+        // Element of array, missing value if out of range
+        json_value operator[](size_t index) const noexcept;
+    };
+
+
+    struct json_value::iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = json_value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const json_value*;
+        using reference = const json_value&;
+
+    private:
+        friend struct json_value;
+
+        // Start of current value, the closing bracket at end
+        const char* pos = nullptr;
+        const char* next = nullptr;
+        const char* last = nullptr;
+        json_value cur;
+
+        iterator(const char* p, const char* e) noexcept
+        : next(p)
+        , last(e)
+        {
+            load();
+        }
+
+        // Read value following current one
+        void load() noexcept
+        {
+            pos = next;
+            skip_space(pos, last);
+            if (pos == last)
+                return;
+
+            auto p = pos;
+            boost::string_view name;
+            if (*last == '}') {
+                skip_string(p, last);
+                name = { pos + 1, size_t(p - pos - 2) };
+                skip_space(p, last);
+                // Colon
+                ++p;
+                skip_space(p, last);
+            }
+            auto start = p;
+            skip_value(p, last);
+            cur = json_value({ start, size_t(p - start) }, name);
+            skip_space(p, last);
+            // Comma or closing bracket
+            if (*p == ',')
+                ++p;
+            next = p;
+        }
+
+    public:
+        iterator() noexcept = default;
+
+        reference operator*() const noexcept {
+            return cur;
+        }
+        pointer operator->() const noexcept {
+            return &cur;
+        }
+
+        iterator& operator++() noexcept {
+            load();
+            return *this;
+        }
+        iterator operator++(int) noexcept {
+            auto tmp = *this;
+            load();
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const noexcept {
+            return pos == other.pos;
+        }
+        bool operator!=(const iterator& other) const noexcept {
+            return pos != other.pos;
+        }
+    };
+
+
+    inline json_value::iterator json_value::begin() const noexcept
+    {
+        auto t = type();
+        if (t != kind::array && t != kind::object)
+            return { };
+        // Iterator ends at the closing bracket
+        return { text.data() + 1, text.data() + text.size() - 1 };
+    }
+
+    inline json_value::iterator json_value::end() const noexcept
+    {
+        iterator it;
+        auto t = type();
+        if (t == kind::array || t == kind::object)
+            it.pos = text.data() + text.size() - 1;
+        return it;
+    }
+
+    inline size_t json_value::size() const noexcept {
+        return std::distance(begin(), end());
+    }
+
+    inline json_value json_value::operator[](boost::string_view name) const
+    {
+        for (auto it = begin(), last = end(); it != last; ++it) {
+            auto k = it->name();
+            if (k.find('\\') == boost::string_view::npos ? k == name : unescape(k) == name)
+                return *it;
+        }
+        return { };
+    }
+
+    inline json_value json_value::operator[](size_t index) const noexcept
+    {
+        for (auto it = begin(), last = end(); it != last; ++it, --index) {
+            if (index == 0)
+                return *it;
+        }
+        return { };
+    }
+
+
+    // Writes JSON directly into a buffer, ex. body of response. Commas
+    // are placed automatically, nesting is not checked.
+    //
+    //   w.begin_object().key("pi").value(3.141).end_object();
+    struct json_writer {
+        using buffer_type = boost::beast::multi_buffer;
+
+    private:
+        buffer_type& buf;
+        // Prepared space of buffer written so far
+        char* first = nullptr;
+        char* pos = nullptr;
+        char* last = nullptr;
+        // Next value is preceded by comma
+        bool comma = false;
+
+        // Commit written and prepare space for more
+        void grow()
+        {
+            commit();
+            auto mb = buf.prepare(4096);
+            auto b = *boost::asio::buffer_sequence_begin(mb);
+            first = pos = static_cast<char*>(b.data());
+            last = first + b.size();
+        }
+
+        void put(char c)
+        {
+            if (pos == last)
+                grow();
+            *pos++ = c;
+        }
+
+        void put(const char* s, size_t n)
+        {
+            while (n) {
+                if (pos == last)
+                    grow();
+                size_t k = std::min(n, size_t(last - pos));
+                std::memcpy(pos, s, k);
+                pos += k;
+                s += k;
+                n -= k;
+            }
+        }
+
+        void separate()
+        {
+            if (comma)
+                put(',');
+            comma = true;
+        }
+
+        void quote(boost::string_view s)
+        {
+            static const char hex[] = "0123456789abcdef";
+            put('"');
+            auto run = s.begin();
+            for (auto p = s.begin(); p != s.end(); ++p) {
+                auto c = static_cast<unsigned char>(*p);
+                if (c >= 0x20 && c != '"' && c != '\\')
+                    continue;
+                put(run, p - run);
+                run = p + 1;
+                put('\\');
+                switch (c) {
+                case '"': put('"'); break;
+                case '\\': put('\\'); break;
+                case '\b': put('b'); break;
+                case '\f': put('f'); break;
+                case '\n': put('n'); break;
+                case '\r': put('r'); break;
+                case '\t': put('t'); break;
+                default:
+                    put("u00", 3);
+                    put(hex[c >> 4]);
+                    put(hex[c & 15]);
+                }
+            }
+            put(run, s.end() - run);
+            put('"');
+        }
+
+        template <class T>
+        void integer(T v)
+        {
+            char tmp[24];
+            char* p = tmp + sizeof(tmp);
+            // Negate as unsigned, minimum value has no positive counterpart
+            using U = typename std::make_unsigned<T>::type;
+            U u = v < 0 ? U(0) - U(v) : U(v);
+            do {
+                *--p = char('0' + u % 10);
+                u /= 10;
+            } while (u);
+            if (v < 0)
+                *--p = '-';
+            put(p, tmp + sizeof(tmp) - p);
+        }
+
+        void number(double v)
+        {
+            // Not representable in JSON
+            if (!std::isfinite(v)) {
+                put("null", 4);
+                return;
+            }
+            char tmp[32];
+#if defined(__cpp_lib_to_chars)
+            // Shortest representation that reads back the same
+            auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            put(tmp, r.ptr - tmp);
+#else
+            // Integral values are exact as integers
+            if (v == std::floor(v) && std::fabs(v) < 9007199254740992.0 && (v || !std::signbit(v))) {
+                integer(static_cast<long long>(v));
+                return;
+            }
+            int n = std::snprintf(tmp, sizeof(tmp), "%.15g", v);
+            if (std::strtod(tmp, nullptr) != v)
+                n = std::snprintf(tmp, sizeof(tmp), "%.17g", v);
+            // Decimal comma of locale
+            std::replace(tmp, tmp + n, ',', '.');
+            put(tmp, n);
+#endif
+        }
+
+    public:
+        json_writer(buffer_type& b) noexcept
+        : buf(b)
+        { }
+
+        json_writer(const json_writer&) = delete;
+        json_writer& operator=(const json_writer&) = delete;
+
+        ~json_writer() {
+            commit();
+        }
+
+        // Make written data part of buffer. Called by destructor.
+        void commit()
+        {
+            buf.commit(pos - first);
+            first = pos;
+        }
+
+        json_writer& begin_object() {
+            separate();
+            put('{');
+            comma = false;
+            return *this;
+        }
+        json_writer& end_object() {
+            put('}');
+            comma = true;
+            return *this;
+        }
+
+        json_writer& begin_array() {
+            separate();
+            put('[');
+            comma = false;
+            return *this;
+        }
+        json_writer& end_array() {
+            put(']');
+            comma = true;
+            return *this;
+        }
+
+        // Name of object member, followed by its value
+        json_writer& key(boost::string_view name) {
+            separate();
+            quote(name);
+            put(':');
+            comma = false;
+            return *this;
+        }
+
+        json_writer& value(boost::string_view s) {
+            separate();
+            quote(s);
+            return *this;
+        }
+        json_writer& value(const char* s) {
+            return value(boost::string_view(s));
+        }
+        json_writer& value(const std::string& s) {
+            return value(boost::string_view(s));
+        }
+
+        json_writer& value(bool b) {
+            separate();
+            if (b)
+                put("true", 4);
+            else
+                put("false", 5);
+            return *this;
+        }
+
+        json_writer& value(std::nullptr_t) {
+            separate();
+            put("null", 4);
+            return *this;
+        }
+
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value, json_writer&>::type
+        value(T v) {
+            separate();
+            integer(v);
+            return *this;
+        }
+
+        // Not finite numbers are written as null
+        json_writer& value(double v) {
+            separate();
+            number(v);
+            return *this;
+        }
+
+        // Value of parsed document, written as is
+        json_writer& value(const json_value& v) {
+            if (!v)
+                return value(nullptr);
+            separate();
+            put(v.raw().data(), v.raw().size());
+            return *this;
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_JSON_HPP
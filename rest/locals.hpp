@@ -0,0 +1,177 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef REST_LOCALS_HPP
+#define REST_LOCALS_HPP
+
+#include <rest/forward.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace rest {
+
+    // Values middlewares attach to a request for handlers that follow,
+    // ex. authenticated user or trace id. Small values of the first
+    // keys are kept inline, a request does not allocate for them.
+    struct locals {
+        // Bytes of values kept inline, larger ones are allocated
+        static constexpr size_t inline_size = 128;
+        // Keys with a slot inline, values of other keys are found by search
+        static constexpr size_t inline_slots = 8;
+
+        // Key of a value of type T. Keys are meant to be created once
+        // at startup, each takes a slot of its own.
+        //
+        //   static const rest::locals::key<user> current_user;
+        template <class T>
+        struct key {
+        private:
+            friend struct locals;
+            const size_t slot;
+
+        public:
+            key() noexcept
+            : slot(next_slot())
+            { }
+
+            key(const key&) = delete;
+            key& operator=(const key&) = delete;
+        };
+
+    private:
+        struct entry {
+            size_t slot;
+            void* value;
+            void (*destroy)(void*);
+        };
+
+        typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type arena;
+        size_t used = 0;
+        entry slots[inline_slots] = { };
+        std::vector<entry> more;
+
+        static size_t next_slot() noexcept {
+            static std::atomic<size_t> n { 0 };
+            return n++;
+        }
+
+        // Entry of slot, null if key has none yet
+        entry* find(size_t slot) noexcept
+        {
+            if (slot < inline_slots)
+                return &slots[slot];
+            for (auto& e : more) {
+                if (e.slot == slot)
+                    return &e;
+            }
+            return nullptr;
+        }
+
+        template <class T>
+        static void destroy_inline(void* p) noexcept {
+            static_cast<T*>(p)->~T();
+        }
+
+        template <class T>
+        static void destroy_allocated(void* p) noexcept {
+            delete static_cast<T*>(p);
+        }
+
+        // Space in arena for T, null if it does not fit
+        template <class T>
+        void* allocate() noexcept
+        {
+            size_t offset = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+            if (offset + sizeof(T) > inline_size)
+                return nullptr;
+            used = offset + sizeof(T);
+            return reinterpret_cast<unsigned char*>(&arena) + offset;
+        }
+
+    public:
+        locals() noexcept = default;
+
+        locals(const locals&) = delete;
+        locals& operator=(const locals&) = delete;
+
+        ~locals()
+        {
+            for (auto& e : more) {
+                if (e.value)
+                    e.destroy(e.value);
+            }
+            for (auto& e : slots) {
+                if (e.value)
+                    e.destroy(e.value);
+            }
+        }
+
+        // Construct value of key, replacing previous one. Space of a
+        // replaced inline value is not reused.
+        template <class T, class... Args>
+        T& emplace(const key<T>& k, Args&&... args)
+        {
+            static_assert(alignof(T) <= alignof(std::max_align_t),
+                "over-aligned values are not supported");
+
+            auto e = find(k.slot);
+            if (!e) {
+                more.push_back({ k.slot, nullptr, nullptr });
+                e = &more.back();
+            }
+            else if (e->value) {
+                e->destroy(e->value);
+                e->value = nullptr;
+            }
+
+            T* value;
+            void (*destroy)(void*);
+            if (void* p = allocate<T>()) {
+                value = new (p) T(std::forward<Args>(args)...);
+                destroy = &destroy_inline<T>;
+            }
+            else {
+                value = new T(std::forward<Args>(args)...);
+                destroy = &destroy_allocated<T>;
+            }
+            *e = { k.slot, value, destroy };
+            return *value;
+        }
+
+        // Value of key, null if not set
+        template <class T>
+        T* get(const key<T>& k) noexcept {
+            auto e = find(k.slot);
+            return e ? static_cast<T*>(e->value) : nullptr;
+        }
+
+        template <class T>
+        const T* get(const key<T>& k) const noexcept {
+            return const_cast<locals*>(this)->get(k);
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_LOCALS_HPP
@@ -26,37 +26,135 @@
 namespace rest {
 
     struct mime_type {
-        using table_type = std::map<boost::string_view, boost::string_view>;
+        using table_type =
+            std::map<boost::string_view, boost::string_view, boost::beast::iless>;
 
-        // Filename extension to mime type map.
+    private:
+        struct entry {
+            const char* ext;
+            const char* type;
+        };
+
+        struct slot {
+            boost::string_view ext;
+            boost::string_view type;
+        };
+
+        template <size_t...>
+        struct sequence { };
+
+        template <size_t N, size_t... I>
+        struct make_sequence : make_sequence<N - 1, N - 1, I...> { };
+
+        template <size_t... I>
+        struct make_sequence<0, I...> {
+            using type = sequence<I...>;
+        };
+
+        // Built-in types, extensions without dot in lower case. Placed
+        // in a table of slots by hash at compile time. When adding a type
+        // the hash may need new factors to stay free of collisions.
+        template <class = void>
+        struct builtin {
+            static constexpr entry list[] = {
+                { "bmp",   "image/bmp" },
+                { "css",   "text/css" },
+                { "flv",   "video/x-flv" },
+                { "gif",   "image/gif" },
+                { "htm",   "text/html" },
+                { "html",  "text/html" },
+                { "ico",   "image/vnd.microsoft.icon" },
+                { "jpe",   "image/jpeg" },
+                { "jpeg",  "image/jpeg" },
+                { "jpg",   "image/jpeg" },
+                { "js",    "application/javascript" },
+                { "json",  "application/json" },
+                { "php",   "text/html" },
+                { "png",   "image/png" },
+                { "svg",   "image/svg+xml" },
+                { "svgz",  "image/svg+xml" },
+                { "swf",   "application/x-shockwave-flash" },
+                { "tif",   "image/tiff" },
+                { "tiff",  "image/tiff" },
+                { "txt",   "text/plain" },
+                { "xml",   "application/xml" },
+            };
+            static constexpr size_t size = sizeof(list) / sizeof(list[0]);
+            static constexpr size_t slots = 32;
+
+            static constexpr char lower(char c) noexcept {
+                return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+            }
+
+            static constexpr size_t length(const char* s) noexcept {
+                return *s ? 1 + length(s + 1) : 0;
+            }
+
+            // Case-insensitive, extension of at least 2 characters
+            static constexpr size_t hash(const char* s, size_t n) noexcept {
+                return (size_t(lower(s[0])) * 6 + size_t(lower(s[1])) * 14 +
+                    size_t(lower(s[n - 1])) * 15 + n * 7) % slots;
+            }
+
+            static constexpr size_t hash(size_t i) noexcept {
+                return hash(list[i].ext, length(list[i].ext));
+            }
+
+            // Number of extensions with hash h
+            static constexpr size_t count(size_t h, size_t i = 0) noexcept {
+                return i == size ? 0 : (hash(i) == h) + count(h, i + 1);
+            }
+
+            static constexpr bool perfect(size_t h = 0) noexcept {
+                return h == slots || (count(h) <= 1 && perfect(h + 1));
+            }
+
+            // Index of extension with hash h, size if none
+            static constexpr size_t find(size_t h, size_t i = 0) noexcept {
+                return i == size || hash(i) == h ? i : find(h, i + 1);
+            }
+
+            static constexpr slot make(size_t i) noexcept {
+                return i == size ? slot { { }, { } } : slot {
+                    { list[i].ext, length(list[i].ext) },
+                    { list[i].type, length(list[i].type) } };
+            }
+
+            template <size_t... H>
+            static const slot* table(sequence<H...>) noexcept {
+                static const slot t[] = { make(find(H))... };
+                return t;
+            }
+
+            static const slot* table() noexcept {
+                static_assert(perfect(), "collision in hash of mime types");
+                return table(typename make_sequence<slots>::type());
+            }
+        };
+
+        // Extension of file name including dot, empty if none
+        static boost::string_view extension(const fs::path& filename) noexcept
+        {
+            boost::string_view name(filename.native());
+            auto slash = name.rfind('/');
+            if (slash != boost::string_view::npos)
+                name.remove_prefix(slash + 1);
+            if (name == "." || name == "..")
+                return { };
+            auto dot = name.rfind('.');
+            return dot == boost::string_view::npos ?
+                boost::string_view() : name.substr(dot);
+        }
+
+    public:
+        // Types added or replaced by user, checked before the built-in
+        // ones. Lookup is case-insensitive.
         // Extend example:
         //   rest::mime_type::table().emplace(".mp4", "video/mp4");
         // Modify example:
         //   rest::mime_type::table()[".js"] = "text/javascript";
         static table_type& table() noexcept {
-            static table_type t {
-                { ".bmp",   "image/bmp" },
-                { ".css",   "text/css" },
-                { ".flv",   "video/x-flv" },
-                { ".gif",   "image/gif" },
-                { ".htm",   "text/html" },
-                { ".html",  "text/html" },
-                { ".ico",   "image/vnd.microsoft.icon" },
-                { ".jpe",   "image/jpeg" },
-                { ".jpeg",  "image/jpeg" },
-                { ".jpg",   "image/jpeg" },
-                { ".js",    "application/javascript" },
-                { ".json",  "application/json" },
-                { ".php",   "text/html" },
-                { ".png",   "image/png" },
-                { ".svg",   "image/svg+xml" },
-                { ".svgz",  "image/svg+xml" },
-                { ".swf",   "application/x-shockwave-flash" },
-                { ".tif",   "image/tiff" },
-                { ".tiff",  "image/tiff" },
-                { ".txt",   "text/plain" },
-                { ".xml",   "application/xml" },
-            };
+            static table_type t;
             return t;
         }
 
@@ -71,13 +169,23 @@ namespace rest {
         // Return a reasonable mime type based on the extension of a file
         static const boost::string_view& resolve(const fs::path& filename) noexcept
         {
-            auto ext = filename.extension();
-            if (!ext.empty()) {
-                const table_type& t = table();
-                auto it = t.find(ext.native());
+            auto ext = extension(filename);
+            if (ext.empty())
+                return default_type();
+
+            const table_type& t = table();
+            if (!t.empty()) {
+                auto it = t.find(ext);
                 if (it != t.end())
                     return it->second;
             }
+
+            ext.remove_prefix(1);
+            if (ext.size() >= 2) {
+                auto& s = builtin<>::table()[builtin<>::hash(ext.data(), ext.size())];
+                if (boost::beast::iequals(s.ext, ext))
+                    return s.type;
+            }
             return default_type();
         }
 
@@ -85,9 +193,13 @@ namespace rest {
         mime_type() noexcept {
             table();
             default_type();
+            builtin<>::table();
         }
     };
 
+    template <class T>
+    constexpr mime_type::entry mime_type::builtin<T>::list[];
+
 } // namespace rest
 
 #endif // REST_MIME_TYPE_HPP
@@ -26,39 +26,104 @@
 namespace rest {
 
     struct next {
+        // Chain of handlers (one per router) that next continues. The
+        // chain is resumed if next is called after handler returned.
+        struct frame {
+            virtual ~frame() { }
+            virtual void resume() = 0;
+
+            bool running = false;
+            bool proceed = false;
+        };
+
     private:
         struct impl {
-            bool proceed = false;
             error err;
+            // Not owned, frames own their next
+            std::weak_ptr<frame> current;
         };
 
         std::shared_ptr<impl> self;
+        // Frame invoking the handler when this copy was made, a copy
+        // kept for a later call keeps the chain alive
+        std::shared_ptr<frame> hold;
+
+        // Frame used when handler is invoked without a chain to resume
+        struct sync_frame : frame {
+            void resume() override { }
+        };
+
+        static void proceed(const std::shared_ptr<frame>& f) noexcept {
+            if (!f || f->proceed)
+                return;
+            f->proceed = true;
+            // Handler already returned, continue the chain from here
+            if (!f->running)
+                f->resume();
+        }
 
     public:
         next()
         : self(std::make_shared<impl>())
         { }
 
+        next(const next& other) noexcept
+        : self(other.self)
+        , hold(other.self->current.lock())
+        { }
+
+        next& operator=(const next& other) noexcept {
+            self = other.self;
+            hold = other.self->current.lock();
+            return *this;
+        }
+
+        // Pass control to the next handler. May be called after handler
+        // returned (from a completion handler of asynchronous operation),
+        // in this case keep a copy of next rather than a reference.
         void operator()() noexcept {
-            self->proceed = true;
+            proceed(self->current.lock());
         }
         void operator()(error&& err) noexcept {
-            self->proceed = true;
             self->err = std::move(err);
+            proceed(self->current.lock());
         }
 
+        // Invoke handler in frame f. Return true if handler called next
+        // before returning, otherwise f will be resumed on later call
+        // to next.
         template <class F>
-        bool safe_invoke(F&& f) noexcept {
-            self->proceed = false;
+        bool safe_invoke(F&& fn, const std::shared_ptr<frame>& f) noexcept {
+            f->running = true;
+            f->proceed = false;
+            self->current = f;
 
             try {
-                std::forward<F>(f)();
+                std::forward<F>(fn)();
             }
-            catch (const std::exception& ex) { operator()(ex); }
-            catch (const boost::system::error_code& ec) { operator()(ec); }
-            catch (...) { operator()("unknown error"); }
+            catch (const std::exception& ex) { self->err = ex; proceed(f); }
+            catch (const boost::system::error_code& ec) { self->err = ec; proceed(f); }
+            catch (...) { self->err = "unknown error"; proceed(f); }
+
+            f->running = false;
+            return f->proceed;
+        }
+
+        template <class F>
+        bool safe_invoke(F&& fn) noexcept {
+            return safe_invoke(
+                std::forward<F>(fn), std::make_shared<sync_frame>());
+        }
 
-            return self->proceed;
+        // Return function calling next on behalf of the handler being
+        // currently invoked. Used to pass control back from a nested chain.
+        std::function<void()> continuation() const {
+            auto s = self;
+            auto f = self->current.lock();
+            return [s, f] {
+                s->current = f;
+                proceed(f);
+            };
         }
 
         const error& err() const noexcept {
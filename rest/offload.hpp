@@ -0,0 +1,131 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_OFFLOAD_HPP
+#define REST_OFFLOAD_HPP
+
+#include <rest/router.hpp>
+
+#include <boost/asio/post.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <atomic>
+#include <thread>
+
+namespace rest {
+
+    // Bounded pool of worker threads for CPU heavy handlers
+    struct offload_pool {
+    private:
+        boost::asio::thread_pool pool;
+        // Jobs waiting for a worker thread, running ones not counted
+        std::atomic<size_t> queued { 0 };
+        const size_t max_queued;
+
+    public:
+        offload_pool(size_t threads = std::thread::hardware_concurrency(),
+            size_t max_queue = 1024)
+        : pool(threads ? threads : 1)
+        , max_queued(max_queue)
+        { }
+
+        // Queue a job. Return false if there are already max_queue
+        // jobs waiting for a worker thread.
+        bool post(std::function<void()> job) {
+            if (queued.fetch_add(1) >= max_queued) {
+                --queued;
+                return false;
+            }
+            boost::asio::post(pool, [this, job] {
+                --queued;
+                job();
+            });
+            return true;
+        }
+
+        // Number of jobs waiting for a worker thread
+        size_t size() const noexcept {
+            return queued;
+        }
+
+        // Wait for all jobs to complete, pool can not be used after this
+        void join() {
+            pool.join();
+        }
+
+        // Default pool with a thread per core
+        static offload_pool& instance() {
+            static offload_pool p;
+            return p;
+        }
+    };
+
+
+    // Run handler on a worker thread of pool instead of the connection
+    // thread. The response may be sent from the handler, it is written
+    // on the connection executor. Calling next (synchronously) continues
+    // the chain on connection executor as well. If pool queue is full
+    // the request is responded with "503 Service Unavailable".
+    inline req_resp_next offload(
+        req_resp_next handler, offload_pool& pool = offload_pool::instance())
+    {
+        auto h = std::make_shared<req_resp_next>(std::move(handler));
+        auto p = &pool;
+
+        return [h, p](const request& req, response& resp, next& n) {
+            request rq = req;
+            response rs = resp;
+            next parent = n;
+
+            bool queued = p->post([h, rq, rs, parent]() mutable {
+                // Client went away while job was queued
+                if (rq.cancelled())
+                    return;
+
+                next local;
+                bool proceed = local.safe_invoke([&] { (*h)(rq, rs, local); });
+                if (!proceed)
+                    return;
+
+                error err = local.err();
+                boost::asio::post(rq.connection()->get_executor(),
+                    [parent, err]() mutable {
+                        if (err)
+                            parent(std::move(err));
+                        else
+                            parent();
+                    });
+            });
+
+            if (!queued)
+                resp.status(503).send();
+        };
+    }
+
+    inline req_resp_next offload(
+        req_resp handler, offload_pool& pool = offload_pool::instance())
+    {
+        return offload(req_resp_next(
+            [handler](const request& req, response& resp, next&) {
+                handler(req, resp);
+            }), pool);
+    }
+
+} // namespace rest
+
+#endif // REST_OFFLOAD_HPP
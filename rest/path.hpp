@@ -64,9 +64,20 @@ namespace rest {
             return (cm.position(0) == 0);
         }
 
-        name_value_map get_params(const boost::string_view& uri) const noexcept
+        // Number of named parameters
+        size_t param_count() const noexcept {
+            return params.size();
+        }
+
+        const std::string& param_name(size_t i) const noexcept {
+            return params[i].second;
+        }
+
+        // Values of parameters in matched uri, in order of appearance
+        void get_values(const boost::string_view& uri,
+            std::vector<boost::string_view>& values) const
         {
-            name_value_map pm;
+            values.clear();
             size_t start = 1;
 
             for (auto& p : params) {
@@ -76,10 +87,19 @@ namespace rest {
                 size_t stop = start;
                 for (; stop < uri.size() && uri[stop] != '/'; ++stop);
 
-                pm.emplace(p.second.c_str(),
-                    boost::string_view(&uri[start], stop - start));
+                values.emplace_back(&uri[start], stop - start);
                 start = stop + 1;
             }
+        }
+
+        name_value_map get_params(const boost::string_view& uri) const
+        {
+            std::vector<boost::string_view> values;
+            get_values(uri, values);
+
+            name_value_map pm;
+            for (size_t i = 0; i < values.size(); ++i)
+                pm.emplace(params[i].second.c_str(), values[i]);
             return pm;
         }
     };
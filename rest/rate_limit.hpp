@@ -0,0 +1,217 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_RATE_LIMIT_HPP
+#define REST_RATE_LIMIT_HPP
+
+#include <rest/router.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace rest {
+
+    struct rate_limit_options {
+        // Tokens added to client bucket per second, i.e. sustained
+        // number of requests per second. Must be greater than 0.
+        double rate = 10;
+
+        // Bucket size, i.e. number of requests allowed in a burst.
+        // Maximum is 65535.
+        unsigned burst = 20;
+
+        // Header holding client key (ex. API key). If empty or header is
+        // not present in request the remote address is used.
+        std::string header;
+
+        // Maximum number of clients tracked at the same time. Memory is
+        // allocated once, 16 bytes per client.
+        size_t capacity = 65536;
+    };
+
+
+    struct rate_limit {
+    private:
+        // Bucket state is packed in one 64-bit word to be updated with
+        // compare-and-swap:
+        //   bits 63..24 - time of last update in ms since table creation
+        //   bits 23..0  - tokens in 1/256 units
+        // Zero state means unused (full) bucket.
+        struct slot {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> state;
+        };
+
+        // Slots probed for a key, one cache line
+        static constexpr size_t probe_size = 4;
+        static constexpr uint64_t token = 256;
+
+        struct table {
+            using clock = std::chrono::steady_clock;
+
+            const clock::time_point epoch = clock::now();
+            const size_t mask;
+            std::unique_ptr<slot[]> slots;
+
+            table(size_t capacity)
+            : mask(round_up(capacity) - 1)
+            , slots(new slot[mask + 1]())
+            { }
+
+            static size_t round_up(size_t n) {
+                size_t p = probe_size;
+                while (p < n)
+                    p <<= 1;
+                return p;
+            }
+
+            // Milliseconds since table creation, never 0
+            uint64_t now() const {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    clock::now() - epoch).count() + 1;
+            }
+
+            // Find slot of the key or take a free one. A slot of other
+            // key is reused (evicted) if its bucket is full again or if
+            // it is the least recently used one among probed slots.
+            slot& find(uint64_t key, uint64_t now, uint64_t idle_ms)
+            {
+                slot* group = &slots[key & mask & ~(probe_size - 1)];
+                slot* victim = nullptr;
+                uint64_t oldest = ~uint64_t(0);
+
+                for (size_t i = 0; i < probe_size; ++i) {
+                    slot& s = group[i];
+                    uint64_t k = s.key.load(std::memory_order_acquire);
+                    if (k == key)
+                        return s;
+
+                    // Another thread may have stored a time later than now
+                    uint64_t ts = s.state.load(std::memory_order_relaxed) >> 24;
+                    if (k == 0 || now - std::min(now, ts) >= idle_ms)
+                        ts = 0;
+                    if (ts < oldest) {
+                        oldest = ts;
+                        victim = &s;
+                    }
+                }
+
+                uint64_t k = victim->key.load(std::memory_order_relaxed);
+                if (victim->key.compare_exchange_strong(k, key))
+                    victim->state.store(0, std::memory_order_release);
+                // Another thread took the slot at the same time, share
+                // it rather than probe again
+                return *victim;
+            }
+        };
+
+        std::shared_ptr<table> tbl;
+        const rate_limit_options opt;
+
+        static uint64_t hash(const void* data, size_t size) noexcept {
+            // FNV-1a
+            uint64_t h = 14695981039346656037ull;
+            auto p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i)
+                h = (h ^ p[i]) * 1099511628211ull;
+            return h ? h : 1;
+        }
+
+        uint64_t client_key(const request& req) const
+        {
+            if (!opt.header.empty()) {
+                auto value = req.get(boost::string_view(opt.header));
+                if (value)
+                    return hash(value->data(), value->size());
+            }
+
+            // Clients of Unix domain socket share one bucket
+            auto sock = req.socket();
+            if (!sock)
+                return hash(nullptr, 0);
+
+            boost::system::error_code ec;
+            auto addr = sock->remote_endpoint(ec).address();
+            if (addr.is_v4()) {
+                auto bytes = addr.to_v4().to_bytes();
+                return hash(bytes.data(), bytes.size());
+            }
+            auto bytes = addr.to_v6().to_bytes();
+            return hash(bytes.data(), bytes.size());
+        }
+
+    public:
+        rate_limit(rate_limit_options options = { })
+        : tbl(std::make_shared<table>(options.capacity))
+        , opt(std::move(options))
+        {
+            if (!(opt.rate > 0))
+                throw std::invalid_argument("rate_limit: rate must be greater than 0");
+        }
+
+        // Take a token from bucket of the key. Return 0 if request is
+        // allowed, otherwise number of milliseconds until next token.
+        uint64_t take(uint64_t key) const
+        {
+            const uint64_t burst = std::min(opt.burst, 65535u) * token;
+            const double per_ms = opt.rate * token / 1000;
+            // Time for empty bucket to become full
+            const uint64_t idle_ms = uint64_t(burst / per_ms) + 1;
+
+            uint64_t now = tbl->now();
+            slot& s = tbl->find(key, now, idle_ms);
+
+            uint64_t state = s.state.load(std::memory_order_acquire);
+            for (;;) {
+                uint64_t tokens = burst;
+                if (state) {
+                    uint64_t elapsed = now - std::min(now, state >> 24);
+                    tokens = std::min(burst,
+                        (state & 0xffffff) + uint64_t(elapsed * per_ms));
+                }
+
+                if (tokens < token)
+                    return uint64_t(std::ceil((token - tokens) / per_ms));
+
+                uint64_t desired = (now << 24) | (tokens - token);
+                if (s.state.compare_exchange_weak(state, desired))
+                    return 0;
+            }
+        }
+
+        void operator()(const request& req, response& resp, next& n) const
+        {
+            uint64_t wait_ms = take(client_key(req));
+            if (!wait_ms) {
+                n();
+                return;
+            }
+
+            resp.set(http::field::retry_after,
+                std::to_string((wait_ms + 999) / 1000));
+            resp.status(429).send();
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_RATE_LIMIT_HPP
@@ -21,7 +21,16 @@
 #ifndef REST_REQUEST_HPP
 #define REST_REQUEST_HPP
 
-#include <rest/forward.hpp>
+#include <rest/json.hpp>
+#include <rest/locals.hpp>
+#include <rest/session.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#if BOOST_VERSION >= 107700
+#include <boost/asio/cancellation_signal.hpp>
+#endif
 
 namespace rest {
 
@@ -32,42 +41,125 @@ namespace rest {
         using socket_ptr = std::shared_ptr<tcp::socket>;
 
         struct impl {
-            impl(const socket_ptr& s) noexcept
-            : socket(s)
+            impl(const session_ptr& s) noexcept
+            : conn(s)
             { }
 
-            socket_ptr socket;
-            http::request<http::dynamic_body> req;
+            session_ptr conn;
+            request_message req;
             boost::beast::flat_buffer buffer { 8192 };
 
             const server* app = nullptr;
             name_value_map params;
+            // Param handlers called for this request
+            std::vector<const void*> param_handlers;
+            // Route tables the names of params point into
+            std::vector<std::shared_ptr<const void>> pinned;
             boost::string_view base_url;
             boost::string_view path;
+
+            // Body copied into one piece, if received in several
+            std::string body;
+            // Set by body parsers
+            json_value json;
+            name_value_map form;
+
+            rest::locals locals;
+
+            // Client disconnected while request was in progress
+            std::atomic<bool> cancelled { false };
+            std::mutex mtx;
+            std::vector<std::function<void()>> on_cancel;
+#if BOOST_VERSION >= 107700
+            boost::asio::cancellation_signal signal;
+#endif
+
+            void cancel()
+            {
+                std::vector<std::function<void()>> handlers;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (cancelled)
+                        return;
+                    cancelled = true;
+                    handlers.swap(on_cancel);
+                }
+                for (auto& h : handlers)
+                    h();
+#if BOOST_VERSION >= 107700
+                signal.emit(boost::asio::cancellation_type::terminal);
+#endif
+            }
         };
 
         std::shared_ptr<impl> self;
 
     public:
-        request(const socket_ptr& s)
+        request(const session_ptr& s)
         : self(std::make_shared<impl>(s))
         { }
 
         // Asynchronous receive of request
         template <class C>
-        static void receive(const socket_ptr& sock, C&& cb) {
-            request req(sock);
-            http::async_read(*sock, req.self->buffer, req.self->req,
-                [req, cb](boost::beast::error_code err, size_t) mutable
+        static void receive(const session_ptr& conn, C&& cb) {
+            request req(conn);
+            conn->async_read(req.self->buffer, req.self->req,
+                [req, cb](boost::beast::error_code err) mutable
             {
                 if (!err) cb(req);
             });
         }
 
-        const socket_ptr& socket() const noexcept {
-            return self->socket;
+        // Connection the request was received on
+        const session_ptr& connection() const noexcept {
+            return self->conn;
+        }
+
+        // The underlying TCP socket of connection, null if connection
+        // is not over TCP (Unix domain socket)
+        socket_ptr socket() const noexcept {
+            auto sock = self->conn->socket();
+            return sock ? socket_ptr(self->conn, sock) : socket_ptr();
         }
 
+        // Watch connection for client disconnect while the request is
+        // processed, see cancelled()
+        void watch() const {
+            std::weak_ptr<impl> w = self;
+            self->conn->on_disconnect([w] {
+                if (auto s = w.lock())
+                    s->cancel();
+            });
+        }
+
+        // True if client disconnected before the request completed.
+        // May be polled from any thread, ex. by offloaded work.
+        bool cancelled() const noexcept {
+            return self->cancelled;
+        }
+
+        // Function called once when client disconnects, on connection
+        // executor. Called right away if client is already gone.
+        void on_cancel(std::function<void()> handler) const
+        {
+            {
+                std::lock_guard<std::mutex> lock(self->mtx);
+                if (!self->cancelled) {
+                    self->on_cancel.emplace_back(std::move(handler));
+                    return;
+                }
+            }
+            handler();
+        }
+
+#if BOOST_VERSION >= 107700
+        // Slot emitting terminal cancellation when client disconnects.
+        // Bind to asynchronous operations running on connection executor.
+        boost::asio::cancellation_slot cancellation_slot() const noexcept {
+            return self->signal.slot();
+        }
+#endif
+
         // Root route (server generated this request)
         const server& app() const noexcept {
             return *self->app;
@@ -98,6 +190,41 @@ namespace rest {
             return self->params;
         }
 
+        // Values attached to request by middlewares, see rest::locals
+        rest::locals& locals() const noexcept {
+            return self->locals;
+        }
+
+        // Request body parsed by rest::json middleware, missing value
+        // if not parsed
+        json_value& json() const noexcept {
+            return self->json;
+        }
+
+        // Fields of request body parsed by rest::urlencoded middleware
+        name_value_map& form() const noexcept {
+            return self->form;
+        }
+
+        // Keep object alive as long as the request, ex. route table
+        // names of params() point into
+        void pin(std::shared_ptr<const void> p) const
+        {
+            auto& v = self->pinned;
+            if (std::find(v.begin(), v.end(), p) == v.end())
+                v.push_back(std::move(p));
+        }
+
+        // Mark param handler as called. Return false if it already was
+        // in this request-response cycle.
+        bool param_called(const void* handler) const {
+            auto& v = self->param_handlers;
+            if (std::find(v.begin(), v.end(), handler) != v.end())
+                return false;
+            v.push_back(handler);
+            return true;
+        }
+
         // Contains a string corresponding to the HTTP method
         // of the request: GET, POST, PUT, and so on
         boost::string_view method_string() const noexcept {
@@ -114,6 +241,51 @@ namespace rest {
             return self->req.target();
         }
 
+        // The underlying HTTP message
+        const request_message& message() const noexcept {
+            return self->req;
+        }
+
+        // Request body as one contiguous buffer. Body received in one
+        // piece is referred to in place unless copy is requested,
+        // otherwise it is copied once. The copy is null terminated.
+        boost::asio::mutable_buffer body(bool copy_body = false) const
+        {
+            auto& copy = self->body;
+            if (copy.empty()) {
+                auto data = self->req.body().data();
+                auto first = boost::asio::buffer_sequence_begin(data);
+                auto last = boost::asio::buffer_sequence_end(data);
+                if (first == last)
+                    return { };
+                if (std::next(first) == last && !copy_body)
+                    return *first;
+
+                copy.resize(boost::asio::buffer_size(data));
+                boost::asio::buffer_copy(boost::asio::buffer(&copy[0], copy.size()), data);
+            }
+            return boost::asio::buffer(&copy[0], copy.size());
+        }
+
+        // True if media type of Content-Type header matches type,
+        // ignoring case and parameters (ex. charset)
+        bool is(boost::string_view type) const noexcept
+        {
+            auto value = get(http::field::content_type);
+            if (!value)
+                return false;
+            auto mt = value->substr(0, value->find(';'));
+            while (!mt.empty() && (mt.back() == ' ' || mt.back() == '\t'))
+                mt.remove_suffix(1);
+            return boost::beast::iequals(mt, type);
+        }
+
+        // Data received after the request, belongs to the protocol
+        // the connection is switched to
+        boost::asio::const_buffer unread() const noexcept {
+            return self->buffer.data();
+        }
+
         // Get header by name. T is a case-insensitive matching field
         // name or a rest::http::field value.
         template <class T>
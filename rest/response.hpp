@@ -22,10 +22,18 @@
 #define REST_RESPONSE_HPP
 
 #include <rest/request.hpp>
+#include <rest/event_stream.hpp>
+
+#include <boost/asio/dispatch.hpp>
+#include <sstream>
+#include <type_traits>
 
 namespace rest {
 
     struct response {
+        using message_type = response_message;
+        using send_hook = std::function<void(const message_type&)>;
+
     private:
         struct impl {
             impl(const request& r) noexcept
@@ -33,8 +41,9 @@ namespace rest {
             { }
 
             request req;
-            http::response<http::dynamic_body> resp;
+            message_type resp;
             bool is_sent = false;
+            std::vector<send_hook> on_send;
         };
 
         std::shared_ptr<impl> self;
@@ -47,10 +56,20 @@ namespace rest {
         // Set a header field value, removing any other instances of that field.
         // T is a case-insensitive matching field name or a rest::http::field value.
         template <class T>
-        void set(T name, const boost::beast::string_param& value) {
+        void set(T name, boost::string_view value) {
             self->resp.set(name, value);
         }
 
+        // Other values are formatted by operator<<, ex. numbers
+        template <class T, class V>
+        typename std::enable_if<
+            !std::is_convertible<const V&, boost::string_view>::value>::type
+        set(T name, const V& value) {
+            std::ostringstream os;
+            os << value;
+            self->resp.set(name, os.str());
+        }
+
         // Sets the HTTP status for the response
         response& status(unsigned code) {
             self->resp.result(code);
@@ -62,36 +81,147 @@ namespace rest {
             return self->resp.result_int();
         }
 
-        // Send file content
-        void send_file(const fs::path& fname) {
+        // Send file content. Return false, and send nothing, if the
+        // file can not be opened.
+        bool send_file(const fs::path& fname) {
             std::ifstream f(fname.native(), std::ios::binary);
-            if (f.is_open()) {
-                send(f.rdbuf());
-            }
+            if (!f.is_open())
+                return false;
+            send(f.rdbuf());
+            return true;
         }
 
-        // Sends the HTTP response with a body
+        // Sends the HTTP response with a body formatted by operator<<
         template <class T>
-        void send(const T& body) {
+        typename std::enable_if<!boost::asio::is_const_buffer_sequence<T>::value>::type
+        send(const T& body) {
             boost::beast::ostream(self->resp.body()) << body;
             set(http::field::content_length, self->resp.body().size());
             send();
         }
 
+        // Sends the HTTP response with a body of bytes as is
+        template <class ConstBufferSequence>
+        typename std::enable_if<boost::asio::is_const_buffer_sequence<ConstBufferSequence>::value>::type
+        send(const ConstBufferSequence& buffers) {
+            auto& body = self->resp.body();
+            body.commit(boost::asio::buffer_copy(
+                body.prepare(boost::asio::buffer_size(buffers)), buffers));
+            set(http::field::content_length, body.size());
+            send();
+        }
+
+        void send(const boost::string_view& body) {
+            send(boost::asio::const_buffer(body.data(), body.size()));
+        }
+        void send(const std::string& body) {
+            send(boost::asio::const_buffer(body.data(), body.size()));
+        }
+        void send(const char* body) {
+            send(boost::string_view(body));
+        }
+
+        // Sends JSON response written by function f(json_writer&).
+        // Content-Type is set to application/json unless already set.
+        template <class F>
+        void json(F&& f)
+        {
+            {
+                json_writer w(self->resp.body());
+                f(w);
+            }
+            if (self->resp.find(http::field::content_type) == self->resp.end())
+                set(http::field::content_type, "application/json");
+            set(http::field::content_length, self->resp.body().size());
+            send();
+        }
+
+        // Sends the HTTP response with a shared body. The bytes are written
+        // to the connection as is, the same buffer may be sent by any
+        // number of responses at once. Send hooks are not called since
+        // the message has no dynamic body.
+        void send(const shared_buffer& body)
+        {
+            auto& resp = self->resp;
+            resp.keep_alive(false);
+            auto msg = std::make_shared<shared_response_message>(
+                std::move(resp.base()), body);
+            msg->content_length(body.size());
+
+            auto& conn = self->req.connection();
+            boost::asio::dispatch(conn->get_executor(), [msg, conn] {
+                conn->async_write(*msg,
+                    [msg, conn](boost::beast::error_code) {
+                        conn->shutdown();
+                    });
+            });
+
+            self->is_sent = true;
+        }
+        template <class S>
+        void send(std::shared_ptr<S> body) {
+            send(shared_buffer(std::shared_ptr<const std::string>(std::move(body))));
+        }
+
         // Sends the HTTP response. Correspond to end() method in nodejs express.
         void send() {
             self->resp.keep_alive(false);
 
+            for (auto& hook : self->on_send)
+                hook(self->resp);
+
+            // Write on connection executor, response may be sent from
+            // another thread
             auto scopy = self;
-            http::async_write(*self->req.socket(), self->resp,
-                [scopy](boost::beast::error_code err, size_t)
-            {
-                scopy->req.socket()->shutdown(tcp::socket::shutdown_send, err);
+            auto& conn = self->req.connection();
+            boost::asio::dispatch(conn->get_executor(), [scopy, conn] {
+                conn->async_write(scopy->resp,
+                    [scopy, conn](boost::beast::error_code) {
+                        conn->shutdown();
+                    });
             });
 
             self->is_sent = true;
         }
 
+        // Sends already serialized HTTP response, i.e. status line,
+        // headers and body
+        void send_raw(std::shared_ptr<const std::string> data) {
+            auto& conn = self->req.connection();
+            boost::asio::dispatch(conn->get_executor(), [conn, data] {
+                conn->async_write(boost::asio::buffer(*data),
+                    [conn, data](boost::beast::error_code) {
+                        conn->shutdown();
+                    });
+            });
+
+            self->is_sent = true;
+        }
+
+        // Send header of text/event-stream response and keep the connection
+        // open for events. Headers set so far are included. Send hooks are
+        // not called since the body is not known.
+        rest::event_stream event_stream(const event_stream_options& options = { })
+        {
+            auto& resp = self->resp;
+            resp.set(http::field::content_type, "text/event-stream");
+            resp.set(http::field::cache_control, "no-cache");
+            // Body ends when connection is closed
+            resp.keep_alive(false);
+
+            std::ostringstream os;
+            os << resp.base();
+
+            self->is_sent = true;
+            return rest::event_stream::start(
+                self->req.connection(), os.str(), options);
+        }
+
+        // Function called with the message right before it is sent
+        void on_send(send_hook hook) {
+            self->on_send.emplace_back(std::move(hook));
+        }
+
         // Return true if response queing to be sent or is already sent
         bool is_sent() const noexcept {
             return self->is_sent;
@@ -27,6 +27,10 @@
 #include <rest/next.hpp>
 
 #include <boost/variant.hpp>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
 
 namespace rest {
 
@@ -64,105 +68,175 @@ namespace rest {
             : req(req), resp(resp), n(n)
             { }
 
-            void operator()(req_resp& cb) const {
+            void operator()(const req_resp& cb) const {
                 cb(req, resp);
             }
-            void operator()(req_resp_next& cb) const {
+            void operator()(const req_resp_next& cb) const {
                 cb(req, resp, n);
             }
-            void operator()(router& r) const {
-                r.handle_request(req, resp, n);
+            void operator()(const router& r) const {
+                // Continue with parent routes if nothing in router
+                // completed the request
+                r.handle_request(req, resp, n, n.continuation());
             }
         };
 
+        // Number of http::verb values, used to index per-method route tables
+        static constexpr size_t verb_count =
+            static_cast<size_t>(http::verb::unlink) + 1;
+
+        using verb_set = std::bitset<verb_count>;
+
+        // Paths of method routes with the methods routed for them
+        struct allowed_methods {
+            std::string pattern;
+            path uri;
+            verb_set verbs;
+        };
+
         struct impl {
             std::vector<route> routes;
+            // Indexes of routes to visit (in order) for each method
+            std::array<std::vector<size_t>, verb_count> by_method;
+            std::vector<allowed_methods> allowed;
             std::vector<error_handler> errors;
             std::map<std::string, param_handler> params;
         };
 
-        std::shared_ptr<impl> self;
+        // Progress of request through routes of this router
+        struct dispatch;
 
-        void handle_error(request&, response&, next&);
+        // Route table. Published atomically so that it can be replaced
+        // while requests are served. Shared by copies of router, a copy
+        // mounted by use() sees replacements too.
+        struct shared_table {
+            std::shared_ptr<impl> current;
+        };
+
+        std::shared_ptr<shared_table> self;
+
+        // Snapshot of route table, kept by request until it is done
+        std::shared_ptr<impl> table() const noexcept {
+            return std::atomic_load(&self->current);
+        }
+
+        // Route table being set up, routes are added before serving
+        impl& edit() const noexcept {
+            return *self->current;
+        }
+
+        void add_route(route_type, route_handler&&,
+            boost::string_view = "/", http::verb = http::verb::unknown);
+
+        // Bind parameters of route to param handlers of this router
+        void resolve_params(route&) const;
 
     protected:
-        void handle_request(request&, response&, next&);
+        // Pass request through routes. Function done is called if no
+        // route completed the request, i.e. the last matched handler
+        // called next or nothing matched at all.
+        void handle_request(request&, response&, next&, std::function<void()> done) const;
+
+        // Return Allow header value if path of request matches any method
+        // route of this router, otherwise empty string
+        std::string allowed(const request&) const;
+        void allowed(boost::string_view path, verb_set& verbs) const;
 
     public:
-        router() noexcept
-        : self(std::make_shared<impl>())
-        { }
+        router()
+        : self(std::make_shared<shared_table>())
+        {
+            self->current = std::make_shared<impl>();
+        }
 
         virtual ~router() { }
 
         // Error handler called on next(error) or in case of exception
         void use(error_handler&& handler) noexcept {
-            self->errors.emplace_back(std::forward<error_handler>(handler));
+            edit().errors.emplace_back(std::forward<error_handler>(handler));
         }
 
         // Matches all HTTP methods and any path
         void use(route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::use, std::forward<route_handler>(handler));
+            add_route(route_type::use, std::forward<route_handler>(handler));
         }
 
         // Matches all HTTP methods on specified mount (leading) path
         void use(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::use,
-                std::forward<route_handler>(handler),
-                path);
+            add_route(route_type::use,
+                std::forward<route_handler>(handler), path);
         }
 
         // Matches all HTTP methods (verbs). Same as 'use' but matches path exactly.
         void all(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::all,
-                std::forward<route_handler>(handler),
-                path);
+            add_route(route_type::all,
+                std::forward<route_handler>(handler), path);
         }
 
         // Matches HTTP GET
         void get(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::get);
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::get);
         }
 
         // Matches HTTP PUT
         void put(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::put);
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::put);
         }
 
         // Matches HTTP POST
         void post(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::post);
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::post);
         }
 
         // Matches HTTP DELETE
         void del(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::delete_);
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::delete_);
+        }
+
+        // Matches websocket upgrade request (HTTP GET). Handler is called
+        // when connection is established. Other requests to the path are
+        // answered with 426 Upgrade Required.
+        void ws(boost::string_view path, websocket::open_handler handler,
+            websocket_options options = { }) noexcept
+        {
+            get(path, req_resp_next([handler, options](
+                const request& req, response& resp, next&)
+            {
+                if (!boost::beast::websocket::is_upgrade(req.message())) {
+                    resp.set(http::field::upgrade, "websocket");
+                    resp.status(426).send();
+                    return;
+                }
+                auto ws = req.connection()->upgrade();
+                if (!ws) {
+                    resp.status(501).send();
+                    return;
+                }
+                ws->opt = options;
+                ws->accept(req.message(), handler);
+            }));
+        }
+
+        // Replace routes, error and parameter handlers with those of
+        // other router. Requests in progress finish with the old routes,
+        // new requests see the new ones. Safe to call while serving, but
+        // the other router must not be modified after that.
+        void replace(const router& other) noexcept {
+            std::atomic_store(&self->current, other.table());
         }
 
         // Parameteter handler called whenever triggered path contains
         // matched named parameter
         void param(std::string name, param_handler&& handler) noexcept {
-            self->params.emplace(
+            auto& t = edit();
+            t.params.emplace(
                 std::move(name), std::forward<param_handler>(handler));
+            for (auto& r : t.routes)
+                resolve_params(r);
         }
     };
 
@@ -173,6 +247,8 @@ namespace rest {
         http::verb method; // used only for route_type::method
         path uri;
         route_handler handler;
+        // Param handler for each parameter of uri, null if none
+        std::vector<const param_handler*> params;
 
         route(route_type rt, route_handler&& rh,
             boost::string_view u = "/", http::verb mtd = http::verb::unknown) noexcept
@@ -182,11 +258,9 @@ namespace rest {
         , handler(std::forward<route_handler>(rh))
         { }
 
+        // Method is not checked here, routes are already grouped by method
+        // in router
         boost::string_view match(const request& req) const {
-            // Check method if handler type is method
-            if (type == route_type::method && method != req.method())
-                return { };
-
             std::cmatch cm;
             if (!uri.match(req.path(), cm))
                 return { };
@@ -202,56 +276,226 @@ namespace rest {
     };
 
 
-    void router::handle_error(request& req, response& resp, next& next)
+    void router::add_route(route_type rt, route_handler&& rh,
+        boost::string_view uri, http::verb mtd)
     {
-        for (auto& handler : self->errors) {
-            if (!next.safe_invoke([&] { handler(next.err(), req, resp, next); }))
-                break;
+        auto& t = edit();
+        size_t index = t.routes.size();
+        t.routes.emplace_back(rt, std::forward<route_handler>(rh), uri, mtd);
+        resolve_params(t.routes.back());
+
+        if (rt != route_type::method) {
+            for (auto& routes : t.by_method)
+                routes.push_back(index);
+            return;
         }
+        t.by_method[static_cast<size_t>(mtd)].push_back(index);
+
+        // Update methods allowed for the path
+        auto it = std::find_if(t.allowed.begin(), t.allowed.end(),
+            [&](const allowed_methods& am) { return am.pattern == uri; });
+        if (it == t.allowed.end()) {
+            t.allowed.push_back({ uri.to_string(), path(uri), { } });
+            it = std::prev(t.allowed.end());
+        }
+        it->verbs.set(static_cast<size_t>(mtd));
     }
 
 
-    void router::handle_request(request& req, response& resp, next& next)
+    void router::resolve_params(route& r) const
+    {
+        auto& t = edit();
+        r.params.assign(r.uri.param_count(), nullptr);
+        for (size_t i = 0; i < r.params.size(); ++i) {
+            auto it = t.params.find(r.uri.param_name(i));
+            if (it != t.params.end())
+                r.params[i] = &it->second;
+        }
+    }
+
+
+    std::string router::allowed(const request& req) const
+    {
+        verb_set verbs;
+        allowed(req.path(), verbs);
+
+        // Value of Allow header, ex. "GET, POST"
+        std::string allow;
+        for (size_t i = 0; i < verbs.size(); ++i) {
+            if (!verbs[i])
+                continue;
+            auto verb = http::to_string(static_cast<http::verb>(i));
+            if (!allow.empty())
+                allow.append(", ");
+            allow.append(verb.data(), verb.size());
+        }
+        return allow;
+    }
+
+    // Add methods routed for path to verbs, including routes of
+    // mounted routers
+    void router::allowed(boost::string_view p, verb_set& verbs) const
     {
-        for (auto& route : self->routes) {
-            boost::string_view uri_match = route.match(req);
-            if (uri_match.empty())
+        auto t = table();
+        for (auto& am : t->allowed) {
+            std::cmatch cm;
+            if (am.uri.match(p, cm) && size_t(cm.length(0)) == p.size())
+                verbs |= am.verbs;
+        }
+
+        for (auto& r : t->routes) {
+            auto sub = boost::get<router>(&r.handler);
+            if (!sub || r.type == route_type::method)
                 continue;
 
-            // Update request fields
-            req.base_url(uri_match);
-            // Make sure leading '/' is present
-            req.path(req.path().substr(
-                uri_match.size() == 1 ? 0 : uri_match.size()));
-            if (req.path().empty())
-                req.path({ "/", 1 });
-
-            // Add params to request
-            for (auto& p : route.uri.get_params(uri_match)) {
-                if (req.params().emplace(p).second) {
-                    // The insertion took place, use this fact to call param
-                    // callback once per request-response cycle
-                    auto it = self->params.find(p.first);
-                    if (it != self->params.end()) {
-                        if (!next.safe_invoke([&] {
-                            it->second(req, resp, next, p.second); }))
-                            return;
-                        if (next.err()) {
-                            handle_error(req, resp, next);
-                            return;
-                        }
+            std::cmatch cm;
+            if (!r.uri.match(p, cm))
+                continue;
+            size_t msize = cm.length(0);
+            if (r.type != route_type::use && msize != p.size())
+                continue;
+
+            // Path as seen by the mounted router
+            auto sub_path = p.substr(msize == 1 ? 0 : msize);
+            sub->allowed(sub_path.empty() ? "/" : sub_path, verbs);
+        }
+    }
+
+
+    struct router::dispatch
+        : next::frame
+        , std::enable_shared_from_this<dispatch>
+    {
+        std::shared_ptr<impl> self;
+        request req;
+        response resp;
+        next n;
+        std::function<void()> done;
+
+        // Routes to visit and the path they are matched against
+        const std::vector<size_t>& routes;
+        const boost::string_view path;
+        size_t index = 0;
+
+        // Matched route with parameters yet to be handled
+        const route* current = nullptr;
+        std::vector<boost::string_view> values;
+        size_t param = 0;
+
+        size_t error_index = 0;
+
+        dispatch(const std::shared_ptr<impl>& s,
+            request& rq, response& rs, next& nx, std::function<void()>&& d)
+        : self(s), req(rq), resp(rs), n(nx), done(std::move(d))
+        , routes(s->by_method[static_cast<size_t>(rq.method())])
+        , path(rq.path())
+        { }
+
+        template <class F>
+        bool invoke(F&& fn) {
+            return n.safe_invoke(std::forward<F>(fn), shared_from_this());
+        }
+
+        // Handler called next after it returned
+        void resume() override {
+            if (n.err())
+                handle_error();
+            else
+                run();
+        }
+
+        void run()
+        {
+            for (;;) {
+                if (!current && !match())
+                    break;
+
+                // Call param callbacks once per request-response cycle,
+                // even if matched by several routes
+                while (param < values.size()) {
+                    size_t i = param++;
+                    auto& value = values[i];
+                    req.params().emplace(
+                        current->uri.param_name(i).c_str(), value);
+                    auto handler = current->params[i];
+                    if (!handler || !req.param_called(handler))
+                        continue;
+
+                    if (!invoke([&] { (*handler)(req, resp, n, value); }))
+                        return;
+                    if (n.err()) {
+                        handle_error();
+                        return;
                     }
                 }
+
+                auto& route = *current;
+                current = nullptr;
+
+                if (!invoke([&] {
+                    boost::apply_visitor(visitor(req, resp, n), route.handler); }))
+                    return;
+                if (n.err()) {
+                    handle_error();
+                    return;
+                }
             }
 
-            if (!next.safe_invoke([&] {
-                boost::apply_visitor(visitor(req, resp, next), route.handler); }))
-                return;
-            if (next.err()) {
-                handle_error(req, resp, next);
-                return;
+            req.path(path);
+            done();
+        }
+
+        // Find next matching route. Return false if no more routes.
+        bool match()
+        {
+            while (index < routes.size()) {
+                auto& route = self->routes[routes[index++]];
+
+                // Every route sees the path as it was passed to this router
+                req.path(path);
+
+                boost::string_view uri_match = route.match(req);
+                if (uri_match.empty())
+                    continue;
+
+                // Update request fields
+                req.base_url(uri_match);
+                // Make sure leading '/' is present
+                req.path(req.path().substr(
+                    uri_match.size() == 1 ? 0 : uri_match.size()));
+                if (req.path().empty())
+                    req.path({ "/", 1 });
+
+                current = &route;
+                route.uri.get_values(uri_match, values);
+                param = 0;
+                // Names of params belong to route table, which may be
+                // replaced while request is still in use
+                if (!values.empty())
+                    req.pin(self);
+                return true;
+            }
+            return false;
+        }
+
+        // Error handlers called in order while they call next. Parent
+        // router error handlers called if all handlers called next.
+        void handle_error()
+        {
+            while (error_index < self->errors.size()) {
+                auto& handler = self->errors[error_index++];
+                if (!invoke([&] { handler(n.err(), req, resp, n); }))
+                    return;
             }
+            done();
         }
+    };
+
+
+    void router::handle_request(
+        request& req, response& resp, next& n, std::function<void()> done) const
+    {
+        std::make_shared<dispatch>(table(), req, resp, n, std::move(done))->run();
     }
 
 } // namespace rest
@@ -23,51 +23,304 @@
 
 #include <rest/router.hpp>
 #include <rest/error.hpp>
+#include <rest/http2.hpp>
+
+#include <boost/asio/steady_timer.hpp>
+#include <list>
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#include <boost/asio/read.hpp>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char** environ;
+#endif
 
 namespace rest {
 
+    struct server_options {
+        // Maximum number of connections accepted at once when the
+        // listening socket becomes ready
+        size_t accept_batch = 16;
+
+        // Disable Nagle's algorithm on accepted TCP connections
+        bool no_delay = true;
+
+        // Seconds to wait for the first data of client before the
+        // connection is accepted (Linux TCP_DEFER_ACCEPT). Idle connects
+        // do not take a session. 0 disables.
+        int defer_accept = 0;
+
+        // Length of queue of pending TCP Fast Open requests, allowing
+        // data in SYN of returning clients. 0 disables.
+        int fast_open = 0;
+
+        // Size of socket buffers of TCP connections, 0 is system default
+        int receive_buffer_size = 0;
+        int send_buffer_size = 0;
+    };
+
+
     struct server : router {
     private:
-        tcp::acceptor acceptor;
-        tcp::socket socket;
-
-        // Loop forever accepting new connections
-        void accept() {
-            acceptor.async_accept(socket,
-                [this](boost::beast::error_code ec) {
-                    if (!ec)
-                        process_client();
-                    accept();
+        boost::asio::io_context& ioc;
+        boost::asio::io_context& session_ioc;
+        const server_options opt;
+        std::list<tcp::acceptor> acceptors;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        std::list<local::stream_protocol::acceptor> local_acceptors;
+
+        // Environment variable telling descriptor of handover socket
+        static const char* handover_env() noexcept {
+            return "REST_HANDOVER_FD";
+        }
+#endif
+        // Not null if HTTP/2 is enabled
+        std::shared_ptr<const http2_options> h2;
+
+        // Loop accepting new connections until acceptor is closed
+        template <class Acceptor>
+        void accept(Acceptor& acceptor) {
+            // Batch is taken with non-blocking accept
+            if (accept_batch() > 1)
+                acceptor.non_blocking(true);
+            acceptor.async_accept(session_ioc,
+                [this, &acceptor](boost::beast::error_code ec,
+                    typename Acceptor::protocol_type::socket sock)
+                {
+                    if (ec == boost::asio::error::operation_aborted)
+                        return;
+                    if (!ec) {
+                        accepted(sock);
+                        start(std::move(sock));
+                        // Take other pending connections without waiting
+                        // for readiness again
+                        for (size_t i = 1; i < accept_batch(); ++i) {
+                            typename Acceptor::protocol_type::socket
+                                next(session_ioc);
+                            if (acceptor.accept(next, ec))
+                                break;
+                            accepted(next);
+                            start(std::move(next));
+                        }
+                    }
+                    accept(acceptor);
                 });
         }
 
+        // With io_uring every accept is a submitted operation, there
+        // is no readiness to save
+        size_t accept_batch() const noexcept {
+#if defined(REST_IO_URING)
+            return 1;
+#else
+            return opt.accept_batch;
+#endif
+        }
+
+        // Set options of listening socket before listen, accepted
+        // sockets inherit buffer sizes
+        void configure(tcp::acceptor& acceptor)
+        {
+            if (opt.receive_buffer_size > 0) {
+                acceptor.set_option(tcp::socket::receive_buffer_size(
+                    opt.receive_buffer_size));
+            }
+            if (opt.send_buffer_size > 0) {
+                acceptor.set_option(tcp::socket::send_buffer_size(
+                    opt.send_buffer_size));
+            }
+#if defined(TCP_DEFER_ACCEPT)
+            if (opt.defer_accept > 0) {
+                acceptor.set_option(boost::asio::detail::socket_option::integer<
+                    IPPROTO_TCP, TCP_DEFER_ACCEPT>(opt.defer_accept));
+            }
+#endif
+#if defined(TCP_FASTOPEN)
+            if (opt.fast_open > 0) {
+                acceptor.set_option(boost::asio::detail::socket_option::integer<
+                    IPPROTO_TCP, TCP_FASTOPEN>(opt.fast_open));
+            }
+#endif
+        }
+
+        void accepted(tcp::socket& sock) {
+            boost::system::error_code ec;
+            if (opt.no_delay)
+                sock.set_option(tcp::no_delay(true), ec);
+        }
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        void accepted(local::stream_protocol::socket&) { }
+#endif
+
+    protected:
+        // Start session on accepted connection
+        virtual void start(tcp::socket&& sock) {
+            auto conn = std::make_shared<tcp_session>(std::move(sock));
+            if (h2)
+                detect_protocol(conn);
+            else
+                process_client(conn);
+        }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        virtual void start(local::stream_protocol::socket&& sock) {
+            auto conn = std::make_shared<unix_session>(std::move(sock));
+            if (h2)
+                detect_protocol(conn);
+            else
+                process_client(conn);
+        }
+#endif
+
         // Receive and process a request
-        void process_client()
+        void process_client(const session_ptr& conn)
         {
-            auto sock = std::make_shared<tcp::socket>(std::move(socket));
-            request::receive(sock, [this](request& req) {
+            request::receive(conn, [this](request& req) {
+                if (h2 && upgrade_http2(req))
+                    return;
+
                 req.app(this);
                 req.path(req.original_url());
+                req.watch();
 
                 response resp(req);
                 next n;
 
-                handle_request(req, resp, n);
+                handle_request(req, resp, n, [this, req, resp, n]() mutable {
+                    finish(req, resp, n);
+                });
             });
         }
 
+    private:
+        // Tell HTTP/2 preface from HTTP/1 request by peeking at the first
+        // bytes of connection, no HTTP/1 method starts with "PRI"
+        template <class Session>
+        void detect_protocol(const std::shared_ptr<Session>& conn)
+        {
+            conn->stream.async_wait(Session::stream_type::wait_read,
+                [this, conn](boost::beast::error_code ec) {
+                    if (ec)
+                        return;
+                    char buf[3];
+                    size_t n = conn->stream.receive(boost::asio::buffer(buf),
+                        Session::stream_type::message_peek, ec);
+                    if (ec || n == 0)
+                        return;
+
+                    auto preface = http2_connection::preface();
+                    if (std::memcmp(buf, preface.data(), n) != 0)
+                        process_client(conn);
+                    else if (n == sizeof(buf))
+                        std::make_shared<http2_connection>(
+                            conn, *h2, stream_dispatcher())->start();
+                    else {
+                        // Wait for more data
+                        auto t = std::make_shared<boost::asio::steady_timer>(
+                            conn->get_executor(), std::chrono::milliseconds(1));
+                        t->async_wait([this, conn, t](boost::beast::error_code) {
+                            detect_protocol(conn);
+                        });
+                    }
+                });
+        }
+
+        // Switch to HTTP/2 if requested by "Upgrade: h2c". Not available
+        // over TLS.
+        bool upgrade_http2(const request& req)
+        {
+            auto& conn = req.connection();
+            bool plain = std::dynamic_pointer_cast<tcp_session>(conn) != nullptr;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+            plain = plain || std::dynamic_pointer_cast<unix_session>(conn);
+#endif
+            auto upgrade = req.get(http::field::upgrade);
+            auto settings = req.get("HTTP2-Settings");
+            if (!plain || !upgrade || !settings ||
+                !http::token_list(*upgrade).exists("h2c"))
+                return false;
+
+            std::make_shared<http2_connection>(conn, *h2, stream_dispatcher())
+                ->start(req.message(), req.unread(), *settings);
+            return true;
+        }
+
+        // Requests of HTTP/2 streams are processed as any other
+        http2_connection::dispatcher stream_dispatcher() {
+            return [this](const session_ptr& stream) {
+                process_client(stream);
+            };
+        }
+
+        // Respond to request that fell through all routes without
+        // being completed
+        void finish(const request& req, response& resp, const next& n)
+        {
+            if (resp.is_sent())
+                return;
+
+            if (n.err()) {
+                auto status = n.err().status();
+                resp.status(status != http::status::unknown ?
+                    static_cast<unsigned>(status) : 500).send();
+                return;
+            }
+
+            // Path exists but not for this method
+            auto allow = allowed(req);
+            if (!allow.empty()) {
+                resp.set(http::field::allow, allow);
+                resp.status(405).send();
+                return;
+            }
+            resp.status(404).send();
+        }
+
     public:
-        server(boost::asio::io_context& ioc) noexcept
-        : acceptor(ioc)
-        , socket(ioc)
+        server(boost::asio::io_context& ioc,
+            server_options options = { }) noexcept
+        : ioc(ioc)
+        , session_ioc(ioc)
+        , opt(std::move(options))
         { }
 
+        // Accept on ioc, run sessions (connections) on session_ioc
+        server(boost::asio::io_context& ioc,
+            boost::asio::io_context& session_ioc,
+            server_options options = { }) noexcept
+        : ioc(ioc)
+        , session_ioc(session_ioc)
+        , opt(std::move(options))
+        { }
+
+        // Accept HTTP/2 without TLS (h2c) besides HTTP/1.1. Connection
+        // is HTTP/2 if it starts with the preface (prior knowledge) or
+        // is upgraded by "Upgrade: h2c" request.
+        void http2(const http2_options& options = { }) {
+            h2 = std::make_shared<const http2_options>(options);
+        }
+
+        // Listen may be called several times to accept on more than
+        // one endpoint
         void listen(tcp::endpoint endp) {
+            acceptors.emplace_back(ioc);
+            auto& acceptor = acceptors.back();
             acceptor.open(endp.protocol());
             acceptor.set_option(tcp::acceptor::reuse_address(true));
+            configure(acceptor);
             acceptor.bind(endp);
             acceptor.listen();
-            accept();
+            accept(acceptor);
         }
 
         void listen(uint16_t port) {
@@ -77,6 +330,265 @@ namespace rest {
         void listen(uint16_t port, const char* ip) {
             listen(tcp::endpoint(boost::asio::ip::make_address(ip), port));
         }
+
+        // Stop accepting new connections. Connections in progress are
+        // served until done.
+        void close()
+        {
+            boost::asio::dispatch(ioc, [this] {
+                boost::system::error_code ec;
+                for (auto& a : acceptors)
+                    a.close(ec);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+                for (auto& a : local_acceptors)
+                    a.close(ec);
+#endif
+            });
+        }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        // Listen on Unix domain socket. Socket file left by previous
+        // run is removed.
+        void listen(const local::stream_protocol::endpoint& endp) {
+            boost::system::error_code ec;
+            if (fs::status(endp.path(), ec).type() == fs::socket_file)
+                fs::remove(endp.path(), ec);
+
+            local_acceptors.emplace_back(ioc, endp);
+            accept(local_acceptors.back());
+        }
+
+        // Listen on an already bound socket, e.g. inherited from parent
+        // process. TCP and Unix domain sockets are supported.
+        // Options of the listening socket are left as set by its owner.
+        void listen_fd(int fd)
+        {
+            sockaddr_storage addr;
+            socklen_t size = sizeof(addr);
+            if (::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &size) != 0) {
+                throw boost::system::system_error(
+                    errno, boost::system::system_category(), "getsockname");
+            }
+
+            int listening = 0;
+            size = sizeof(listening);
+            ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &size);
+
+            if (addr.ss_family == AF_UNIX) {
+                local_acceptors.emplace_back(ioc, local::stream_protocol(), fd);
+                if (!listening)
+                    local_acceptors.back().listen();
+                accept(local_acceptors.back());
+                return;
+            }
+
+            acceptors.emplace_back(ioc,
+                addr.ss_family == AF_INET6 ? tcp::v6() : tcp::v4(), fd);
+            if (!listening)
+                acceptors.back().listen();
+            accept(acceptors.back());
+        }
+
+        // Listen on sockets passed by service manager (systemd socket
+        // activation, LISTEN_FDS). Return number of sockets.
+        size_t listen_activated()
+        {
+            const char* pid = std::getenv("LISTEN_PID");
+            const char* fds = std::getenv("LISTEN_FDS");
+            if (!pid || !fds || std::atol(pid) != long(::getpid()))
+                return 0;
+
+            // Passed sockets start after stdin, stdout and stderr
+            int n = std::atoi(fds);
+            for (int fd = 3; fd < 3 + n; ++fd)
+                listen_fd(fd);
+            return n > 0 ? size_t(n) : 0;
+        }
+
+        using restart_handler = std::function<void(boost::system::error_code)>;
+
+        // Start program (usually a new version of this one) and hand
+        // listening sockets over to it. The new process takes them with
+        // listen_handover(). When it is ready this server stops accepting
+        // and finishes connections in progress. Sockets stay open during
+        // the handover, no connection is refused. Handler is called when
+        // the new process took over or failed to.
+        void hot_restart(const std::string& program,
+            const std::vector<std::string>& args, restart_handler handler = { })
+        {
+            int sv[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+                throw boost::system::system_error(
+                    errno, boost::system::system_category(), "socketpair");
+            }
+
+            std::vector<char*> argv;
+            argv.push_back(const_cast<char*>(program.c_str()));
+            for (auto& a : args)
+                argv.push_back(const_cast<char*>(a.c_str()));
+            argv.push_back(nullptr);
+
+            // Environment of this process with handover socket, which is
+            // descriptor 3 of child. Built before fork, environment of
+            // this process is not modified.
+            std::string handover = std::string(handover_env()) + "=3";
+            std::vector<char*> envp;
+            for (char** e = environ; *e; ++e) {
+                if (std::strncmp(*e, handover.c_str(), handover.size() - 1) != 0)
+                    envp.push_back(*e);
+            }
+            envp.push_back(const_cast<char*>(handover.c_str()));
+            envp.push_back(nullptr);
+
+            rlimit lim;
+            int max_fd = ::getrlimit(RLIMIT_NOFILE, &lim) == 0 &&
+                lim.rlim_cur != RLIM_INFINITY ? int(lim.rlim_cur) : 65536;
+
+            pid_t pid = ::fork();
+            if (pid == 0) {
+                // Child keeps only standard streams and handover socket,
+                // other descriptors are not inherited
+                if (sv[1] == 3)
+                    ::fcntl(3, F_SETFD, 0);
+                else
+                    ::dup2(sv[1], 3);
+#if defined(SYS_close_range)
+                if (::syscall(SYS_close_range, 4u, ~0u, 0u) != 0)
+#endif
+                for (int fd = 4; fd < max_fd; ++fd)
+                    ::close(fd);
+                ::execve(program.c_str(), argv.data(), envp.data());
+                ::_exit(127);
+            }
+            ::close(sv[1]);
+            if (pid < 0) {
+                ::close(sv[0]);
+                throw boost::system::system_error(
+                    errno, boost::system::system_category(), "fork");
+            }
+
+            // Send descriptors of listening sockets
+            std::vector<int> fds;
+            for (auto& a : acceptors)
+                if (a.is_open())
+                    fds.push_back(a.native_handle());
+            for (auto& a : local_acceptors)
+                if (a.is_open())
+                    fds.push_back(a.native_handle());
+
+            char data = 'h';
+            iovec iov { &data, 1 };
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+            msghdr msg { };
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            if (!fds.empty()) {
+                msg.msg_control = control.data();
+                msg.msg_controllen = control.size();
+                cmsghdr* c = CMSG_FIRSTHDR(&msg);
+                c->cmsg_level = SOL_SOCKET;
+                c->cmsg_type = SCM_RIGHTS;
+                c->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+                std::memcpy(CMSG_DATA(c), fds.data(), sizeof(int) * fds.size());
+            }
+            ssize_t sent;
+            do
+                sent = ::sendmsg(sv[0], &msg, MSG_NOSIGNAL);
+            while (sent < 0 && errno == EINTR);
+            if (sent != 1) {
+                // New process did not get the sockets, do not leave it
+                // waiting for them
+                int err = errno;
+                ::close(sv[0]);
+                ::kill(pid, SIGKILL);
+                ::waitpid(pid, nullptr, 0);
+                throw boost::system::system_error(
+                    err, boost::system::system_category(), "sendmsg");
+            }
+
+            // Wait for the new process to accept
+            auto sock = std::make_shared<local::stream_protocol::socket>(
+                ioc, local::stream_protocol(), sv[0]);
+            auto ack = std::make_shared<char>();
+            boost::asio::async_read(*sock, boost::asio::buffer(ack.get(), 1),
+                [this, sock, ack, pid, handler](boost::system::error_code ec, size_t) {
+                    if (!ec) {
+                        close();
+                        // Reap the new process if it exits while this one
+                        // still runs, without keeping io_context busy
+                        std::thread([pid] { ::waitpid(pid, nullptr, 0); }).detach();
+                    }
+                    else if (ec != boost::asio::error::operation_aborted) {
+                        // New process failed to take over, make sure it
+                        // does not serve the sockets too, and reap it
+                        ::kill(pid, SIGKILL);
+                        ::waitpid(pid, nullptr, 0);
+                    }
+                    if (handler)
+                        handler(ec);
+                });
+        }
+
+        // Listen on sockets handed over by hot_restart of previous
+        // process. Return number of sockets, 0 if process was not
+        // started by hot_restart.
+        size_t listen_handover()
+        {
+            const char* env = std::getenv(handover_env());
+            if (!env)
+                return 0;
+            int sock = std::atoi(env);
+            ::unsetenv(handover_env());
+
+            char data;
+            iovec iov { &data, 1 };
+            // Room for as many descriptors as Linux passes in a message
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * 253));
+            msghdr msg { };
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control.data();
+            msg.msg_controllen = control.size();
+
+            ssize_t received = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+            if (received != 1) {
+                int err = received < 0 ? errno : ECONNRESET;
+                ::close(sock);
+                throw boost::system::system_error(
+                    err, boost::system::system_category(), "recvmsg");
+            }
+
+            std::vector<int> fds;
+            for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+                if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+                    continue;
+                size_t n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < n; ++i) {
+                    int fd;
+                    std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                    fds.push_back(fd);
+                }
+            }
+
+            // Some descriptors were dropped, do not serve only part of
+            // the sockets. Previous process keeps serving them.
+            if (msg.msg_flags & MSG_CTRUNC) {
+                for (int fd : fds)
+                    ::close(fd);
+                ::close(sock);
+                throw boost::system::system_error(
+                    EMSGSIZE, boost::system::system_category(), "recvmsg");
+            }
+
+            for (int fd : fds)
+                listen_fd(fd);
+
+            // Previous process stops accepting
+            ::send(sock, &data, 1, MSG_NOSIGNAL);
+            ::close(sock);
+            return fds.size();
+        }
+#endif
     };
 
 } // namespace rest
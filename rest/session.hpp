@@ -0,0 +1,202 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_SESSION_HPP
+#define REST_SESSION_HPP
+
+#include <rest/shared_buffer.hpp>
+#include <rest/websocket.hpp>
+
+#include <boost/asio/steady_timer.hpp>
+#if defined(__linux__)
+#include <poll.h>
+#endif
+
+namespace rest {
+
+    // Connection requests are received on. Hides the type of stream
+    // (plain or TLS socket) from request and response.
+    struct session : std::enable_shared_from_this<session> {
+        using executor_type = tcp::socket::executor_type;
+        using handler = std::function<void(boost::beast::error_code)>;
+        using read_handler = std::function<void(boost::beast::error_code, size_t)>;
+
+        virtual ~session() { }
+
+        virtual executor_type get_executor() = 0;
+
+        // The underlying TCP socket, null if connection is not over TCP
+        virtual tcp::socket* socket() {
+            return nullptr;
+        }
+
+        virtual void async_read(
+            boost::beast::flat_buffer&, request_message&, handler) = 0;
+        virtual void async_read_some(boost::asio::mutable_buffer, read_handler) = 0;
+        virtual void async_write(response_message&, handler) = 0;
+        virtual void async_write(shared_response_message&, handler) = 0;
+        virtual void async_write(boost::asio::const_buffer, handler) = 0;
+
+        // Close connection gracefully when done writing
+        virtual void shutdown() = 0;
+
+        // Call function once if client closes the connection. Used while
+        // a request is processed and nothing is read from connection.
+        virtual void on_disconnect(std::function<void()>) { }
+
+        // Take over the connection for websocket protocol. Return null
+        // if not supported by transport.
+        virtual std::shared_ptr<websocket::session_base> upgrade() {
+            return { };
+        }
+    };
+
+    using session_ptr = std::shared_ptr<session>;
+
+
+    // Common part of sessions over a stream
+    template <class Stream>
+    struct stream_session : session {
+        using stream_type = Stream;
+
+        Stream stream;
+
+        template <class... Args>
+        stream_session(Args&&... args)
+        : stream(std::forward<Args>(args)...)
+        { }
+
+        executor_type get_executor() override {
+            return stream.get_executor();
+        }
+
+        void async_read(boost::beast::flat_buffer& buffer,
+            request_message& msg, handler h) override
+        {
+            http::async_read(stream, buffer, msg,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        void async_read_some(boost::asio::mutable_buffer buf, read_handler h) override {
+            stream.async_read_some(buf, h);
+        }
+
+        void async_write(response_message& msg, handler h) override {
+            http::async_write(stream, msg,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        void async_write(shared_response_message& msg, handler h) override {
+            http::async_write(stream, msg,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        void async_write(boost::asio::const_buffer buf, handler h) override {
+            boost::asio::async_write(stream, buf,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        std::shared_ptr<websocket::session_base> upgrade() override {
+            return std::make_shared<websocket::basic_session<Stream&>>(
+                shared_from_this(), stream);
+        }
+
+        void on_disconnect(std::function<void()> h) override
+        {
+            // Do not keep connection alive while waiting
+            std::weak_ptr<session> w = shared_from_this();
+            stream.lowest_layer().async_wait(boost::asio::socket_base::wait_read,
+                [w, h](boost::beast::error_code ec) {
+                    auto s = std::static_pointer_cast<stream_session>(w.lock());
+                    if (s && ec != boost::asio::error::operation_aborted)
+                        s->check_closed(h, ec, 0);
+                });
+        }
+
+    private:
+        // Called when socket is readable. Nothing to read means end of
+        // stream. Data may come right before it (ex. TLS close_notify),
+        // then the close is looked for a few more times. A close after
+        // pending data is only seen on Linux.
+        void check_closed(const std::function<void()>& h,
+            boost::beast::error_code ec, int attempt)
+        {
+            auto& sock = stream.lowest_layer();
+            if (ec || sock.available(ec) == 0 || ec) {
+                h();
+                return;
+            }
+#if defined(POLLRDHUP)
+            pollfd p = { sock.native_handle(), POLLRDHUP, 0 };
+            if (::poll(&p, 1, 0) == 1 &&
+                (p.revents & (POLLRDHUP | POLLHUP | POLLERR)))
+            {
+                h();
+                return;
+            }
+            if (attempt == 5)
+                return;
+
+            std::weak_ptr<session> w = shared_from_this();
+            auto t = std::make_shared<boost::asio::steady_timer>(
+                sock.get_executor(), std::chrono::milliseconds(10 << attempt));
+            t->async_wait([w, h, t, attempt](boost::beast::error_code) {
+                if (auto s = std::static_pointer_cast<stream_session>(w.lock()))
+                    s->check_closed(h, { }, attempt + 1);
+            });
+#else
+            (void)attempt;
+#endif
+        }
+    };
+
+
+    // Session over a plain TCP socket
+    struct tcp_session : stream_session<tcp::socket> {
+        tcp_session(tcp::socket&& s)
+        : stream_session(std::move(s))
+        { }
+
+        tcp::socket* socket() override {
+            return &stream;
+        }
+
+        void shutdown() override {
+            boost::system::error_code ec;
+            stream.shutdown(tcp::socket::shutdown_send, ec);
+        }
+    };
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    // Session over a Unix domain socket
+    struct unix_session : stream_session<local::stream_protocol::socket> {
+        unix_session(local::stream_protocol::socket&& s)
+        : stream_session(std::move(s))
+        { }
+
+        void shutdown() override {
+            boost::system::error_code ec;
+            stream.shutdown(local::stream_protocol::socket::shutdown_send, ec);
+        }
+    };
+#endif
+
+} // namespace rest
+
+#endif // REST_SESSION_HPP
@@ -0,0 +1,127 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef REST_SHARED_BUFFER_HPP
+#define REST_SHARED_BUFFER_HPP
+
+#include <rest/forward.hpp>
+
+#include <memory>
+
+namespace rest {
+
+    // Immutable bytes shared by any number of responses, ex. a generated
+    // snapshot sent to many clients. Copies refer to the same bytes.
+    struct shared_buffer {
+    private:
+        // Keeps the bytes alive
+        std::shared_ptr<const void> owner;
+        boost::asio::const_buffer bytes;
+
+    public:
+        shared_buffer() noexcept = default;
+
+        shared_buffer(std::string data)
+        {
+            auto s = std::make_shared<const std::string>(std::move(data));
+            bytes = boost::asio::buffer(*s);
+            owner = std::move(s);
+        }
+
+        shared_buffer(std::shared_ptr<const std::string> data) noexcept
+        : owner(data)
+        , bytes(data ? boost::asio::buffer(*data) : boost::asio::const_buffer())
+        { }
+
+        // Bytes kept alive by owner, ex. part of a memory-mapped file
+        shared_buffer(std::shared_ptr<const void> o, boost::asio::const_buffer data) noexcept
+        : owner(std::move(o))
+        , bytes(data)
+        { }
+
+        boost::asio::const_buffer data() const noexcept {
+            return bytes;
+        }
+
+        size_t size() const noexcept {
+            return bytes.size();
+        }
+    };
+
+
+    // Shared buffer replaced atomically. A producer may store a new
+    // snapshot while responses are sending the previous one.
+    struct atomic_shared_buffer {
+    private:
+        std::shared_ptr<const shared_buffer> self;
+
+    public:
+        atomic_shared_buffer(shared_buffer b = { })
+        : self(std::make_shared<const shared_buffer>(std::move(b)))
+        { }
+
+        shared_buffer load() const {
+            return *std::atomic_load(&self);
+        }
+
+        void store(shared_buffer b) {
+            std::atomic_store(&self,
+                std::shared_ptr<const shared_buffer>(
+                    std::make_shared<const shared_buffer>(std::move(b))));
+        }
+    };
+
+
+    // Body of HTTP message written from a shared buffer as is
+    struct shared_buffer_body {
+        using value_type = shared_buffer;
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            return body.size();
+        }
+
+        struct writer {
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, class Fields>
+            writer(const http::header<isRequest, Fields>&, const value_type& b) noexcept
+            : body(b)
+            { }
+
+            void init(boost::beast::error_code& ec) noexcept {
+                ec = { };
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>>
+            get(boost::beast::error_code& ec) noexcept {
+                ec = { };
+                return {{ body.data(), false }};
+            }
+
+        private:
+            const value_type& body;
+        };
+    };
+
+    using shared_response_message = http::response<shared_buffer_body>;
+
+} // namespace rest
+
+#endif // REST_SHARED_BUFFER_HPP
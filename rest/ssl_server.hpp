@@ -0,0 +1,212 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_SSL_SERVER_HPP
+#define REST_SSL_SERVER_HPP
+
+#include <rest/server.hpp>
+
+#include <boost/asio/ssl.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <deque>
+#include <mutex>
+
+namespace rest {
+
+    namespace ssl = boost::asio::ssl;
+
+    struct ssl_server_options : server_options {
+        // Maximum number of TLS handshakes in progress at the same time,
+        // new connections wait for a free slot. 0 means no limit.
+        size_t max_handshakes = 0;
+
+        // Maximum number of connections waiting for a handshake slot,
+        // connections beyond it are closed
+        size_t max_waiting = 1024;
+
+        // Connection is closed if handshake did not complete in time,
+        // counted from accept
+        std::chrono::steady_clock::duration handshake_timeout =
+            std::chrono::seconds(10);
+
+        // Number of sessions stored in server side cache for resumption
+        // by session id. 0 disables the cache.
+        long session_cache_size = 20480;
+
+        // Allow resumption by session tickets (stateless for server)
+        bool session_tickets = true;
+    };
+
+
+    // Session over TLS stream
+    struct ssl_session : stream_session<ssl::stream<tcp::socket>> {
+        boost::asio::steady_timer timer;
+
+        ssl_session(tcp::socket&& s, ssl::context& ctx)
+        : stream_session(std::move(s), ctx)
+        , timer(stream.get_executor())
+        { }
+
+        tcp::socket* socket() override {
+            return &stream.next_layer();
+        }
+
+        void shutdown() override
+        {
+            auto self = shared_from_this();
+            // Do not wait forever for peer close_notify
+            timer.expires_after(std::chrono::seconds(5));
+            timer.async_wait([self, this](boost::system::error_code ec) {
+                if (!ec)
+                    stream.next_layer().close(ec);
+            });
+            stream.async_shutdown([self, this](boost::system::error_code ec) {
+                timer.cancel();
+                stream.next_layer().close(ec);
+            });
+        }
+    };
+
+
+    struct ssl_server : server {
+    private:
+        ssl::context& ctx;
+        const ssl_server_options opt;
+
+        // Connections waiting for handshake slot
+        std::mutex mtx;
+        size_t handshakes = 0;
+        std::deque<std::pair<tcp::socket,
+            std::chrono::steady_clock::time_point>> waiting;
+
+        void configure()
+        {
+            SSL_CTX* h = ctx.native_handle();
+
+            if (opt.session_cache_size > 0) {
+                static const unsigned char id[] = "rest";
+                SSL_CTX_set_session_cache_mode(h, SSL_SESS_CACHE_SERVER);
+                SSL_CTX_sess_set_cache_size(h, opt.session_cache_size);
+                SSL_CTX_set_session_id_context(h, id, sizeof(id) - 1);
+            }
+            else
+                SSL_CTX_set_session_cache_mode(h, SSL_SESS_CACHE_OFF);
+
+            if (!opt.session_tickets)
+                SSL_CTX_set_options(h, SSL_OP_NO_TICKET);
+        }
+
+        void handshake(tcp::socket&& sock,
+            std::chrono::steady_clock::time_point deadline)
+        {
+            auto conn = std::make_shared<ssl_session>(std::move(sock), ctx);
+
+            conn->timer.expires_at(deadline);
+            conn->timer.async_wait([conn](boost::system::error_code ec) {
+                if (!ec)
+                    conn->stream.next_layer().close(ec);
+            });
+
+            conn->stream.async_handshake(ssl::stream_base::server,
+                [this, conn](boost::system::error_code ec) {
+                    conn->timer.cancel();
+                    handshake_done();
+                    if (!ec)
+                        process_client(conn);
+                });
+        }
+
+        // Release handshake slot and start a waiting one
+        void handshake_done()
+        {
+            if (!opt.max_handshakes)
+                return;
+
+            std::unique_lock<std::mutex> lock(mtx);
+            for (;;) {
+                if (waiting.empty()) {
+                    --handshakes;
+                    return;
+                }
+                auto next = std::move(waiting.front());
+                waiting.pop_front();
+
+                // Timed out while waiting for the slot
+                if (next.second <= std::chrono::steady_clock::now())
+                    continue;
+
+                lock.unlock();
+                handshake(std::move(next.first), next.second);
+                return;
+            }
+        }
+
+    protected:
+        void start(tcp::socket&& sock) override
+        {
+            auto deadline =
+                std::chrono::steady_clock::now() + opt.handshake_timeout;
+
+            if (opt.max_handshakes) {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (handshakes == opt.max_handshakes) {
+                    // Socket is closed when it goes out of scope
+                    if (waiting.size() < opt.max_waiting)
+                        waiting.emplace_back(std::move(sock), deadline);
+                    return;
+                }
+                ++handshakes;
+            }
+            handshake(std::move(sock), deadline);
+        }
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        // TLS over Unix domain socket is not supported, connection
+        // is dropped rather than served in plain text
+        void start(local::stream_protocol::socket&&) override { }
+#endif
+
+    public:
+        // The context must be set up with certificate and private key
+        ssl_server(boost::asio::io_context& ioc, ssl::context& ctx,
+            ssl_server_options options = { })
+        : server(ioc, options)
+        , ctx(ctx)
+        , opt(std::move(options))
+        {
+            configure();
+        }
+
+        // Accept on ioc, run TLS sessions, including handshakes, on
+        // session_ioc (ex. run by other threads)
+        ssl_server(boost::asio::io_context& ioc,
+            boost::asio::io_context& session_ioc, ssl::context& ctx,
+            ssl_server_options options = { })
+        : server(ioc, session_ioc, options)
+        , ctx(ctx)
+        , opt(std::move(options))
+        {
+            configure();
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_SSL_SERVER_HPP
@@ -0,0 +1,250 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_STATIC_BUNDLE_HPP
+#define REST_STATIC_BUNDLE_HPP
+
+#include <rest/mime_type.hpp>
+
+#include <boost/functional/hash.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstdio>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace rest {
+
+    struct static_bundle_options {
+        // Sends the specified directory index file. Set to empty to
+        // disable directory indexing.
+        boost::string_view index { "index.html" };
+
+        // Value of Cache-Control header, not set if empty
+        std::string cache_control;
+    };
+
+
+    // Serves files from a bundle made by make_bundle.py. The bundle is
+    // memory-mapped once, requests are served without touching the
+    // filesystem.
+    struct static_bundle {
+    private:
+        struct file {
+            boost::string_view data;
+            // Precompressed content, empty if none
+            boost::string_view gzip;
+            boost::string_view type;
+            std::string etag;
+            // Tag of precompressed content, differs from the one of
+            // identity content
+            std::string gzip_etag;
+        };
+
+        struct string_view_hash {
+            size_t operator()(const boost::string_view& s) const noexcept {
+                return boost::hash_range(s.begin(), s.end());
+            }
+        };
+
+        struct impl {
+            boost::interprocess::file_mapping mapping;
+            boost::interprocess::mapped_region region;
+            std::vector<file> files;
+            std::unordered_map<boost::string_view, const file*, string_view_hash> paths;
+            // Index file paths of directories
+            std::vector<std::string> dirs;
+        };
+
+        std::shared_ptr<impl> self;
+        const static_bundle_options opt;
+
+        static uint64_t read(const char* p, size_t n) noexcept {
+            uint64_t v = 0;
+            for (size_t i = n; i-- > 0; )
+                v = v << 8 | static_cast<unsigned char>(p[i]);
+            return v;
+        }
+
+        void load(const fs::path& bundle)
+        {
+            namespace ipc = boost::interprocess;
+            self->mapping = ipc::file_mapping(bundle.c_str(), ipc::read_only);
+            self->region = ipc::mapped_region(self->mapping, ipc::read_only);
+
+            const char* base = static_cast<const char*>(self->region.get_address());
+            const uint64_t size = self->region.get_size();
+            auto bad = [&] {
+                return std::runtime_error("invalid bundle " + bundle.string());
+            };
+
+            const uint64_t header = 16, entry = 56;
+            if (size < header || std::memcmp(base, "RSTBNDL1", 8) != 0)
+                throw bad();
+            const uint64_t count = read(base + 8, 4);
+            if (count > (size - header) / entry)
+                throw bad();
+
+            auto view = [&](uint64_t offset, uint64_t n) {
+                if (offset > size || n > size - offset)
+                    throw bad();
+                return boost::string_view(base + offset, n);
+            };
+
+            self->files.reserve(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                const char* e = base + header + i * entry;
+                auto path = view(read(e, 8), read(e + 8, 4));
+                file f;
+                f.data = view(read(e + 16, 8), read(e + 24, 8));
+                f.gzip = view(read(e + 32, 8), read(e + 40, 8));
+                f.type = mime_type::resolve(fs::path(path.begin(), path.end()));
+
+                char etag[22];
+                auto hash = static_cast<unsigned long long>(read(e + 48, 8));
+                std::snprintf(etag, sizeof(etag), "\"%016llx\"", hash);
+                f.etag = etag;
+                std::snprintf(etag, sizeof(etag), "\"%016llx-gz\"", hash);
+                f.gzip_etag = etag;
+
+                self->files.push_back(std::move(f));
+                self->paths.emplace(path, &self->files.back());
+            }
+
+            if (opt.index.empty())
+                return;
+            // Directory paths, with and without trailing slash, serve
+            // their index file
+            std::vector<std::pair<std::string, const file*>> indexes;
+            for (auto& p : self->paths) {
+                auto& name = p.first;
+                if (name.size() <= opt.index.size() ||
+                    !name.ends_with(opt.index) ||
+                    name[name.size() - opt.index.size() - 1] != '/')
+                    continue;
+                auto dir = name.substr(0, name.size() - opt.index.size());
+                indexes.emplace_back(dir.to_string(), p.second);
+                if (dir.size() > 1)
+                    indexes.emplace_back(dir.substr(0, dir.size() - 1).to_string(), p.second);
+            }
+            self->dirs.reserve(indexes.size());
+            for (auto& d : indexes) {
+                self->dirs.push_back(std::move(d.first));
+                self->paths.emplace(self->dirs.back(), d.second);
+            }
+        }
+
+        static bool accepts_gzip(const request& req)
+        {
+            auto ae = req.get(http::field::accept_encoding);
+            if (!ae)
+                return false;
+            for (auto& enc : http::ext_list(*ae)) {
+                if (!boost::beast::iequals(enc.first, "gzip"))
+                    continue;
+                for (auto& param : enc.second) {
+                    if (param.first == "q" && (param.second == "0" ||
+                        param.second == "0.0" || param.second == "0.00" ||
+                        param.second == "0.000"))
+                        return false;
+                }
+                return true;
+            }
+            return false;
+        }
+
+        // Check if If-None-Match list has etag, or is "*". Tags are
+        // compared weakly, W/ prefix is ignored.
+        static bool etag_matches(boost::string_view list, boost::string_view etag)
+        {
+            for (;;) {
+                while (!list.empty() && (list.front() == ' ' ||
+                    list.front() == '\t' || list.front() == ','))
+                    list.remove_prefix(1);
+                if (list.empty())
+                    return false;
+                if (list.front() == '*')
+                    return true;
+                if (list.starts_with("W/"))
+                    list.remove_prefix(2);
+                if (list.empty() || list.front() != '"')
+                    return false;
+
+                size_t end = list.find('"', 1);
+                if (end == boost::string_view::npos)
+                    return false;
+                if (list.substr(0, end + 1) == etag)
+                    return true;
+                list.remove_prefix(end + 1);
+            }
+        }
+
+    public:
+        // Throws if bundle can not be opened or is malformed
+        static_bundle(const fs::path& bundle, static_bundle_options options = { })
+        : self(std::make_shared<impl>())
+        , opt(std::move(options))
+        {
+            load(bundle);
+        }
+
+        // Number of files in bundle
+        size_t size() const noexcept {
+            return self->files.size();
+        }
+
+        void operator()(const request& req, response& resp, next& parent_next) const
+        {
+            if (req.method() != http::verb::get)
+                return parent_next();
+
+            auto it = self->paths.find(req.path());
+            if (it == self->paths.end())
+                return parent_next();
+            auto& f = *it->second;
+
+            // Each representation has its own tag
+            bool gzip = !f.gzip.empty() && accepts_gzip(req);
+            auto& etag = gzip ? f.gzip_etag : f.etag;
+
+            resp.set(http::field::etag, etag);
+            if (!f.gzip.empty())
+                resp.set(http::field::vary, "Accept-Encoding");
+            if (!opt.cache_control.empty())
+                resp.set(http::field::cache_control, opt.cache_control);
+
+            auto inm = req.get(http::field::if_none_match);
+            if (inm && etag_matches(*inm, etag)) {
+                resp.status(304).send();
+                return;
+            }
+
+            resp.set(http::field::content_type, f.type);
+            if (gzip) {
+                resp.set(http::field::content_encoding, "gzip");
+                resp.send(shared_buffer(self, { f.gzip.data(), f.gzip.size() }));
+                return;
+            }
+            resp.send(shared_buffer(self, { f.data.data(), f.data.size() }));
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_STATIC_BUNDLE_HPP
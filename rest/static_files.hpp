@@ -23,6 +23,12 @@
 
 #include <rest/mime_type.hpp>
 
+#include <boost/functional/hash.hpp>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+
 namespace rest {
 
     struct static_files_options {
@@ -37,36 +43,130 @@ namespace rest {
             [](response& r, const fs::path& f, const fs::file_status&) {
                 r.set(http::field::content_type, mime_type::resolve(f));
             }};
+
+        // Time a request path is resolved to a file (or to no file)
+        // without looking at the filesystem again. 0 disables caching.
+        std::chrono::steady_clock::duration cache_ttl = std::chrono::seconds(1);
+
+        // Maximum number of cached paths
+        size_t cache_size = 4096;
     };
 
 
     struct static_files {
     private:
+        // Request path resolved to file
+        struct entry {
+            std::string key;
+            // Empty if there is no such file
+            fs::path file;
+            fs::file_status stat;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        using entry_ptr = std::shared_ptr<const entry>;
+
+        struct cache {
+            std::mutex mtx;
+            // Keys refer to entry::key
+            std::unordered_map<boost::string_view, entry_ptr,
+                boost::hash<boost::string_view>> entries;
+        };
+
         const fs::path fpath;
         const static_files_options opt;
+        std::shared_ptr<cache> files;
+
+        entry_ptr resolve(const boost::string_view& rp) const
+        {
+            auto e = std::make_shared<entry>();
+            e->key = rp.to_string();
+            e->expires = std::chrono::steady_clock::now() + opt.cache_ttl;
+
+            auto fname = fpath / fs::path(rp.begin(), rp.end());
+            auto stat = status(fname);
+
+            if (fs::is_directory(stat)) {
+                if (opt.index.empty())
+                    return e;
+                fname.append(opt.index.begin(), opt.index.end());
+                stat = status(fname);
+            }
+            if (fs::exists(stat)) {
+                e->file = std::move(fname);
+                e->stat = stat;
+            }
+            return e;
+        }
+
+        entry_ptr lookup(const boost::string_view& rp) const
+        {
+            if (opt.cache_ttl <= std::chrono::steady_clock::duration::zero())
+                return resolve(rp);
+
+            auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(files->mtx);
+                auto it = files->entries.find(rp);
+                if (it != files->entries.end() && it->second->expires > now)
+                    return it->second;
+            }
+
+            auto e = resolve(rp);
+            std::lock_guard<std::mutex> lock(files->mtx);
+            auto& entries = files->entries;
+            entries.erase(rp);
+            // Start over rather than track age of entries
+            if (entries.size() >= opt.cache_size)
+                entries.clear();
+            entries.emplace(e->key, e);
+            return e;
+        }
+
+        // Drop entry of a file no longer there
+        void forget(const entry_ptr& e) const
+        {
+            std::lock_guard<std::mutex> lock(files->mtx);
+            auto it = files->entries.find(e->key);
+            if (it != files->entries.end() && it->second == e)
+                files->entries.erase(it);
+        }
+
+        // Path must not leave the served directory
+        static bool is_safe(const boost::string_view& rp) noexcept
+        {
+            for (size_t pos = 0; pos < rp.size(); ) {
+                size_t end = rp.find('/', pos);
+                if (end == boost::string_view::npos)
+                    end = rp.size();
+                if (rp.substr(pos, end - pos) == "..")
+                    return false;
+                pos = end + 1;
+            }
+            return true;
+        }
 
     public:
         static_files(fs::path filepath, static_files_options options = { }) noexcept
         : fpath(std::move(filepath))
         , opt(std::move(options))
+        , files(std::make_shared<cache>())
         { }
 
         void operator()(const request& req, response& resp, next& parent_next) const
         {
-            if (req.method() == http::verb::get) {
-                const auto& rp = req.path();
-                auto fname = fpath / fs::path(rp.begin(), rp.end());
-                auto stat = status(fname);
-
-                if (fs::is_directory(stat)) {
-                    fname.append(opt.index.begin(), opt.index.end());
-                    stat = status(fname);
-                }
-
-                if (fs::exists(stat)) {
-                    opt.set_headers(resp, fname, stat);
-                    resp.send_file(fname);
-                    return;
+            if (req.method() == http::verb::get && is_safe(req.path())) {
+                auto e = lookup(req.path());
+                if (!e->file.empty()) {
+                    // Opened before headers are set, the file may be gone
+                    // since it was cached
+                    std::ifstream f(e->file.native(), std::ios::binary);
+                    if (f.is_open()) {
+                        opt.set_headers(resp, e->file, e->stat);
+                        resp.send(f.rdbuf());
+                        return;
+                    }
+                    forget(e);
                 }
             }
             // Call next if method not matched or file not found
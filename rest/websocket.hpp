@@ -0,0 +1,336 @@
+// Licensed under the MIT License <http://opensource.org/licenses/MIT>.
+// Copyright (c) 2018 Vladimir Talybin.
+
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+#ifndef REST_WEBSOCKET_HPP
+#define REST_WEBSOCKET_HPP
+
+#include <rest/forward.hpp>
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+namespace rest {
+
+    struct websocket_options {
+        // Maximum number of messages queued for sending to a client.
+        // A client not keeping up with the rate of messages is
+        // disconnected when its queue is full.
+        size_t max_queue = 64;
+
+        // Maximum size of incoming message
+        size_t max_message_size = 64 * 1024;
+    };
+
+
+    // Websocket connection. Copies refer to the same connection.
+    struct websocket {
+        using message_ptr = std::shared_ptr<const std::string>;
+        using open_handler = std::function<void(websocket&)>;
+        using message_handler = std::function<void(websocket&, std::string&&)>;
+        using close_handler = std::function<void(websocket&)>;
+
+        // Connection over any stream, implemented by basic_session
+        struct session_base : std::enable_shared_from_this<session_base> {
+            websocket_options opt;
+            message_handler on_message;
+            close_handler on_close;
+
+            virtual ~session_base() { }
+
+            virtual void accept(const request_message&, open_handler) = 0;
+            virtual void send(message_ptr, bool text) = 0;
+            virtual void close() = 0;
+        };
+
+        template <class Stream>
+        struct basic_session;
+
+    private:
+        std::shared_ptr<session_base> self;
+
+        friend struct websocket_group;
+
+    public:
+        websocket(std::shared_ptr<session_base> s) noexcept
+        : self(std::move(s))
+        { }
+
+        // Function called with every received message
+        void on_message(message_handler handler) {
+            self->on_message = std::move(handler);
+        }
+
+        // Function called when connection is closed
+        void on_close(close_handler handler) {
+            self->on_close = std::move(handler);
+        }
+
+        // Queue message for sending. May be called from any thread.
+        void send(std::string msg, bool text = true) {
+            self->send(std::make_shared<const std::string>(std::move(msg)), text);
+        }
+        void send(message_ptr msg, bool text = true) {
+            self->send(std::move(msg), text);
+        }
+
+        // Close connection when queued messages are sent
+        void close() {
+            self->close();
+        }
+
+        bool operator==(const websocket& other) const noexcept {
+            return self == other.self;
+        }
+    };
+
+
+    template <class Stream>
+    struct websocket::basic_session : websocket::session_base {
+    private:
+        // Strand over executor of io_context, websocket operations
+        // track work of the handler executor
+        using strand_type =
+            boost::asio::strand<boost::asio::io_context::executor_type>;
+
+        // Keeps the stream alive
+        std::shared_ptr<void> owner;
+        boost::beast::websocket::stream<Stream> ws;
+        strand_type strand;
+        boost::beast::flat_buffer buffer;
+
+        std::deque<std::pair<message_ptr, bool>> queue;
+        bool closing = false;
+        bool closed = false;
+
+        websocket handle() {
+            return { shared_from_this() };
+        }
+
+        // Run function in strand of connection
+        template <class F>
+        void post(F&& f) {
+            boost::asio::post(strand, std::forward<F>(f));
+        }
+
+        template <class F>
+        boost::asio::executor_binder<typename std::decay<F>::type, strand_type>
+        bind(F&& f) {
+            return boost::asio::bind_executor(strand, std::forward<F>(f));
+        }
+
+        void read()
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            ws.async_read(buffer, bind(
+                [s](boost::beast::error_code ec, size_t) {
+                    if (ec) {
+                        s->shutdown();
+                        return;
+                    }
+                    if (s->on_message) {
+                        auto h = s->handle();
+                        s->on_message(h,
+                            boost::beast::buffers_to_string(s->buffer.data()));
+                    }
+                    s->buffer.consume(s->buffer.size());
+                    s->read();
+                }));
+        }
+
+        void write()
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            if (queue.empty()) {
+                // The read loop ends the session
+                if (closing)
+                    ws.async_close(boost::beast::websocket::close_code::normal,
+                        bind([s](boost::beast::error_code) { }));
+                return;
+            }
+
+            // Message is kept alive by the handler, queue is cleared
+            // on shutdown while it is written
+            auto msg = queue.front().first;
+            ws.text(queue.front().second);
+            ws.async_write(boost::asio::buffer(*msg), bind(
+                [s, msg](boost::beast::error_code ec, size_t) {
+                    if (s->closed)
+                        return;
+                    if (ec) {
+                        s->shutdown();
+                        return;
+                    }
+                    s->queue.pop_front();
+                    s->write();
+                }));
+        }
+
+        // Drop the connection
+        void shutdown()
+        {
+            if (closed)
+                return;
+            closed = true;
+            queue.clear();
+
+            boost::system::error_code ec;
+            ws.next_layer().lowest_layer().close(ec);
+
+            if (on_close) {
+                auto h = handle();
+                on_close(h);
+            }
+            // Break reference cycles through user handlers
+            on_message = nullptr;
+            on_close = nullptr;
+        }
+
+    public:
+        basic_session(std::shared_ptr<void> o, Stream s)
+        : owner(std::move(o))
+        , ws(s)
+        , strand(static_cast<boost::asio::io_context&>(
+            boost::asio::query(ws.get_executor(),
+                boost::asio::execution::context)).get_executor())
+        { }
+
+        void accept(const request_message& req, open_handler on_open) override
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            ws.read_message_max(opt.max_message_size);
+            ws.async_accept(req, bind(
+                [s, on_open](boost::beast::error_code ec) {
+                    if (ec) {
+                        s->closed = true;
+                        return;
+                    }
+                    auto h = s->handle();
+                    on_open(h);
+                    s->read();
+                }));
+        }
+
+        void send(message_ptr msg, bool text) override
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            post([s, msg, text] {
+                if (s->closed || s->closing)
+                    return;
+                // Slow consumer
+                if (s->queue.size() >= s->opt.max_queue) {
+                    s->shutdown();
+                    return;
+                }
+                s->queue.emplace_back(msg, text);
+                if (s->queue.size() == 1)
+                    s->write();
+            });
+        }
+
+        void close() override
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            post([s] {
+                if (s->closed || s->closing)
+                    return;
+                s->closing = true;
+                if (s->queue.empty())
+                    s->write();
+            });
+        }
+    };
+
+
+    // Set of connections receiving the same messages
+    struct websocket_group {
+    private:
+        struct impl {
+            std::mutex mtx;
+            std::vector<std::weak_ptr<websocket::session_base>> members;
+        };
+
+        std::shared_ptr<impl> self;
+
+    public:
+        websocket_group()
+        : self(std::make_shared<impl>())
+        { }
+
+        // Add connection to group. Closed connections are removed
+        // automatically.
+        void join(const websocket& ws) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            self->members.emplace_back(ws.self);
+        }
+
+        void leave(const websocket& ws) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            auto& m = self->members;
+            m.erase(std::remove_if(m.begin(), m.end(),
+                [&](const std::weak_ptr<websocket::session_base>& p) {
+                    auto sp = p.lock();
+                    return !sp || sp == ws.self;
+                }), m.end());
+        }
+
+        // Send message to all connections of the group. The message is
+        // shared, not copied, between connections. Return number of
+        // connections the message was queued to.
+        size_t broadcast(std::string msg, bool text = true) {
+            return broadcast(
+                std::make_shared<const std::string>(std::move(msg)), text);
+        }
+
+        size_t broadcast(const websocket::message_ptr& msg, bool text = true)
+        {
+            std::vector<std::shared_ptr<websocket::session_base>> targets;
+            {
+                std::lock_guard<std::mutex> lock(self->mtx);
+                auto& m = self->members;
+                targets.reserve(m.size());
+                // Collect live connections and drop closed ones
+                m.erase(std::remove_if(m.begin(), m.end(),
+                    [&](const std::weak_ptr<websocket::session_base>& p) {
+                        auto sp = p.lock();
+                        if (!sp)
+                            return true;
+                        targets.push_back(std::move(sp));
+                        return false;
+                    }), m.end());
+            }
+
+            for (auto& t : targets)
+                t->send(msg, text);
+            return targets.size();
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            return self->members.size();
+        }
+    };
+
+} // namespace rest
+
+#endif // REST_WEBSOCKET_HPP
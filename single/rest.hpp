@@ -21,7 +21,7 @@
 // SOFTWARE.
 
 // This file was generated with a script.
-// Generated 2018-05-15 18:02:44.541123 UTC
+// Generated 2026-10-19 06:13:21.733383 UTC
 
 #ifndef REST_SINGLE_INCLUDE_HPP
 #define REST_SINGLE_INCLUDE_HPP
@@ -34,753 +34,6212 @@
 #define REST_VERSION_MINOR 0
 #define REST_VERSION_PATCH 0
 
+#include <boost/version.hpp>
 #include <boost/beast.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
 #include <boost/utility/string_view.hpp>
 #include <boost/filesystem.hpp>
 
+#include <cstring>
 #include <map>
 
+#if BOOST_VERSION < 107400
+#error "Rest requires Boost 1.74 or later"
+#endif
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && BOOST_VERSION < 107800
+#error "io_uring backend of Asio requires Boost 1.78 or later"
+#endif
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+#define REST_IO_URING
+#endif
+
 namespace rest {
 
     namespace fs = boost::filesystem;
 
     namespace http = boost::beast::http;
     using tcp = boost::asio::ip::tcp;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    namespace local = boost::asio::local;
+#endif
+
+    // Compare names by content, not by address
+    struct name_less {
+        bool operator()(const char* a, const char* b) const noexcept {
+            return std::strcmp(a, b) < 0;
+        }
+    };
+
+    using name_value_map = std::map<const char*, boost::string_view, name_less>;
 
-    using name_value_map = std::map<const char*, boost::string_view>;
+    using request_message = http::request<http::dynamic_body>;
+    using response_message = http::response<http::dynamic_body>;
 
 } // namespace rest
 
 // end of rest/forward.hpp
 
-// beginning of rest/error.hpp
+// beginning of rest/body_parser.hpp
 
-#include <boost/system/error_code.hpp>
+// beginning of rest/router.hpp
 
-namespace rest {
+// beginning of rest/request.hpp
 
-    struct error {
-    private:
-        std::string err;
+// beginning of rest/json.hpp
 
-    public:
-        error() noexcept = default;
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <type_traits>
 
-        error(const char* s) noexcept
-        : err(s)
-        { }
+#if __cplusplus >= 201703L && defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
 
-        error(std::string s) noexcept
-        : err(std::move(s))
-        { }
+namespace rest {
 
-        error(const std::exception& ex) noexcept
-        : err(ex.what())
-        { }
+    // Read-only view of a value in a JSON document. The document is
+    // validated once by parse(), nothing else is decoded until accessed.
+    // Members and elements are found by skipping over the text, views
+    // refer to the text and are valid as long as it is.
+    struct json_value {
+        enum class kind { null, boolean, number, string, array, object };
 
-        error(const boost::system::error_code& ec) noexcept
-        : err(ec.message())
+        struct iterator;
+
+    private:
+        boost::string_view text;
+        // Name of object member as in document
+        boost::string_view key;
+
+        json_value(boost::string_view t, boost::string_view k = { }) noexcept
+        : text(t)
+        , key(k)
         { }
 
-        operator bool() const noexcept {
-            return !err.empty();
+        static bool is_space(char c) noexcept {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t';
         }
 
-        const std::string& what() const noexcept {
-            return err;
+        static void skip_space(const char*& p, const char* end) noexcept {
+            while (p != end && is_space(*p))
+                ++p;
         }
 
-    };
-
-} // namespace rest
+        static bool is_digit(char c) noexcept {
+            return c >= '0' && c <= '9';
+        }
 
-// end of rest/error.hpp
+        static int hex(char c) noexcept {
+            if (is_digit(c))
+                return c - '0';
+            c |= 0x20;
+            return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        }
 
-// beginning of rest/mime_type.hpp
+        // Skip string of valid document, p is at the opening quote.
+        // Looks for quotes only, escapes are rare.
+        static void skip_string(const char*& p, const char* end) noexcept
+        {
+            for (++p; ; ) {
+                auto q = static_cast<const char*>(std::memchr(p, '"', end - p));
+                p = q + 1;
+                // Quote is escaped if preceded by odd number of backslashes
+                size_t n = 0;
+                while (q[-1 - n] == '\\')
+                    ++n;
+                if (n % 2 == 0)
+                    return;
+            }
+        }
 
-namespace rest {
+        // Skip value of valid document
+        static void skip_value(const char*& p, const char* end) noexcept
+        {
+            if (*p == '"') {
+                skip_string(p, end);
+                return;
+            }
+            if (*p != '{' && *p != '[') {
+                while (p != end && *p != ',' && *p != ']' && *p != '}' && !is_space(*p))
+                    ++p;
+                return;
+            }
+            for (int depth = 0; ; ) {
+                switch (*p) {
+                case '"':
+                    skip_string(p, end);
+                    continue;
+                case '{': case '[':
+                    ++depth;
+                    break;
+                case '}': case ']':
+                    if (--depth == 0) {
+                        ++p;
+                        return;
+                    }
+                    break;
+                }
+                ++p;
+            }
+        }
 
-    struct mime_type {
-        using table_type = std::map<boost::string_view, boost::string_view>;
+        // Validation of untrusted document
 
-        // Filename extension to mime type map.
-        // Extend example:
-        //   rest::mime_type::table().emplace(".mp4", "video/mp4");
-        // Modify example:
-        //   rest::mime_type::table()[".js"] = "text/javascript";
-        static table_type& table() noexcept {
-            static table_type t {
-                { ".bmp",   "image/bmp" },
-                { ".css",   "text/css" },
-                { ".flv",   "video/x-flv" },
-                { ".gif",   "image/gif" },
-                { ".htm",   "text/html" },
-                { ".html",  "text/html" },
-                { ".ico",   "image/vnd.microsoft.icon" },
-                { ".jpe",   "image/jpeg" },
-                { ".jpeg",  "image/jpeg" },
-                { ".jpg",   "image/jpeg" },
-                { ".js",    "application/javascript" },
-                { ".json",  "application/json" },
-                { ".php",   "text/html" },
-                { ".png",   "image/png" },
-                { ".svg",   "image/svg+xml" },
-                { ".svgz",  "image/svg+xml" },
-                { ".swf",   "application/x-shockwave-flash" },
-                { ".tif",   "image/tiff" },
-                { ".tiff",  "image/tiff" },
-                { ".txt",   "text/plain" },
-                { ".xml",   "application/xml" },
-            };
-            return t;
+        static bool check_string(const char*& p, const char* end) noexcept
+        {
+            for (++p; p != end; ++p) {
+                auto c = static_cast<unsigned char>(*p);
+                if (c == '"') {
+                    ++p;
+                    return true;
+                }
+                if (c < 0x20)
+                    return false;
+                if (c != '\\')
+                    continue;
+                if (++p == end)
+                    return false;
+                switch (*p) {
+                case '"': case '\\': case '/': case 'b':
+                case 'f': case 'n': case 'r': case 't':
+                    break;
+                case 'u':
+                    if (end - p < 5)
+                        return false;
+                    for (int i = 1; i <= 4; ++i) {
+                        if (hex(p[i]) < 0)
+                            return false;
+                    }
+                    p += 4;
+                    break;
+                default:
+                    return false;
+                }
+            }
+            return false;
         }
 
-        // Default type to be returned on no match. Change it by
-        // assigning, example:
-        //   rest::mime_type::default_type() = "text/plain";
-        static boost::string_view& default_type() noexcept {
-            static boost::string_view t { "application/octet-stream" };
-            return t;
+        static bool check_digits(const char*& p, const char* end) noexcept
+        {
+            auto start = p;
+            while (p != end && is_digit(*p))
+                ++p;
+            return p != start;
         }
 
-        // Return a reasonable mime type based on the extension of a file
-        static const boost::string_view& resolve(const fs::path& filename) noexcept
+        static bool check_number(const char*& p, const char* end) noexcept
         {
-            auto ext = filename.extension();
-            if (!ext.empty()) {
-                const table_type& t = table();
-                auto it = t.find(ext.native());
-                if (it != t.end())
-                    return it->second;
+            if (*p == '-')
+                ++p;
+            if (p != end && *p == '0')
+                ++p;
+            else if (!check_digits(p, end))
+                return false;
+            if (p != end && *p == '.') {
+                if (!check_digits(++p, end))
+                    return false;
             }
-            return default_type();
+            if (p != end && (*p == 'e' || *p == 'E')) {
+                if (++p != end && (*p == '+' || *p == '-'))
+                    ++p;
+                if (!check_digits(p, end))
+                    return false;
+            }
+            return true;
         }
 
-        // Pre-initialize static structures (optional)
-        mime_type() noexcept {
-            table();
-            default_type();
+        static bool check_literal(const char*& p, const char* end,
+            boost::string_view lit) noexcept
+        {
+            if (size_t(end - p) < lit.size() || lit.compare(0, lit.size(), p, lit.size()))
+                return false;
+            p += lit.size();
+            return true;
         }
-    };
-
-} // namespace rest
-
-// end of rest/mime_type.hpp
 
-// beginning of rest/next.hpp
+        static bool check_value(const char*& p, const char* end, unsigned depth) noexcept
+        {
+            skip_space(p, end);
+            if (p == end)
+                return false;
 
-namespace rest {
+            switch (*p) {
+            case '"':
+                return check_string(p, end);
+            case 't':
+                return check_literal(p, end, "true");
+            case 'f':
+                return check_literal(p, end, "false");
+            case 'n':
+                return check_literal(p, end, "null");
+            case '{': case '[':
+                break;
+            default:
+                return check_number(p, end);
+            }
 
-    struct next {
-    private:
-        struct impl {
-            bool proceed = false;
-            error err;
-        };
+            if (depth == 0)
+                return false;
+            const char close = *p == '{' ? '}' : ']';
+            ++p;
+            skip_space(p, end);
+            if (p != end && *p == close) {
+                ++p;
+                return true;
+            }
 
-        std::shared_ptr<impl> self;
+            for (;;) {
+                if (close == '}') {
+                    skip_space(p, end);
+                    if (p == end || *p != '"' || !check_string(p, end))
+                        return false;
+                    skip_space(p, end);
+                    if (p == end || *p++ != ':')
+                        return false;
+                }
+                if (!check_value(p, end, depth - 1))
+                    return false;
+                skip_space(p, end);
+                if (p == end)
+                    return false;
+                if (*p == close) {
+                    ++p;
+                    return true;
+                }
+                if (*p++ != ',')
+                    return false;
+            }
+        }
 
-    public:
-        next()
-        : self(std::make_shared<impl>())
-        { }
+        static void append_utf8(std::string& out, unsigned long cp)
+        {
+            if (cp < 0x80)
+                out += char(cp);
+            else if (cp < 0x800) {
+                out += char(0xc0 | cp >> 6);
+                out += char(0x80 | (cp & 0x3f));
+            }
+            else if (cp < 0x10000) {
+                out += char(0xe0 | cp >> 12);
+                out += char(0x80 | (cp >> 6 & 0x3f));
+                out += char(0x80 | (cp & 0x3f));
+            }
+            else {
+                out += char(0xf0 | cp >> 18);
+                out += char(0x80 | (cp >> 12 & 0x3f));
+                out += char(0x80 | (cp >> 6 & 0x3f));
+                out += char(0x80 | (cp & 0x3f));
+            }
+        }
 
-        void operator()() noexcept {
-            self->proceed = true;
+        static unsigned long read_hex4(const char* p) noexcept {
+            return hex(p[0]) << 12 | hex(p[1]) << 8 | hex(p[2]) << 4 | hex(p[3]);
         }
-        void operator()(error&& err) noexcept {
-            self->proceed = true;
-            self->err = std::move(err);
+
+        // Unescaped content of string without quotes
+        static std::string unescape(boost::string_view s)
+        {
+            std::string out;
+            out.reserve(s.size());
+            for (auto p = s.begin(), end = s.end(); p != end; ++p) {
+                if (*p != '\\') {
+                    out += *p;
+                    continue;
+                }
+                switch (*++p) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    unsigned long cp = read_hex4(p + 1);
+                    p += 4;
+                    // Surrogate pair
+                    if (cp >= 0xd800 && cp < 0xdc00 && end - p > 6 &&
+                        p[1] == '\\' && p[2] == 'u')
+                    {
+                        unsigned long lo = read_hex4(p + 3);
+                        if (lo >= 0xdc00 && lo < 0xe000) {
+                            cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+                            p += 6;
+                        }
+                    }
+                    append_utf8(out, cp);
+                    break;
+                }
+                default:
+                    out += *p;
+                }
+            }
+            return out;
         }
 
-        template <class F>
-        bool safe_invoke(F&& f) noexcept {
-            self->proceed = false;
+    public:
+        // Missing value
+        json_value() noexcept = default;
 
-            try {
-                std::forward<F>(f)();
-            }
-            catch (const std::exception& ex) { operator()(ex); }
-            catch (const boost::system::error_code& ec) { operator()(ec); }
-            catch (...) { operator()("unknown error"); }
+        // Validate document, return missing value if it is not valid
+        // JSON or nested deeper than max_depth
+        static json_value parse(boost::string_view doc, unsigned max_depth = 64) noexcept
+        {
+            auto p = doc.begin(), end = doc.end();
+            if (!check_value(p, end, max_depth))
+                return { };
+            skip_space(p, end);
+            if (p != end)
+                return { };
 
-            return self->proceed;
+            auto first = doc.begin();
+            skip_space(first, end);
+            auto last = end;
+            while (is_space(last[-1]))
+                --last;
+            return json_value({ first, size_t(last - first) });
         }
 
-        const error& err() const noexcept {
-            return self->err;
+        // False if value is missing (ex. member not found)
+        explicit operator bool() const noexcept {
+            return !text.empty();
         }
-    };
-
-} // namespace rest
 
-// end of rest/next.hpp
+        // Type of value, null if missing
+        kind type() const noexcept
+        {
+            if (text.empty())
+                return kind::null;
+            switch (text.front()) {
+            case 'n': return kind::null;
+            case 't': case 'f': return kind::boolean;
+            case '"': return kind::string;
+            case '[': return kind::array;
+            case '{': return kind::object;
+            default: return kind::number;
+            }
+        }
 
-// beginning of rest/path.hpp
+        bool is_null() const noexcept {
+            return type() == kind::null;
+        }
 
-#include <regex>
+        // Text of value as in document
+        boost::string_view raw() const noexcept {
+            return text;
+        }
 
-namespace rest {
+        // Name of object member as in document, without quotes
+        boost::string_view name() const noexcept {
+            return key;
+        }
 
-    struct path {
-    private:
-        std::string regex;
-        std::vector<std::pair<size_t, std::string>> params;
+        bool as_bool() const noexcept {
+            return !text.empty() && text.front() == 't';
+        }
 
-    public:
-        path(const boost::string_view& uri) noexcept
+        // Number value, 0 if not a number
+        double as_double() const
         {
-            size_t distance = 0;
-            std::string name;
-
-            for (auto it = uri.begin(); it != uri.end();) {
-                regex.push_back(*it);
-                if (*it++ != '/')
-                    continue;
-
-                ++distance;
-                if (it != uri.end() && *it == ':') {
-                    // Replace parameter with \w+
-                    regex.append("\\w+", 3);
-                    while (++it != uri.end() && *it != '/')
-                        name.push_back(*it);
-                    // Store parameter
-                    params.emplace_back(distance, std::move(name));
-                    distance = 0;
-                }
+            if (type() != kind::number)
+                return 0;
+            // Copy for null terminated string
+            char buf[64];
+            if (text.size() < sizeof(buf)) {
+                std::memcpy(buf, text.data(), text.size());
+                buf[text.size()] = 0;
+                return std::strtod(buf, nullptr);
             }
+            return std::strtod(text.to_string().c_str(), nullptr);
         }
 
-        bool match(const boost::string_view& uri, std::cmatch& cm) const
+        // Integral part of number value, 0 if not a number. Values out
+        // of range are saturated.
+        long long as_int() const
         {
-            std::regex rx(regex);
-            if (!std::regex_search(uri.begin(), uri.end(), cm, rx))
-                return false;
-            // Match must occur at the beginning
-            return (cm.position(0) == 0);
+            using limits = std::numeric_limits<long long>;
+            if (type() != kind::number)
+                return 0;
+            auto p = text.begin(), end = text.end();
+            bool neg = *p == '-';
+            if (neg)
+                ++p;
+            // Magnitude of the minimum is one more than of the maximum
+            const unsigned long long max =
+                static_cast<unsigned long long>(limits::max()) + neg;
+            unsigned long long v = 0;
+            for (; p != end && is_digit(*p); ++p) {
+                unsigned d = *p - '0';
+                if (v > (max - d) / 10)
+                    return neg ? limits::min() : limits::max();
+                v = v * 10 + d;
+            }
+            // Exponent, let strtod deal with it
+            if (p != end && *p != '.') {
+                double d = as_double();
+                if (d >= 9223372036854775807.0)
+                    return limits::max();
+                if (d <= -9223372036854775808.0)
+                    return limits::min();
+                return static_cast<long long>(d);
+            }
+            if (!neg)
+                return static_cast<long long>(v);
+            return v == max ? limits::min() : -static_cast<long long>(v);
         }
 
-        name_value_map get_params(const boost::string_view& uri) const noexcept
+        // Content of string with escapes resolved, text of other values
+        std::string as_string() const
         {
-            name_value_map pm;
-            size_t start = 1;
-
-            for (auto& p : params) {
-                // Find value by counting '/' in current uri
-                for (auto dist = p.first; dist > 1; --dist)
-                    start = uri.find('/', start) + 1;
-                size_t stop = start;
-                for (; stop < uri.size() && uri[stop] != '/'; ++stop);
-
-                pm.emplace(p.second.c_str(),
-                    boost::string_view(&uri[start], stop - start));
-                start = stop + 1;
-            }
-            return pm;
+            if (type() != kind::string)
+                return text.to_string();
+            auto s = text.substr(1, text.size() - 2);
+            if (s.find('\\') == boost::string_view::npos)
+                return s.to_string();
+            return unescape(s);
         }
-    };
 
-} // namespace rest
+        // Content of string as in document (escapes are not resolved)
+        boost::string_view as_string_view() const noexcept {
+            if (type() != kind::string)
+                return text;
+            return text.substr(1, text.size() - 2);
+        }
 
-// end of rest/path.hpp
+        // Elements of array or members of object
+        iterator begin() const noexcept;
+        iterator end() const noexcept;
 
-// beginning of rest/router.hpp
+        // Number of elements of array or members of object
+        size_t size() const noexcept;
 
-// beginning of rest/request.hpp
+        // Member of object, missing value if not found
+        json_value operator[](boost::string_view name) const;
 
-namespace rest {
+        // Element of array, missing value if out of range
+        json_value operator[](size_t index) const noexcept;
+    };
 
-    struct server;
+    struct json_value::iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = json_value;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const json_value*;
+        using reference = const json_value&;
 
-    struct request {
     private:
-        using socket_ptr = std::shared_ptr<tcp::socket>;
+        friend struct json_value;
 
-        struct impl {
-            impl(const socket_ptr& s) noexcept
-            : socket(s)
-            { }
+        // Start of current value, the closing bracket at end
+        const char* pos = nullptr;
+        const char* next = nullptr;
+        const char* last = nullptr;
+        json_value cur;
 
-            socket_ptr socket;
-            http::request<http::dynamic_body> req;
-            boost::beast::flat_buffer buffer { 8192 };
+        iterator(const char* p, const char* e) noexcept
+        : next(p)
+        , last(e)
+        {
+            load();
+        }
 
-            const server* app = nullptr;
-            name_value_map params;
-            boost::string_view base_url;
-            boost::string_view path;
-        };
+        // Read value following current one
+        void load() noexcept
+        {
+            pos = next;
+            skip_space(pos, last);
+            if (pos == last)
+                return;
 
-        std::shared_ptr<impl> self;
+            auto p = pos;
+            boost::string_view name;
+            if (*last == '}') {
+                skip_string(p, last);
+                name = { pos + 1, size_t(p - pos - 2) };
+                skip_space(p, last);
+                // Colon
+                ++p;
+                skip_space(p, last);
+            }
+            auto start = p;
+            skip_value(p, last);
+            cur = json_value({ start, size_t(p - start) }, name);
+            skip_space(p, last);
+            // Comma or closing bracket
+            if (*p == ',')
+                ++p;
+            next = p;
+        }
 
     public:
-        request(const socket_ptr& s)
-        : self(std::make_shared<impl>(s))
-        { }
+        iterator() noexcept = default;
 
-        // Asynchronous receive of request
-        template <class C>
-        static void receive(const socket_ptr& sock, C&& cb) {
-            request req(sock);
-            http::async_read(*sock, req.self->buffer, req.self->req,
-                [req, cb](boost::beast::error_code err, size_t) mutable
-            {
-                if (!err) cb(req);
-            });
+        reference operator*() const noexcept {
+            return cur;
         }
-
-        const socket_ptr& socket() const noexcept {
-            return self->socket;
+        pointer operator->() const noexcept {
+            return &cur;
         }
 
-        // Root route (server generated this request)
-        const server& app() const noexcept {
-            return *self->app;
+        iterator& operator++() noexcept {
+            load();
+            return *this;
         }
-        void app(const server* val) noexcept {
-            self->app = val;
+        iterator operator++(int) noexcept {
+            auto tmp = *this;
+            load();
+            return tmp;
         }
 
-        // The url path on which a router instance was mounted
-        const boost::string_view& base_url() const noexcept {
-            return self->base_url;
+        bool operator==(const iterator& other) const noexcept {
+            return pos == other.pos;
         }
-        void base_url(const boost::string_view& val) noexcept {
-            self->base_url = val;
+        bool operator!=(const iterator& other) const noexcept {
+            return pos != other.pos;
         }
+    };
 
-        // The remaining path part of the router mount point
-        const boost::string_view& path() const noexcept {
-            return self->path;
-        }
-        void path(const boost::string_view& val) noexcept {
-            self->path = val;
-        }
+    inline json_value::iterator json_value::begin() const noexcept
+    {
+        auto t = type();
+        if (t != kind::array && t != kind::object)
+            return { };
+        // Iterator ends at the closing bracket
+        return { text.data() + 1, text.data() + text.size() - 1 };
+    }
 
-        // Named route parameters
-        //name_value_map& params() const noexcept {
-        name_value_map& params() const noexcept {
-            return self->params;
+    inline json_value::iterator json_value::end() const noexcept
+    {
+        iterator it;
+        auto t = type();
+        if (t == kind::array || t == kind::object)
+            it.pos = text.data() + text.size() - 1;
+        return it;
+    }
+
+    inline size_t json_value::size() const noexcept {
+        return std::distance(begin(), end());
+    }
+
+    inline json_value json_value::operator[](boost::string_view name) const
+    {
+        for (auto it = begin(), last = end(); it != last; ++it) {
+            auto k = it->name();
+            if (k.find('\\') == boost::string_view::npos ? k == name : unescape(k) == name)
+                return *it;
         }
+        return { };
+    }
 
-        // Contains a string corresponding to the HTTP method
-        // of the request: GET, POST, PUT, and so on
-        boost::string_view method_string() const noexcept {
-            return self->req.method_string();
+    inline json_value json_value::operator[](size_t index) const noexcept
+    {
+        for (auto it = begin(), last = end(); it != last; ++it, --index) {
+            if (index == 0)
+                return *it;
         }
+        return { };
+    }
 
-        // HTTP method of the request as a boost::beast::http::verb enum
-        http::verb method() const noexcept {
-            return self->req.method();
+    // Writes JSON directly into a buffer, ex. body of response. Commas
+    // are placed automatically, nesting is not checked.
+    //
+    //   w.begin_object().key("pi").value(3.141).end_object();
+    struct json_writer {
+        using buffer_type = boost::beast::multi_buffer;
+
+    private:
+        buffer_type& buf;
+        // Prepared space of buffer written so far
+        char* first = nullptr;
+        char* pos = nullptr;
+        char* last = nullptr;
+        // Next value is preceded by comma
+        bool comma = false;
+
+        // Commit written and prepare space for more
+        void grow()
+        {
+            commit();
+            auto mb = buf.prepare(4096);
+            auto b = *boost::asio::buffer_sequence_begin(mb);
+            first = pos = static_cast<char*>(b.data());
+            last = first + b.size();
         }
 
-        // The original request url
-        boost::string_view original_url() const noexcept {
-            return self->req.target();
+        void put(char c)
+        {
+            if (pos == last)
+                grow();
+            *pos++ = c;
+        }
+
+        void put(const char* s, size_t n)
+        {
+            while (n) {
+                if (pos == last)
+                    grow();
+                size_t k = std::min(n, size_t(last - pos));
+                std::memcpy(pos, s, k);
+                pos += k;
+                s += k;
+                n -= k;
+            }
+        }
+
+        void separate()
+        {
+            if (comma)
+                put(',');
+            comma = true;
+        }
+
+        void quote(boost::string_view s)
+        {
+            static const char hex[] = "0123456789abcdef";
+            put('"');
+            auto run = s.begin();
+            for (auto p = s.begin(); p != s.end(); ++p) {
+                auto c = static_cast<unsigned char>(*p);
+                if (c >= 0x20 && c != '"' && c != '\\')
+                    continue;
+                put(run, p - run);
+                run = p + 1;
+                put('\\');
+                switch (c) {
+                case '"': put('"'); break;
+                case '\\': put('\\'); break;
+                case '\b': put('b'); break;
+                case '\f': put('f'); break;
+                case '\n': put('n'); break;
+                case '\r': put('r'); break;
+                case '\t': put('t'); break;
+                default:
+                    put("u00", 3);
+                    put(hex[c >> 4]);
+                    put(hex[c & 15]);
+                }
+            }
+            put(run, s.end() - run);
+            put('"');
         }
 
-        // Get header by name. T is a case-insensitive matching field
-        // name or a rest::http::field value.
         template <class T>
-        boost::optional<boost::string_view> get(T name) const noexcept {
-            auto it = self->req.find(name);
-            if (it != self->req.end())
-                return it->value();
-            return { };
+        void integer(T v)
+        {
+            char tmp[24];
+            char* p = tmp + sizeof(tmp);
+            // Negate as unsigned, minimum value has no positive counterpart
+            using U = typename std::make_unsigned<T>::type;
+            U u = v < 0 ? U(0) - U(v) : U(v);
+            do {
+                *--p = char('0' + u % 10);
+                u /= 10;
+            } while (u);
+            if (v < 0)
+                *--p = '-';
+            put(p, tmp + sizeof(tmp) - p);
+        }
+
+        void number(double v)
+        {
+            // Not representable in JSON
+            if (!std::isfinite(v)) {
+                put("null", 4);
+                return;
+            }
+            char tmp[32];
+#if defined(__cpp_lib_to_chars)
+            // Shortest representation that reads back the same
+            auto r = std::to_chars(tmp, tmp + sizeof(tmp), v);
+            put(tmp, r.ptr - tmp);
+#else
+            // Integral values are exact as integers
+            if (v == std::floor(v) && std::fabs(v) < 9007199254740992.0 && (v || !std::signbit(v))) {
+                integer(static_cast<long long>(v));
+                return;
+            }
+            int n = std::snprintf(tmp, sizeof(tmp), "%.15g", v);
+            if (std::strtod(tmp, nullptr) != v)
+                n = std::snprintf(tmp, sizeof(tmp), "%.17g", v);
+            // Decimal comma of locale
+            std::replace(tmp, tmp + n, ',', '.');
+            put(tmp, n);
+#endif
+        }
+
+    public:
+        json_writer(buffer_type& b) noexcept
+        : buf(b)
+        { }
+
+        json_writer(const json_writer&) = delete;
+        json_writer& operator=(const json_writer&) = delete;
+
+        ~json_writer() {
+            commit();
+        }
+
+        // Make written data part of buffer. Called by destructor.
+        void commit()
+        {
+            buf.commit(pos - first);
+            first = pos;
+        }
+
+        json_writer& begin_object() {
+            separate();
+            put('{');
+            comma = false;
+            return *this;
+        }
+        json_writer& end_object() {
+            put('}');
+            comma = true;
+            return *this;
+        }
+
+        json_writer& begin_array() {
+            separate();
+            put('[');
+            comma = false;
+            return *this;
+        }
+        json_writer& end_array() {
+            put(']');
+            comma = true;
+            return *this;
+        }
+
+        // Name of object member, followed by its value
+        json_writer& key(boost::string_view name) {
+            separate();
+            quote(name);
+            put(':');
+            comma = false;
+            return *this;
+        }
+
+        json_writer& value(boost::string_view s) {
+            separate();
+            quote(s);
+            return *this;
+        }
+        json_writer& value(const char* s) {
+            return value(boost::string_view(s));
+        }
+        json_writer& value(const std::string& s) {
+            return value(boost::string_view(s));
+        }
+
+        json_writer& value(bool b) {
+            separate();
+            if (b)
+                put("true", 4);
+            else
+                put("false", 5);
+            return *this;
+        }
+
+        json_writer& value(std::nullptr_t) {
+            separate();
+            put("null", 4);
+            return *this;
+        }
+
+        template <class T>
+        typename std::enable_if<std::is_integral<T>::value, json_writer&>::type
+        value(T v) {
+            separate();
+            integer(v);
+            return *this;
+        }
+
+        // Not finite numbers are written as null
+        json_writer& value(double v) {
+            separate();
+            number(v);
+            return *this;
+        }
+
+        // Value of parsed document, written as is
+        json_writer& value(const json_value& v) {
+            if (!v)
+                return value(nullptr);
+            separate();
+            put(v.raw().data(), v.raw().size());
+            return *this;
         }
     };
 
 } // namespace rest
 
-// end of rest/request.hpp
+// end of rest/json.hpp
 
-// beginning of rest/response.hpp
+// beginning of rest/locals.hpp
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <vector>
 
 namespace rest {
 
-    struct response {
-    private:
-        struct impl {
-            impl(const request& r) noexcept
-            : req(r)
+    // Values middlewares attach to a request for handlers that follow,
+    // ex. authenticated user or trace id. Small values of the first
+    // keys are kept inline, a request does not allocate for them.
+    struct locals {
+        // Bytes of values kept inline, larger ones are allocated
+        static constexpr size_t inline_size = 128;
+        // Keys with a slot inline, values of other keys are found by search
+        static constexpr size_t inline_slots = 8;
+
+        // Key of a value of type T. Keys are meant to be created once
+        // at startup, each takes a slot of its own.
+        //
+        //   static const rest::locals::key<user> current_user;
+        template <class T>
+        struct key {
+        private:
+            friend struct locals;
+            const size_t slot;
+
+        public:
+            key() noexcept
+            : slot(next_slot())
             { }
 
-            request req;
-            http::response<http::dynamic_body> resp;
-            bool is_sent = false;
+            key(const key&) = delete;
+            key& operator=(const key&) = delete;
         };
 
-        std::shared_ptr<impl> self;
+    private:
+        struct entry {
+            size_t slot;
+            void* value;
+            void (*destroy)(void*);
+        };
 
-    public:
-        response(const request& req)
-        : self(std::make_shared<impl>(req))
-        { }
+        typename std::aligned_storage<inline_size, alignof(std::max_align_t)>::type arena;
+        size_t used = 0;
+        entry slots[inline_slots] = { };
+        std::vector<entry> more;
+
+        static size_t next_slot() noexcept {
+            static std::atomic<size_t> n { 0 };
+            return n++;
+        }
+
+        // Entry of slot, null if key has none yet
+        entry* find(size_t slot) noexcept
+        {
+            if (slot < inline_slots)
+                return &slots[slot];
+            for (auto& e : more) {
+                if (e.slot == slot)
+                    return &e;
+            }
+            return nullptr;
+        }
 
-        // Set a header field value, removing any other instances of that field.
-        // T is a case-insensitive matching field name or a rest::http::field value.
         template <class T>
-        void set(T name, const boost::beast::string_param& value) {
-            self->resp.set(name, value);
+        static void destroy_inline(void* p) noexcept {
+            static_cast<T*>(p)->~T();
         }
 
-        // Sets the HTTP status for the response
-        response& status(unsigned code) {
-            self->resp.result(code);
-            return *this;
+        template <class T>
+        static void destroy_allocated(void* p) noexcept {
+            delete static_cast<T*>(p);
         }
 
-        // Gets the HTTP status for the response
-        unsigned status() const noexcept {
-            return self->resp.result_int();
+        // Space in arena for T, null if it does not fit
+        template <class T>
+        void* allocate() noexcept
+        {
+            size_t offset = (used + alignof(T) - 1) / alignof(T) * alignof(T);
+            if (offset + sizeof(T) > inline_size)
+                return nullptr;
+            used = offset + sizeof(T);
+            return reinterpret_cast<unsigned char*>(&arena) + offset;
         }
 
-        // Send file content
-        void send_file(const fs::path& fname) {
-            std::ifstream f(fname.native(), std::ios::binary);
-            if (f.is_open()) {
-                send(f.rdbuf());
+    public:
+        locals() noexcept = default;
+
+        locals(const locals&) = delete;
+        locals& operator=(const locals&) = delete;
+
+        ~locals()
+        {
+            for (auto& e : more) {
+                if (e.value)
+                    e.destroy(e.value);
+            }
+            for (auto& e : slots) {
+                if (e.value)
+                    e.destroy(e.value);
+            }
+        }
+
+        // Construct value of key, replacing previous one. Space of a
+        // replaced inline value is not reused.
+        template <class T, class... Args>
+        T& emplace(const key<T>& k, Args&&... args)
+        {
+            static_assert(alignof(T) <= alignof(std::max_align_t),
+                "over-aligned values are not supported");
+
+            auto e = find(k.slot);
+            if (!e) {
+                more.push_back({ k.slot, nullptr, nullptr });
+                e = &more.back();
+            }
+            else if (e->value) {
+                e->destroy(e->value);
+                e->value = nullptr;
+            }
+
+            T* value;
+            void (*destroy)(void*);
+            if (void* p = allocate<T>()) {
+                value = new (p) T(std::forward<Args>(args)...);
+                destroy = &destroy_inline<T>;
             }
+            else {
+                value = new T(std::forward<Args>(args)...);
+                destroy = &destroy_allocated<T>;
+            }
+            *e = { k.slot, value, destroy };
+            return *value;
         }
 
-        // Sends the HTTP response with a body
+        // Value of key, null if not set
         template <class T>
-        void send(const T& body) {
-            boost::beast::ostream(self->resp.body()) << body;
-            set(http::field::content_length, self->resp.body().size());
-            send();
+        T* get(const key<T>& k) noexcept {
+            auto e = find(k.slot);
+            return e ? static_cast<T*>(e->value) : nullptr;
         }
 
-        // Sends the HTTP response. Correspond to end() method in nodejs express.
-        void send() {
-            self->resp.keep_alive(false);
+        template <class T>
+        const T* get(const key<T>& k) const noexcept {
+            return const_cast<locals*>(this)->get(k);
+        }
+    };
 
-            auto scopy = self;
-            http::async_write(*self->req.socket(), self->resp,
-                [scopy](boost::beast::error_code err, size_t)
-            {
-                scopy->req.socket()->shutdown(tcp::socket::shutdown_send, err);
-            });
+} // namespace rest
 
-            self->is_sent = true;
+// end of rest/locals.hpp
+
+// beginning of rest/session.hpp
+
+// beginning of rest/shared_buffer.hpp
+
+#include <memory>
+
+namespace rest {
+
+    // Immutable bytes shared by any number of responses, ex. a generated
+    // snapshot sent to many clients. Copies refer to the same bytes.
+    struct shared_buffer {
+    private:
+        // Keeps the bytes alive
+        std::shared_ptr<const void> owner;
+        boost::asio::const_buffer bytes;
+
+    public:
+        shared_buffer() noexcept = default;
+
+        shared_buffer(std::string data)
+        {
+            auto s = std::make_shared<const std::string>(std::move(data));
+            bytes = boost::asio::buffer(*s);
+            owner = std::move(s);
         }
 
-        // Return true if response queing to be sent or is already sent
-        bool is_sent() const noexcept {
-            return self->is_sent;
+        shared_buffer(std::shared_ptr<const std::string> data) noexcept
+        : owner(data)
+        , bytes(data ? boost::asio::buffer(*data) : boost::asio::const_buffer())
+        { }
+
+        // Bytes kept alive by owner, ex. part of a memory-mapped file
+        shared_buffer(std::shared_ptr<const void> o, boost::asio::const_buffer data) noexcept
+        : owner(std::move(o))
+        , bytes(data)
+        { }
+
+        boost::asio::const_buffer data() const noexcept {
+            return bytes;
         }
 
-        // Sets the response Location HTTP header to the specified path
-        // parameter. Currently supports absolute path only.
-        void location(const boost::string_view& path) {
-            set(http::field::location, path);
+        size_t size() const noexcept {
+            return bytes.size();
         }
+    };
 
-        // Redirects to the URL derived from the specified path. If not
-        // specified, status defaults to "302 Found".
-        void redirect(unsigned code, const boost::string_view& path) {
-            location(path);
-            status(code).send();
+    // Shared buffer replaced atomically. A producer may store a new
+    // snapshot while responses are sending the previous one.
+    struct atomic_shared_buffer {
+    private:
+        std::shared_ptr<const shared_buffer> self;
+
+    public:
+        atomic_shared_buffer(shared_buffer b = { })
+        : self(std::make_shared<const shared_buffer>(std::move(b)))
+        { }
+
+        shared_buffer load() const {
+            return *std::atomic_load(&self);
         }
-        void redirect(const boost::string_view& path) {
-            redirect(302, path);
+
+        void store(shared_buffer b) {
+            std::atomic_store(&self,
+                std::shared_ptr<const shared_buffer>(
+                    std::make_shared<const shared_buffer>(std::move(b))));
+        }
+    };
+
+    // Body of HTTP message written from a shared buffer as is
+    struct shared_buffer_body {
+        using value_type = shared_buffer;
+
+        static std::uint64_t size(const value_type& body) noexcept {
+            return body.size();
         }
+
+        struct writer {
+            using const_buffers_type = boost::asio::const_buffer;
+
+            template <bool isRequest, class Fields>
+            writer(const http::header<isRequest, Fields>&, const value_type& b) noexcept
+            : body(b)
+            { }
+
+            void init(boost::beast::error_code& ec) noexcept {
+                ec = { };
+            }
+
+            boost::optional<std::pair<const_buffers_type, bool>>
+            get(boost::beast::error_code& ec) noexcept {
+                ec = { };
+                return {{ body.data(), false }};
+            }
+
+        private:
+            const value_type& body;
+        };
     };
 
+    using shared_response_message = http::response<shared_buffer_body>;
+
 } // namespace rest
 
-// end of rest/response.hpp
+// end of rest/shared_buffer.hpp
 
-#include <boost/variant.hpp>
+// beginning of rest/websocket.hpp
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/strand.hpp>
+#include <deque>
+#include <mutex>
 
 namespace rest {
 
-    template <class... Args>
-    using callback = std::function<void(Args...)>;
+    struct websocket_options {
+        // Maximum number of messages queued for sending to a client.
+        // A client not keeping up with the rate of messages is
+        // disconnected when its queue is full.
+        size_t max_queue = 64;
 
-    struct router;
-    struct route;
+        // Maximum size of incoming message
+        size_t max_message_size = 64 * 1024;
+    };
 
-    using req_resp = callback<const request&, response&>;
-    using req_resp_next = callback<const request&, response&, next&>;
+    // Websocket connection. Copies refer to the same connection.
+    struct websocket {
+        using message_ptr = std::shared_ptr<const std::string>;
+        using open_handler = std::function<void(websocket&)>;
+        using message_handler = std::function<void(websocket&, std::string&&)>;
+        using close_handler = std::function<void(websocket&)>;
 
-    using param_handler = callback<const request&, response&, next&, const boost::string_view&>;
-    using error_handler = callback<const error&, const request&, response&, next&>;
-    using route_handler = boost::variant<req_resp, req_resp_next, router>;
+        // Connection over any stream, implemented by basic_session
+        struct session_base : std::enable_shared_from_this<session_base> {
+            websocket_options opt;
+            message_handler on_message;
+            close_handler on_close;
 
-    enum class route_type {
-        use,
-        method,
-        all
+            virtual ~session_base() { }
+
+            virtual void accept(const request_message&, open_handler) = 0;
+            virtual void send(message_ptr, bool text) = 0;
+            virtual void close() = 0;
+        };
+
+        template <class Stream>
+        struct basic_session;
+
+    private:
+        std::shared_ptr<session_base> self;
+
+        friend struct websocket_group;
+
+    public:
+        websocket(std::shared_ptr<session_base> s) noexcept
+        : self(std::move(s))
+        { }
+
+        // Function called with every received message
+        void on_message(message_handler handler) {
+            self->on_message = std::move(handler);
+        }
+
+        // Function called when connection is closed
+        void on_close(close_handler handler) {
+            self->on_close = std::move(handler);
+        }
+
+        // Queue message for sending. May be called from any thread.
+        void send(std::string msg, bool text = true) {
+            self->send(std::make_shared<const std::string>(std::move(msg)), text);
+        }
+        void send(message_ptr msg, bool text = true) {
+            self->send(std::move(msg), text);
+        }
+
+        // Close connection when queued messages are sent
+        void close() {
+            self->close();
+        }
+
+        bool operator==(const websocket& other) const noexcept {
+            return self == other.self;
+        }
     };
 
-    struct router {
+    template <class Stream>
+    struct websocket::basic_session : websocket::session_base {
     private:
-        struct visitor : boost::static_visitor<> {
-        private:
-            request& req;
-            response& resp;
+        // Strand over executor of io_context, websocket operations
+        // track work of the handler executor
+        using strand_type =
+            boost::asio::strand<boost::asio::io_context::executor_type>;
+
+        // Keeps the stream alive
+        std::shared_ptr<void> owner;
+        boost::beast::websocket::stream<Stream> ws;
+        strand_type strand;
+        boost::beast::flat_buffer buffer;
+
+        std::deque<std::pair<message_ptr, bool>> queue;
+        bool closing = false;
+        bool closed = false;
+
+        websocket handle() {
+            return { shared_from_this() };
+        }
+
+        // Run function in strand of connection
+        template <class F>
+        void post(F&& f) {
+            boost::asio::post(strand, std::forward<F>(f));
+        }
+
+        template <class F>
+        boost::asio::executor_binder<typename std::decay<F>::type, strand_type>
+        bind(F&& f) {
+            return boost::asio::bind_executor(strand, std::forward<F>(f));
+        }
+
+        void read()
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            ws.async_read(buffer, bind(
+                [s](boost::beast::error_code ec, size_t) {
+                    if (ec) {
+                        s->shutdown();
+                        return;
+                    }
+                    if (s->on_message) {
+                        auto h = s->handle();
+                        s->on_message(h,
+                            boost::beast::buffers_to_string(s->buffer.data()));
+                    }
+                    s->buffer.consume(s->buffer.size());
+                    s->read();
+                }));
+        }
+
+        void write()
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            if (queue.empty()) {
+                // The read loop ends the session
+                if (closing)
+                    ws.async_close(boost::beast::websocket::close_code::normal,
+                        bind([s](boost::beast::error_code) { }));
+                return;
+            }
+
+            // Message is kept alive by the handler, queue is cleared
+            // on shutdown while it is written
+            auto msg = queue.front().first;
+            ws.text(queue.front().second);
+            ws.async_write(boost::asio::buffer(*msg), bind(
+                [s, msg](boost::beast::error_code ec, size_t) {
+                    if (s->closed)
+                        return;
+                    if (ec) {
+                        s->shutdown();
+                        return;
+                    }
+                    s->queue.pop_front();
+                    s->write();
+                }));
+        }
+
+        // Drop the connection
+        void shutdown()
+        {
+            if (closed)
+                return;
+            closed = true;
+            queue.clear();
+
+            boost::system::error_code ec;
+            ws.next_layer().lowest_layer().close(ec);
+
+            if (on_close) {
+                auto h = handle();
+                on_close(h);
+            }
+            // Break reference cycles through user handlers
+            on_message = nullptr;
+            on_close = nullptr;
+        }
+
+    public:
+        basic_session(std::shared_ptr<void> o, Stream s)
+        : owner(std::move(o))
+        , ws(s)
+        , strand(static_cast<boost::asio::io_context&>(
+            boost::asio::query(ws.get_executor(),
+                boost::asio::execution::context)).get_executor())
+        { }
+
+        void accept(const request_message& req, open_handler on_open) override
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            ws.read_message_max(opt.max_message_size);
+            ws.async_accept(req, bind(
+                [s, on_open](boost::beast::error_code ec) {
+                    if (ec) {
+                        s->closed = true;
+                        return;
+                    }
+                    auto h = s->handle();
+                    on_open(h);
+                    s->read();
+                }));
+        }
+
+        void send(message_ptr msg, bool text) override
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            post([s, msg, text] {
+                if (s->closed || s->closing)
+                    return;
+                // Slow consumer
+                if (s->queue.size() >= s->opt.max_queue) {
+                    s->shutdown();
+                    return;
+                }
+                s->queue.emplace_back(msg, text);
+                if (s->queue.size() == 1)
+                    s->write();
+            });
+        }
+
+        void close() override
+        {
+            auto s = std::static_pointer_cast<basic_session>(shared_from_this());
+            post([s] {
+                if (s->closed || s->closing)
+                    return;
+                s->closing = true;
+                if (s->queue.empty())
+                    s->write();
+            });
+        }
+    };
+
+    // Set of connections receiving the same messages
+    struct websocket_group {
+    private:
+        struct impl {
+            std::mutex mtx;
+            std::vector<std::weak_ptr<websocket::session_base>> members;
+        };
+
+        std::shared_ptr<impl> self;
+
+    public:
+        websocket_group()
+        : self(std::make_shared<impl>())
+        { }
+
+        // Add connection to group. Closed connections are removed
+        // automatically.
+        void join(const websocket& ws) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            self->members.emplace_back(ws.self);
+        }
+
+        void leave(const websocket& ws) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            auto& m = self->members;
+            m.erase(std::remove_if(m.begin(), m.end(),
+                [&](const std::weak_ptr<websocket::session_base>& p) {
+                    auto sp = p.lock();
+                    return !sp || sp == ws.self;
+                }), m.end());
+        }
+
+        // Send message to all connections of the group. The message is
+        // shared, not copied, between connections. Return number of
+        // connections the message was queued to.
+        size_t broadcast(std::string msg, bool text = true) {
+            return broadcast(
+                std::make_shared<const std::string>(std::move(msg)), text);
+        }
+
+        size_t broadcast(const websocket::message_ptr& msg, bool text = true)
+        {
+            std::vector<std::shared_ptr<websocket::session_base>> targets;
+            {
+                std::lock_guard<std::mutex> lock(self->mtx);
+                auto& m = self->members;
+                targets.reserve(m.size());
+                // Collect live connections and drop closed ones
+                m.erase(std::remove_if(m.begin(), m.end(),
+                    [&](const std::weak_ptr<websocket::session_base>& p) {
+                        auto sp = p.lock();
+                        if (!sp)
+                            return true;
+                        targets.push_back(std::move(sp));
+                        return false;
+                    }), m.end());
+            }
+
+            for (auto& t : targets)
+                t->send(msg, text);
+            return targets.size();
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            return self->members.size();
+        }
+    };
+
+} // namespace rest
+
+// end of rest/websocket.hpp
+
+#include <boost/asio/steady_timer.hpp>
+#if defined(__linux__)
+#include <poll.h>
+#endif
+
+namespace rest {
+
+    // Connection requests are received on. Hides the type of stream
+    // (plain or TLS socket) from request and response.
+    struct session : std::enable_shared_from_this<session> {
+        using executor_type = tcp::socket::executor_type;
+        using handler = std::function<void(boost::beast::error_code)>;
+        using read_handler = std::function<void(boost::beast::error_code, size_t)>;
+
+        virtual ~session() { }
+
+        virtual executor_type get_executor() = 0;
+
+        // The underlying TCP socket, null if connection is not over TCP
+        virtual tcp::socket* socket() {
+            return nullptr;
+        }
+
+        virtual void async_read(
+            boost::beast::flat_buffer&, request_message&, handler) = 0;
+        virtual void async_read_some(boost::asio::mutable_buffer, read_handler) = 0;
+        virtual void async_write(response_message&, handler) = 0;
+        virtual void async_write(shared_response_message&, handler) = 0;
+        virtual void async_write(boost::asio::const_buffer, handler) = 0;
+
+        // Close connection gracefully when done writing
+        virtual void shutdown() = 0;
+
+        // Call function once if client closes the connection. Used while
+        // a request is processed and nothing is read from connection.
+        virtual void on_disconnect(std::function<void()>) { }
+
+        // Take over the connection for websocket protocol. Return null
+        // if not supported by transport.
+        virtual std::shared_ptr<websocket::session_base> upgrade() {
+            return { };
+        }
+    };
+
+    using session_ptr = std::shared_ptr<session>;
+
+    // Common part of sessions over a stream
+    template <class Stream>
+    struct stream_session : session {
+        using stream_type = Stream;
+
+        Stream stream;
+
+        template <class... Args>
+        stream_session(Args&&... args)
+        : stream(std::forward<Args>(args)...)
+        { }
+
+        executor_type get_executor() override {
+            return stream.get_executor();
+        }
+
+        void async_read(boost::beast::flat_buffer& buffer,
+            request_message& msg, handler h) override
+        {
+            http::async_read(stream, buffer, msg,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        void async_read_some(boost::asio::mutable_buffer buf, read_handler h) override {
+            stream.async_read_some(buf, h);
+        }
+
+        void async_write(response_message& msg, handler h) override {
+            http::async_write(stream, msg,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        void async_write(shared_response_message& msg, handler h) override {
+            http::async_write(stream, msg,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        void async_write(boost::asio::const_buffer buf, handler h) override {
+            boost::asio::async_write(stream, buf,
+                [h](boost::beast::error_code ec, size_t) { h(ec); });
+        }
+
+        std::shared_ptr<websocket::session_base> upgrade() override {
+            return std::make_shared<websocket::basic_session<Stream&>>(
+                shared_from_this(), stream);
+        }
+
+        void on_disconnect(std::function<void()> h) override
+        {
+            // Do not keep connection alive while waiting
+            std::weak_ptr<session> w = shared_from_this();
+            stream.lowest_layer().async_wait(boost::asio::socket_base::wait_read,
+                [w, h](boost::beast::error_code ec) {
+                    auto s = std::static_pointer_cast<stream_session>(w.lock());
+                    if (s && ec != boost::asio::error::operation_aborted)
+                        s->check_closed(h, ec, 0);
+                });
+        }
+
+    private:
+        // Called when socket is readable. Nothing to read means end of
+        // stream. Data may come right before it (ex. TLS close_notify),
+        // then the close is looked for a few more times. A close after
+        // pending data is only seen on Linux.
+        void check_closed(const std::function<void()>& h,
+            boost::beast::error_code ec, int attempt)
+        {
+            auto& sock = stream.lowest_layer();
+            if (ec || sock.available(ec) == 0 || ec) {
+                h();
+                return;
+            }
+#if defined(POLLRDHUP)
+            pollfd p = { sock.native_handle(), POLLRDHUP, 0 };
+            if (::poll(&p, 1, 0) == 1 &&
+                (p.revents & (POLLRDHUP | POLLHUP | POLLERR)))
+            {
+                h();
+                return;
+            }
+            if (attempt == 5)
+                return;
+
+            std::weak_ptr<session> w = shared_from_this();
+            auto t = std::make_shared<boost::asio::steady_timer>(
+                sock.get_executor(), std::chrono::milliseconds(10 << attempt));
+            t->async_wait([w, h, t, attempt](boost::beast::error_code) {
+                if (auto s = std::static_pointer_cast<stream_session>(w.lock()))
+                    s->check_closed(h, { }, attempt + 1);
+            });
+#else
+            (void)attempt;
+#endif
+        }
+    };
+
+    // Session over a plain TCP socket
+    struct tcp_session : stream_session<tcp::socket> {
+        tcp_session(tcp::socket&& s)
+        : stream_session(std::move(s))
+        { }
+
+        tcp::socket* socket() override {
+            return &stream;
+        }
+
+        void shutdown() override {
+            boost::system::error_code ec;
+            stream.shutdown(tcp::socket::shutdown_send, ec);
+        }
+    };
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+    // Session over a Unix domain socket
+    struct unix_session : stream_session<local::stream_protocol::socket> {
+        unix_session(local::stream_protocol::socket&& s)
+        : stream_session(std::move(s))
+        { }
+
+        void shutdown() override {
+            boost::system::error_code ec;
+            stream.shutdown(local::stream_protocol::socket::shutdown_send, ec);
+        }
+    };
+#endif
+
+} // namespace rest
+
+// end of rest/session.hpp
+
+#if BOOST_VERSION >= 107700
+#include <boost/asio/cancellation_signal.hpp>
+#endif
+
+namespace rest {
+
+    struct server;
+
+    struct request {
+    private:
+        using socket_ptr = std::shared_ptr<tcp::socket>;
+
+        struct impl {
+            impl(const session_ptr& s) noexcept
+            : conn(s)
+            { }
+
+            session_ptr conn;
+            request_message req;
+            boost::beast::flat_buffer buffer { 8192 };
+
+            const server* app = nullptr;
+            name_value_map params;
+            // Param handlers called for this request
+            std::vector<const void*> param_handlers;
+            // Route tables the names of params point into
+            std::vector<std::shared_ptr<const void>> pinned;
+            boost::string_view base_url;
+            boost::string_view path;
+
+            // Body copied into one piece, if received in several
+            std::string body;
+            // Set by body parsers
+            json_value json;
+            name_value_map form;
+
+            rest::locals locals;
+
+            // Client disconnected while request was in progress
+            std::atomic<bool> cancelled { false };
+            std::mutex mtx;
+            std::vector<std::function<void()>> on_cancel;
+#if BOOST_VERSION >= 107700
+            boost::asio::cancellation_signal signal;
+#endif
+
+            void cancel()
+            {
+                std::vector<std::function<void()>> handlers;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (cancelled)
+                        return;
+                    cancelled = true;
+                    handlers.swap(on_cancel);
+                }
+                for (auto& h : handlers)
+                    h();
+#if BOOST_VERSION >= 107700
+                signal.emit(boost::asio::cancellation_type::terminal);
+#endif
+            }
+        };
+
+        std::shared_ptr<impl> self;
+
+    public:
+        request(const session_ptr& s)
+        : self(std::make_shared<impl>(s))
+        { }
+
+        // Asynchronous receive of request
+        template <class C>
+        static void receive(const session_ptr& conn, C&& cb) {
+            request req(conn);
+            conn->async_read(req.self->buffer, req.self->req,
+                [req, cb](boost::beast::error_code err) mutable
+            {
+                if (!err) cb(req);
+            });
+        }
+
+        // Connection the request was received on
+        const session_ptr& connection() const noexcept {
+            return self->conn;
+        }
+
+        // The underlying TCP socket of connection, null if connection
+        // is not over TCP (Unix domain socket)
+        socket_ptr socket() const noexcept {
+            auto sock = self->conn->socket();
+            return sock ? socket_ptr(self->conn, sock) : socket_ptr();
+        }
+
+        // Watch connection for client disconnect while the request is
+        // processed, see cancelled()
+        void watch() const {
+            std::weak_ptr<impl> w = self;
+            self->conn->on_disconnect([w] {
+                if (auto s = w.lock())
+                    s->cancel();
+            });
+        }
+
+        // True if client disconnected before the request completed.
+        // May be polled from any thread, ex. by offloaded work.
+        bool cancelled() const noexcept {
+            return self->cancelled;
+        }
+
+        // Function called once when client disconnects, on connection
+        // executor. Called right away if client is already gone.
+        void on_cancel(std::function<void()> handler) const
+        {
+            {
+                std::lock_guard<std::mutex> lock(self->mtx);
+                if (!self->cancelled) {
+                    self->on_cancel.emplace_back(std::move(handler));
+                    return;
+                }
+            }
+            handler();
+        }
+
+#if BOOST_VERSION >= 107700
+        // Slot emitting terminal cancellation when client disconnects.
+        // Bind to asynchronous operations running on connection executor.
+        boost::asio::cancellation_slot cancellation_slot() const noexcept {
+            return self->signal.slot();
+        }
+#endif
+
+        // Root route (server generated this request)
+        const server& app() const noexcept {
+            return *self->app;
+        }
+        void app(const server* val) noexcept {
+            self->app = val;
+        }
+
+        // The url path on which a router instance was mounted
+        const boost::string_view& base_url() const noexcept {
+            return self->base_url;
+        }
+        void base_url(const boost::string_view& val) noexcept {
+            self->base_url = val;
+        }
+
+        // The remaining path part of the router mount point
+        const boost::string_view& path() const noexcept {
+            return self->path;
+        }
+        void path(const boost::string_view& val) noexcept {
+            self->path = val;
+        }
+
+        // Named route parameters
+        //name_value_map& params() const noexcept {
+        name_value_map& params() const noexcept {
+            return self->params;
+        }
+
+        // Values attached to request by middlewares, see rest::locals
+        rest::locals& locals() const noexcept {
+            return self->locals;
+        }
+
+        // Request body parsed by rest::json middleware, missing value
+        // if not parsed
+        json_value& json() const noexcept {
+            return self->json;
+        }
+
+        // Fields of request body parsed by rest::urlencoded middleware
+        name_value_map& form() const noexcept {
+            return self->form;
+        }
+
+        // Keep object alive as long as the request, ex. route table
+        // names of params() point into
+        void pin(std::shared_ptr<const void> p) const
+        {
+            auto& v = self->pinned;
+            if (std::find(v.begin(), v.end(), p) == v.end())
+                v.push_back(std::move(p));
+        }
+
+        // Mark param handler as called. Return false if it already was
+        // in this request-response cycle.
+        bool param_called(const void* handler) const {
+            auto& v = self->param_handlers;
+            if (std::find(v.begin(), v.end(), handler) != v.end())
+                return false;
+            v.push_back(handler);
+            return true;
+        }
+
+        // Contains a string corresponding to the HTTP method
+        // of the request: GET, POST, PUT, and so on
+        boost::string_view method_string() const noexcept {
+            return self->req.method_string();
+        }
+
+        // HTTP method of the request as a boost::beast::http::verb enum
+        http::verb method() const noexcept {
+            return self->req.method();
+        }
+
+        // The original request url
+        boost::string_view original_url() const noexcept {
+            return self->req.target();
+        }
+
+        // The underlying HTTP message
+        const request_message& message() const noexcept {
+            return self->req;
+        }
+
+        // Request body as one contiguous buffer. Body received in one
+        // piece is referred to in place unless copy is requested,
+        // otherwise it is copied once. The copy is null terminated.
+        boost::asio::mutable_buffer body(bool copy_body = false) const
+        {
+            auto& copy = self->body;
+            if (copy.empty()) {
+                auto data = self->req.body().data();
+                auto first = boost::asio::buffer_sequence_begin(data);
+                auto last = boost::asio::buffer_sequence_end(data);
+                if (first == last)
+                    return { };
+                if (std::next(first) == last && !copy_body)
+                    return *first;
+
+                copy.resize(boost::asio::buffer_size(data));
+                boost::asio::buffer_copy(boost::asio::buffer(&copy[0], copy.size()), data);
+            }
+            return boost::asio::buffer(&copy[0], copy.size());
+        }
+
+        // True if media type of Content-Type header matches type,
+        // ignoring case and parameters (ex. charset)
+        bool is(boost::string_view type) const noexcept
+        {
+            auto value = get(http::field::content_type);
+            if (!value)
+                return false;
+            auto mt = value->substr(0, value->find(';'));
+            while (!mt.empty() && (mt.back() == ' ' || mt.back() == '\t'))
+                mt.remove_suffix(1);
+            return boost::beast::iequals(mt, type);
+        }
+
+        // Data received after the request, belongs to the protocol
+        // the connection is switched to
+        boost::asio::const_buffer unread() const noexcept {
+            return self->buffer.data();
+        }
+
+        // Get header by name. T is a case-insensitive matching field
+        // name or a rest::http::field value.
+        template <class T>
+        boost::optional<boost::string_view> get(T name) const noexcept {
+            auto it = self->req.find(name);
+            if (it != self->req.end())
+                return it->value();
+            return { };
+        }
+    };
+
+} // namespace rest
+
+// end of rest/request.hpp
+
+// beginning of rest/response.hpp
+
+// beginning of rest/event_stream.hpp
+
+#include <boost/asio/dispatch.hpp>
+#include <chrono>
+
+namespace rest {
+
+    struct event_stream_options {
+        // Interval of comment lines sent to keep the connection open
+        // through proxies and to detect closed connections. Zero
+        // disables heartbeats.
+        std::chrono::steady_clock::duration heartbeat = std::chrono::seconds(15);
+
+        // Maximum number of events queued for sending to a client.
+        // A client not keeping up is disconnected when its queue is full.
+        size_t max_queue = 64;
+    };
+
+    // Open text/event-stream response (Server-Sent Events). Copies refer
+    // to the same stream.
+    struct event_stream {
+        using message_ptr = std::shared_ptr<const std::string>;
+        using close_handler = std::function<void(event_stream&)>;
+
+        struct impl;
+
+    private:
+        std::shared_ptr<impl> self;
+
+        friend struct event_stream_group;
+
+    public:
+        event_stream(std::shared_ptr<impl> s) noexcept
+        : self(std::move(s))
+        { }
+
+        // Start stream on connection. Header is the serialized response
+        // header.
+        static event_stream start(const session_ptr&, std::string header,
+            const event_stream_options& = { });
+
+        // Format event once to be sent to any number of streams
+        static message_ptr format(boost::string_view data,
+            boost::string_view event = { }, boost::string_view id = { })
+        {
+            std::string msg;
+            msg.reserve(data.size() + event.size() + id.size() + 32);
+            if (!event.empty())
+                msg.append("event: ").append(event.data(), event.size()).append("\n");
+            if (!id.empty())
+                msg.append("id: ").append(id.data(), id.size()).append("\n");
+
+            // Every line of data is a separate field
+            for (;;) {
+                size_t n = data.find('\n');
+                msg.append("data: ").append(data.data(), std::min(n, data.size()));
+                msg.append("\n");
+                if (n == boost::string_view::npos)
+                    break;
+                data.remove_prefix(n + 1);
+            }
+            msg.append("\n");
+            return std::make_shared<const std::string>(std::move(msg));
+        }
+
+        // Queue event for sending. May be called from any thread.
+        void send(boost::string_view data,
+            boost::string_view event = { }, boost::string_view id = { })
+        {
+            send(format(data, event, id));
+        }
+        void send(message_ptr msg);
+
+        // Function called when connection is closed
+        void on_close(close_handler handler);
+
+        // End the response when queued events are sent
+        void close();
+
+        bool operator==(const event_stream& other) const noexcept {
+            return self == other.self;
+        }
+    };
+
+    struct event_stream::impl : std::enable_shared_from_this<impl> {
+        using strand_type =
+            boost::asio::strand<boost::asio::io_context::executor_type>;
+
+        session_ptr conn;
+        strand_type strand;
+        boost::asio::steady_timer timer;
+        event_stream_options opt;
+        close_handler on_close;
+
+        std::deque<message_ptr> queue;
+        bool closing = false;
+        bool closed = false;
+
+        // Stream owns itself until shutdown, groups hold only weak
+        // references and there may be no write or heartbeat pending
+        std::shared_ptr<impl> keep;
+
+        impl(const session_ptr& c, const event_stream_options& o)
+        : conn(c)
+        , strand(static_cast<boost::asio::io_context&>(
+            boost::asio::query(c->get_executor(),
+                boost::asio::execution::context)).get_executor())
+        , timer(c->get_executor())
+        , opt(o)
+        { }
+
+        template <class F>
+        void post(F&& f) {
+            boost::asio::post(strand, std::forward<F>(f));
+        }
+
+        void push(message_ptr msg)
+        {
+            if (closed || closing)
+                return;
+            // Slow consumer
+            if (queue.size() >= opt.max_queue) {
+                shutdown();
+                return;
+            }
+            queue.push_back(std::move(msg));
+            if (queue.size() == 1)
+                write();
+        }
+
+        void write()
+        {
+            if (queue.empty()) {
+                if (closing)
+                    shutdown();
+                return;
+            }
+            auto s = shared_from_this();
+            // Message is kept alive by the handler, queue is cleared
+            // on shutdown while it is written
+            auto msg = queue.front();
+            conn->async_write(boost::asio::buffer(*msg),
+                [s, msg](boost::beast::error_code ec) {
+                    boost::asio::dispatch(s->strand, [s, ec] {
+                        if (s->closed)
+                            return;
+                        if (ec) {
+                            s->shutdown();
+                            return;
+                        }
+                        s->queue.pop_front();
+                        s->write();
+                    });
+                });
+        }
+
+        void heartbeat()
+        {
+            if (opt.heartbeat == std::chrono::steady_clock::duration::zero())
+                return;
+
+            auto s = shared_from_this();
+            timer.expires_after(opt.heartbeat);
+            timer.async_wait(boost::asio::bind_executor(strand,
+                [s](boost::beast::error_code ec) {
+                    if (ec || s->closed)
+                        return;
+                    static const auto ping =
+                        std::make_shared<const std::string>(":\n\n");
+                    // Nothing to add if events are still queued
+                    if (s->queue.empty())
+                        s->push(ping);
+                    s->heartbeat();
+                }));
+        }
+
+        void shutdown()
+        {
+            if (closed)
+                return;
+            closed = true;
+            queue.clear();
+            timer.cancel();
+            conn->shutdown();
+
+            if (on_close) {
+                event_stream h(shared_from_this());
+                on_close(h);
+            }
+            // Break reference cycles through user handler
+            on_close = nullptr;
+            keep.reset();
+        }
+    };
+
+    inline event_stream event_stream::start(const session_ptr& conn,
+        std::string header, const event_stream_options& options)
+    {
+        auto s = std::make_shared<impl>(conn, options);
+        s->keep = s;
+        auto head = std::make_shared<const std::string>(std::move(header));
+        s->post([s, head] {
+            s->push(head);
+            s->heartbeat();
+        });
+
+        // Without heartbeats a closed connection is only noticed here
+        std::weak_ptr<impl> w = s;
+        conn->on_disconnect([w] {
+            if (auto sp = w.lock())
+                sp->post([sp] { sp->shutdown(); });
+        });
+        return { s };
+    }
+
+    inline void event_stream::send(message_ptr msg) {
+        auto s = self;
+        self->post([s, msg] { s->push(msg); });
+    }
+
+    inline void event_stream::on_close(close_handler handler) {
+        auto s = self;
+        self->post([s, handler] {
+            if (s->closed) {
+                event_stream h(s);
+                handler(h);
+            }
+            else
+                s->on_close = handler;
+        });
+    }
+
+    inline void event_stream::close() {
+        auto s = self;
+        self->post([s] {
+            if (s->closed || s->closing)
+                return;
+            s->closing = true;
+            if (s->queue.empty())
+                s->shutdown();
+        });
+    }
+
+    // Set of event streams receiving the same events
+    struct event_stream_group {
+    private:
+        struct impl {
+            std::mutex mtx;
+            std::vector<std::weak_ptr<event_stream::impl>> members;
+        };
+
+        std::shared_ptr<impl> self;
+
+    public:
+        event_stream_group()
+        : self(std::make_shared<impl>())
+        { }
+
+        // Add stream to group. Closed streams are removed automatically.
+        void join(const event_stream& es) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            self->members.emplace_back(es.self);
+        }
+
+        void leave(const event_stream& es) {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            auto& m = self->members;
+            m.erase(std::remove_if(m.begin(), m.end(),
+                [&](const std::weak_ptr<event_stream::impl>& p) {
+                    auto sp = p.lock();
+                    return !sp || sp == es.self;
+                }), m.end());
+        }
+
+        // Send event to all streams of the group. The event is formatted
+        // once and shared between streams. Return number of streams the
+        // event was queued to.
+        size_t broadcast(boost::string_view data,
+            boost::string_view event = { }, boost::string_view id = { })
+        {
+            return broadcast(event_stream::format(data, event, id));
+        }
+
+        size_t broadcast(const event_stream::message_ptr& msg)
+        {
+            std::vector<std::shared_ptr<event_stream::impl>> targets;
+            {
+                std::lock_guard<std::mutex> lock(self->mtx);
+                auto& m = self->members;
+                targets.reserve(m.size());
+                // Collect open streams and drop closed ones
+                m.erase(std::remove_if(m.begin(), m.end(),
+                    [&](const std::weak_ptr<event_stream::impl>& p) {
+                        auto sp = p.lock();
+                        if (!sp)
+                            return true;
+                        targets.push_back(std::move(sp));
+                        return false;
+                    }), m.end());
+            }
+
+            for (auto& t : targets)
+                event_stream(t).send(msg);
+            return targets.size();
+        }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(self->mtx);
+            return self->members.size();
+        }
+    };
+
+} // namespace rest
+
+// end of rest/event_stream.hpp
+
+#include <sstream>
+
+namespace rest {
+
+    struct response {
+        using message_type = response_message;
+        using send_hook = std::function<void(const message_type&)>;
+
+    private:
+        struct impl {
+            impl(const request& r) noexcept
+            : req(r)
+            { }
+
+            request req;
+            message_type resp;
+            bool is_sent = false;
+            std::vector<send_hook> on_send;
+        };
+
+        std::shared_ptr<impl> self;
+
+    public:
+        response(const request& req)
+        : self(std::make_shared<impl>(req))
+        { }
+
+        // Set a header field value, removing any other instances of that field.
+        // T is a case-insensitive matching field name or a rest::http::field value.
+        template <class T>
+        void set(T name, boost::string_view value) {
+            self->resp.set(name, value);
+        }
+
+        // Other values are formatted by operator<<, ex. numbers
+        template <class T, class V>
+        typename std::enable_if<
+            !std::is_convertible<const V&, boost::string_view>::value>::type
+        set(T name, const V& value) {
+            std::ostringstream os;
+            os << value;
+            self->resp.set(name, os.str());
+        }
+
+        // Sets the HTTP status for the response
+        response& status(unsigned code) {
+            self->resp.result(code);
+            return *this;
+        }
+
+        // Gets the HTTP status for the response
+        unsigned status() const noexcept {
+            return self->resp.result_int();
+        }
+
+        // Send file content. Return false, and send nothing, if the
+        // file can not be opened.
+        bool send_file(const fs::path& fname) {
+            std::ifstream f(fname.native(), std::ios::binary);
+            if (!f.is_open())
+                return false;
+            send(f.rdbuf());
+            return true;
+        }
+
+        // Sends the HTTP response with a body formatted by operator<<
+        template <class T>
+        typename std::enable_if<!boost::asio::is_const_buffer_sequence<T>::value>::type
+        send(const T& body) {
+            boost::beast::ostream(self->resp.body()) << body;
+            set(http::field::content_length, self->resp.body().size());
+            send();
+        }
+
+        // Sends the HTTP response with a body of bytes as is
+        template <class ConstBufferSequence>
+        typename std::enable_if<boost::asio::is_const_buffer_sequence<ConstBufferSequence>::value>::type
+        send(const ConstBufferSequence& buffers) {
+            auto& body = self->resp.body();
+            body.commit(boost::asio::buffer_copy(
+                body.prepare(boost::asio::buffer_size(buffers)), buffers));
+            set(http::field::content_length, body.size());
+            send();
+        }
+
+        void send(const boost::string_view& body) {
+            send(boost::asio::const_buffer(body.data(), body.size()));
+        }
+        void send(const std::string& body) {
+            send(boost::asio::const_buffer(body.data(), body.size()));
+        }
+        void send(const char* body) {
+            send(boost::string_view(body));
+        }
+
+        // Sends JSON response written by function f(json_writer&).
+        // Content-Type is set to application/json unless already set.
+        template <class F>
+        void json(F&& f)
+        {
+            {
+                json_writer w(self->resp.body());
+                f(w);
+            }
+            if (self->resp.find(http::field::content_type) == self->resp.end())
+                set(http::field::content_type, "application/json");
+            set(http::field::content_length, self->resp.body().size());
+            send();
+        }
+
+        // Sends the HTTP response with a shared body. The bytes are written
+        // to the connection as is, the same buffer may be sent by any
+        // number of responses at once. Send hooks are not called since
+        // the message has no dynamic body.
+        void send(const shared_buffer& body)
+        {
+            auto& resp = self->resp;
+            resp.keep_alive(false);
+            auto msg = std::make_shared<shared_response_message>(
+                std::move(resp.base()), body);
+            msg->content_length(body.size());
+
+            auto& conn = self->req.connection();
+            boost::asio::dispatch(conn->get_executor(), [msg, conn] {
+                conn->async_write(*msg,
+                    [msg, conn](boost::beast::error_code) {
+                        conn->shutdown();
+                    });
+            });
+
+            self->is_sent = true;
+        }
+        template <class S>
+        void send(std::shared_ptr<S> body) {
+            send(shared_buffer(std::shared_ptr<const std::string>(std::move(body))));
+        }
+
+        // Sends the HTTP response. Correspond to end() method in nodejs express.
+        void send() {
+            self->resp.keep_alive(false);
+
+            for (auto& hook : self->on_send)
+                hook(self->resp);
+
+            // Write on connection executor, response may be sent from
+            // another thread
+            auto scopy = self;
+            auto& conn = self->req.connection();
+            boost::asio::dispatch(conn->get_executor(), [scopy, conn] {
+                conn->async_write(scopy->resp,
+                    [scopy, conn](boost::beast::error_code) {
+                        conn->shutdown();
+                    });
+            });
+
+            self->is_sent = true;
+        }
+
+        // Sends already serialized HTTP response, i.e. status line,
+        // headers and body
+        void send_raw(std::shared_ptr<const std::string> data) {
+            auto& conn = self->req.connection();
+            boost::asio::dispatch(conn->get_executor(), [conn, data] {
+                conn->async_write(boost::asio::buffer(*data),
+                    [conn, data](boost::beast::error_code) {
+                        conn->shutdown();
+                    });
+            });
+
+            self->is_sent = true;
+        }
+
+        // Send header of text/event-stream response and keep the connection
+        // open for events. Headers set so far are included. Send hooks are
+        // not called since the body is not known.
+        rest::event_stream event_stream(const event_stream_options& options = { })
+        {
+            auto& resp = self->resp;
+            resp.set(http::field::content_type, "text/event-stream");
+            resp.set(http::field::cache_control, "no-cache");
+            // Body ends when connection is closed
+            resp.keep_alive(false);
+
+            std::ostringstream os;
+            os << resp.base();
+
+            self->is_sent = true;
+            return rest::event_stream::start(
+                self->req.connection(), os.str(), options);
+        }
+
+        // Function called with the message right before it is sent
+        void on_send(send_hook hook) {
+            self->on_send.emplace_back(std::move(hook));
+        }
+
+        // Return true if response queing to be sent or is already sent
+        bool is_sent() const noexcept {
+            return self->is_sent;
+        }
+
+        // Sets the response Location HTTP header to the specified path
+        // parameter. Currently supports absolute path only.
+        void location(const boost::string_view& path) {
+            set(http::field::location, path);
+        }
+
+        // Redirects to the URL derived from the specified path. If not
+        // specified, status defaults to "302 Found".
+        void redirect(unsigned code, const boost::string_view& path) {
+            location(path);
+            status(code).send();
+        }
+        void redirect(const boost::string_view& path) {
+            redirect(302, path);
+        }
+    };
+
+} // namespace rest
+
+// end of rest/response.hpp
+
+// beginning of rest/path.hpp
+
+#include <regex>
+
+namespace rest {
+
+    struct path {
+    private:
+        std::string regex;
+        std::vector<std::pair<size_t, std::string>> params;
+
+    public:
+        path(const boost::string_view& uri) noexcept
+        {
+            size_t distance = 0;
+            std::string name;
+
+            for (auto it = uri.begin(); it != uri.end();) {
+                regex.push_back(*it);
+                if (*it++ != '/')
+                    continue;
+
+                ++distance;
+                if (it != uri.end() && *it == ':') {
+                    // Replace parameter with \w+
+                    regex.append("\\w+", 3);
+                    while (++it != uri.end() && *it != '/')
+                        name.push_back(*it);
+                    // Store parameter
+                    params.emplace_back(distance, std::move(name));
+                    distance = 0;
+                }
+            }
+        }
+
+        bool match(const boost::string_view& uri, std::cmatch& cm) const
+        {
+            std::regex rx(regex);
+            if (!std::regex_search(uri.begin(), uri.end(), cm, rx))
+                return false;
+            // Match must occur at the beginning
+            return (cm.position(0) == 0);
+        }
+
+        // Number of named parameters
+        size_t param_count() const noexcept {
+            return params.size();
+        }
+
+        const std::string& param_name(size_t i) const noexcept {
+            return params[i].second;
+        }
+
+        // Values of parameters in matched uri, in order of appearance
+        void get_values(const boost::string_view& uri,
+            std::vector<boost::string_view>& values) const
+        {
+            values.clear();
+            size_t start = 1;
+
+            for (auto& p : params) {
+                // Find value by counting '/' in current uri
+                for (auto dist = p.first; dist > 1; --dist)
+                    start = uri.find('/', start) + 1;
+                size_t stop = start;
+                for (; stop < uri.size() && uri[stop] != '/'; ++stop);
+
+                values.emplace_back(&uri[start], stop - start);
+                start = stop + 1;
+            }
+        }
+
+        name_value_map get_params(const boost::string_view& uri) const
+        {
+            std::vector<boost::string_view> values;
+            get_values(uri, values);
+
+            name_value_map pm;
+            for (size_t i = 0; i < values.size(); ++i)
+                pm.emplace(params[i].second.c_str(), values[i]);
+            return pm;
+        }
+    };
+
+} // namespace rest
+
+// end of rest/path.hpp
+
+// beginning of rest/next.hpp
+
+// beginning of rest/error.hpp
+
+#include <boost/system/error_code.hpp>
+
+namespace rest {
+
+    // Error passed to error handlers. An error code or HTTP status is
+    // stored as is, its message is formatted only if what() is called.
+    struct error {
+    private:
+        boost::system::error_code ec;
+        http::status st = http::status::unknown;
+        // Message given or formatted on demand
+        mutable std::string msg;
+
+    public:
+        error() noexcept = default;
+
+        error(const char* s) noexcept
+        : msg(s)
+        { }
+
+        error(std::string s) noexcept
+        : msg(std::move(s))
+        { }
+
+        error(const std::exception& ex) noexcept
+        : msg(ex.what())
+        { }
+
+        error(const boost::system::error_code& ec) noexcept
+        : ec(ec)
+        { }
+
+        // Error responded with status if no error handler sends
+        // a response
+        error(http::status status) noexcept
+        : st(status)
+        { }
+
+        error(http::status status, std::string s) noexcept
+        : st(status)
+        , msg(std::move(s))
+        { }
+
+        operator bool() const noexcept {
+            return ec || st != http::status::unknown || !msg.empty();
+        }
+
+        const boost::system::error_code& code() const noexcept {
+            return ec;
+        }
+
+        // HTTP status of error, http::status::unknown if not set
+        http::status status() const noexcept {
+            return st;
+        }
+
+        const std::string& what() const {
+            if (msg.empty()) {
+                if (ec)
+                    msg = ec.message();
+                else if (st != http::status::unknown)
+                    msg = http::obsolete_reason(st).to_string();
+            }
+            return msg;
+        }
+    };
+
+} // namespace rest
+
+// end of rest/error.hpp
+
+namespace rest {
+
+    struct next {
+        // Chain of handlers (one per router) that next continues. The
+        // chain is resumed if next is called after handler returned.
+        struct frame {
+            virtual ~frame() { }
+            virtual void resume() = 0;
+
+            bool running = false;
+            bool proceed = false;
+        };
+
+    private:
+        struct impl {
+            error err;
+            // Not owned, frames own their next
+            std::weak_ptr<frame> current;
+        };
+
+        std::shared_ptr<impl> self;
+        // Frame invoking the handler when this copy was made, a copy
+        // kept for a later call keeps the chain alive
+        std::shared_ptr<frame> hold;
+
+        // Frame used when handler is invoked without a chain to resume
+        struct sync_frame : frame {
+            void resume() override { }
+        };
+
+        static void proceed(const std::shared_ptr<frame>& f) noexcept {
+            if (!f || f->proceed)
+                return;
+            f->proceed = true;
+            // Handler already returned, continue the chain from here
+            if (!f->running)
+                f->resume();
+        }
+
+    public:
+        next()
+        : self(std::make_shared<impl>())
+        { }
+
+        next(const next& other) noexcept
+        : self(other.self)
+        , hold(other.self->current.lock())
+        { }
+
+        next& operator=(const next& other) noexcept {
+            self = other.self;
+            hold = other.self->current.lock();
+            return *this;
+        }
+
+        // Pass control to the next handler. May be called after handler
+        // returned (from a completion handler of asynchronous operation),
+        // in this case keep a copy of next rather than a reference.
+        void operator()() noexcept {
+            proceed(self->current.lock());
+        }
+        void operator()(error&& err) noexcept {
+            self->err = std::move(err);
+            proceed(self->current.lock());
+        }
+
+        // Invoke handler in frame f. Return true if handler called next
+        // before returning, otherwise f will be resumed on later call
+        // to next.
+        template <class F>
+        bool safe_invoke(F&& fn, const std::shared_ptr<frame>& f) noexcept {
+            f->running = true;
+            f->proceed = false;
+            self->current = f;
+
+            try {
+                std::forward<F>(fn)();
+            }
+            catch (const std::exception& ex) { self->err = ex; proceed(f); }
+            catch (const boost::system::error_code& ec) { self->err = ec; proceed(f); }
+            catch (...) { self->err = "unknown error"; proceed(f); }
+
+            f->running = false;
+            return f->proceed;
+        }
+
+        template <class F>
+        bool safe_invoke(F&& fn) noexcept {
+            return safe_invoke(
+                std::forward<F>(fn), std::make_shared<sync_frame>());
+        }
+
+        // Return function calling next on behalf of the handler being
+        // currently invoked. Used to pass control back from a nested chain.
+        std::function<void()> continuation() const {
+            auto s = self;
+            auto f = self->current.lock();
+            return [s, f] {
+                s->current = f;
+                proceed(f);
+            };
+        }
+
+        const error& err() const noexcept {
+            return self->err;
+        }
+    };
+
+} // namespace rest
+
+// end of rest/next.hpp
+
+#include <boost/variant.hpp>
+#include <array>
+#include <bitset>
+
+namespace rest {
+
+    template <class... Args>
+    using callback = std::function<void(Args...)>;
+
+    struct router;
+    struct route;
+
+    using req_resp = callback<const request&, response&>;
+    using req_resp_next = callback<const request&, response&, next&>;
+
+    using param_handler = callback<const request&, response&, next&, const boost::string_view&>;
+    using error_handler = callback<const error&, const request&, response&, next&>;
+    using route_handler = boost::variant<req_resp, req_resp_next, router>;
+
+    enum class route_type {
+        use,
+        method,
+        all
+    };
+
+    struct router {
+    private:
+        struct visitor : boost::static_visitor<> {
+        private:
+            request& req;
+            response& resp;
             next& n;
 
-        public:
-            visitor(request& req, response& resp, next& n) noexcept
-            : req(req), resp(resp), n(n)
-            { }
+        public:
+            visitor(request& req, response& resp, next& n) noexcept
+            : req(req), resp(resp), n(n)
+            { }
+
+            void operator()(const req_resp& cb) const {
+                cb(req, resp);
+            }
+            void operator()(const req_resp_next& cb) const {
+                cb(req, resp, n);
+            }
+            void operator()(const router& r) const {
+                // Continue with parent routes if nothing in router
+                // completed the request
+                r.handle_request(req, resp, n, n.continuation());
+            }
+        };
+
+        // Number of http::verb values, used to index per-method route tables
+        static constexpr size_t verb_count =
+            static_cast<size_t>(http::verb::unlink) + 1;
+
+        using verb_set = std::bitset<verb_count>;
+
+        // Paths of method routes with the methods routed for them
+        struct allowed_methods {
+            std::string pattern;
+            path uri;
+            verb_set verbs;
+        };
+
+        struct impl {
+            std::vector<route> routes;
+            // Indexes of routes to visit (in order) for each method
+            std::array<std::vector<size_t>, verb_count> by_method;
+            std::vector<allowed_methods> allowed;
+            std::vector<error_handler> errors;
+            std::map<std::string, param_handler> params;
+        };
+
+        // Progress of request through routes of this router
+        struct dispatch;
+
+        // Route table. Published atomically so that it can be replaced
+        // while requests are served. Shared by copies of router, a copy
+        // mounted by use() sees replacements too.
+        struct shared_table {
+            std::shared_ptr<impl> current;
+        };
+
+        std::shared_ptr<shared_table> self;
+
+        // Snapshot of route table, kept by request until it is done
+        std::shared_ptr<impl> table() const noexcept {
+            return std::atomic_load(&self->current);
+        }
+
+        // Route table being set up, routes are added before serving
+        impl& edit() const noexcept {
+            return *self->current;
+        }
+
+        void add_route(route_type, route_handler&&,
+            boost::string_view = "/", http::verb = http::verb::unknown);
+
+        // Bind parameters of route to param handlers of this router
+        void resolve_params(route&) const;
+
+    protected:
+        // Pass request through routes. Function done is called if no
+        // route completed the request, i.e. the last matched handler
+        // called next or nothing matched at all.
+        void handle_request(request&, response&, next&, std::function<void()> done) const;
+
+        // Return Allow header value if path of request matches any method
+        // route of this router, otherwise empty string
+        std::string allowed(const request&) const;
+        void allowed(boost::string_view path, verb_set& verbs) const;
+
+    public:
+        router()
+        : self(std::make_shared<shared_table>())
+        {
+            self->current = std::make_shared<impl>();
+        }
+
+        virtual ~router() { }
+
+        // Error handler called on next(error) or in case of exception
+        void use(error_handler&& handler) noexcept {
+            edit().errors.emplace_back(std::forward<error_handler>(handler));
+        }
+
+        // Matches all HTTP methods and any path
+        void use(route_handler&& handler) noexcept {
+            add_route(route_type::use, std::forward<route_handler>(handler));
+        }
+
+        // Matches all HTTP methods on specified mount (leading) path
+        void use(boost::string_view path, route_handler&& handler) noexcept {
+            add_route(route_type::use,
+                std::forward<route_handler>(handler), path);
+        }
+
+        // Matches all HTTP methods (verbs). Same as 'use' but matches path exactly.
+        void all(boost::string_view path, route_handler&& handler) noexcept {
+            add_route(route_type::all,
+                std::forward<route_handler>(handler), path);
+        }
+
+        // Matches HTTP GET
+        void get(boost::string_view path, route_handler&& handler) noexcept {
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::get);
+        }
+
+        // Matches HTTP PUT
+        void put(boost::string_view path, route_handler&& handler) noexcept {
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::put);
+        }
+
+        // Matches HTTP POST
+        void post(boost::string_view path, route_handler&& handler) noexcept {
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::post);
+        }
+
+        // Matches HTTP DELETE
+        void del(boost::string_view path, route_handler&& handler) noexcept {
+            add_route(route_type::method,
+                std::forward<route_handler>(handler), path, http::verb::delete_);
+        }
+
+        // Matches websocket upgrade request (HTTP GET). Handler is called
+        // when connection is established. Other requests to the path are
+        // answered with 426 Upgrade Required.
+        void ws(boost::string_view path, websocket::open_handler handler,
+            websocket_options options = { }) noexcept
+        {
+            get(path, req_resp_next([handler, options](
+                const request& req, response& resp, next&)
+            {
+                if (!boost::beast::websocket::is_upgrade(req.message())) {
+                    resp.set(http::field::upgrade, "websocket");
+                    resp.status(426).send();
+                    return;
+                }
+                auto ws = req.connection()->upgrade();
+                if (!ws) {
+                    resp.status(501).send();
+                    return;
+                }
+                ws->opt = options;
+                ws->accept(req.message(), handler);
+            }));
+        }
+
+        // Replace routes, error and parameter handlers with those of
+        // other router. Requests in progress finish with the old routes,
+        // new requests see the new ones. Safe to call while serving, but
+        // the other router must not be modified after that.
+        void replace(const router& other) noexcept {
+            std::atomic_store(&self->current, other.table());
+        }
+
+        // Parameteter handler called whenever triggered path contains
+        // matched named parameter
+        void param(std::string name, param_handler&& handler) noexcept {
+            auto& t = edit();
+            t.params.emplace(
+                std::move(name), std::forward<param_handler>(handler));
+            for (auto& r : t.routes)
+                resolve_params(r);
+        }
+    };
+
+    struct route
+    {
+        route_type type;
+        http::verb method; // used only for route_type::method
+        path uri;
+        route_handler handler;
+        // Param handler for each parameter of uri, null if none
+        std::vector<const param_handler*> params;
+
+        route(route_type rt, route_handler&& rh,
+            boost::string_view u = "/", http::verb mtd = http::verb::unknown) noexcept
+        : type(rt)
+        , method(mtd)
+        , uri(u)
+        , handler(std::forward<route_handler>(rh))
+        { }
+
+        // Method is not checked here, routes are already grouped by method
+        // in router
+        boost::string_view match(const request& req) const {
+            std::cmatch cm;
+            if (!uri.match(req.path(), cm))
+                return { };
+
+            size_t msize = cm.length(0);
+            if (type != route_type::use && msize != req.path().size()) {
+                // For non-use routes uri must match exactly
+                return { };
+            }
+
+            return req.path().substr(0, msize);
+        }
+    };
+
+    void router::add_route(route_type rt, route_handler&& rh,
+        boost::string_view uri, http::verb mtd)
+    {
+        auto& t = edit();
+        size_t index = t.routes.size();
+        t.routes.emplace_back(rt, std::forward<route_handler>(rh), uri, mtd);
+        resolve_params(t.routes.back());
+
+        if (rt != route_type::method) {
+            for (auto& routes : t.by_method)
+                routes.push_back(index);
+            return;
+        }
+        t.by_method[static_cast<size_t>(mtd)].push_back(index);
+
+        // Update methods allowed for the path
+        auto it = std::find_if(t.allowed.begin(), t.allowed.end(),
+            [&](const allowed_methods& am) { return am.pattern == uri; });
+        if (it == t.allowed.end()) {
+            t.allowed.push_back({ uri.to_string(), path(uri), { } });
+            it = std::prev(t.allowed.end());
+        }
+        it->verbs.set(static_cast<size_t>(mtd));
+    }
+
+    void router::resolve_params(route& r) const
+    {
+        auto& t = edit();
+        r.params.assign(r.uri.param_count(), nullptr);
+        for (size_t i = 0; i < r.params.size(); ++i) {
+            auto it = t.params.find(r.uri.param_name(i));
+            if (it != t.params.end())
+                r.params[i] = &it->second;
+        }
+    }
+
+    std::string router::allowed(const request& req) const
+    {
+        verb_set verbs;
+        allowed(req.path(), verbs);
+
+        // Value of Allow header, ex. "GET, POST"
+        std::string allow;
+        for (size_t i = 0; i < verbs.size(); ++i) {
+            if (!verbs[i])
+                continue;
+            auto verb = http::to_string(static_cast<http::verb>(i));
+            if (!allow.empty())
+                allow.append(", ");
+            allow.append(verb.data(), verb.size());
+        }
+        return allow;
+    }
+
+    // Add methods routed for path to verbs, including routes of
+    // mounted routers
+    void router::allowed(boost::string_view p, verb_set& verbs) const
+    {
+        auto t = table();
+        for (auto& am : t->allowed) {
+            std::cmatch cm;
+            if (am.uri.match(p, cm) && size_t(cm.length(0)) == p.size())
+                verbs |= am.verbs;
+        }
+
+        for (auto& r : t->routes) {
+            auto sub = boost::get<router>(&r.handler);
+            if (!sub || r.type == route_type::method)
+                continue;
+
+            std::cmatch cm;
+            if (!r.uri.match(p, cm))
+                continue;
+            size_t msize = cm.length(0);
+            if (r.type != route_type::use && msize != p.size())
+                continue;
+
+            // Path as seen by the mounted router
+            auto sub_path = p.substr(msize == 1 ? 0 : msize);
+            sub->allowed(sub_path.empty() ? "/" : sub_path, verbs);
+        }
+    }
+
+    struct router::dispatch
+        : next::frame
+        , std::enable_shared_from_this<dispatch>
+    {
+        std::shared_ptr<impl> self;
+        request req;
+        response resp;
+        next n;
+        std::function<void()> done;
+
+        // Routes to visit and the path they are matched against
+        const std::vector<size_t>& routes;
+        const boost::string_view path;
+        size_t index = 0;
+
+        // Matched route with parameters yet to be handled
+        const route* current = nullptr;
+        std::vector<boost::string_view> values;
+        size_t param = 0;
+
+        size_t error_index = 0;
+
+        dispatch(const std::shared_ptr<impl>& s,
+            request& rq, response& rs, next& nx, std::function<void()>&& d)
+        : self(s), req(rq), resp(rs), n(nx), done(std::move(d))
+        , routes(s->by_method[static_cast<size_t>(rq.method())])
+        , path(rq.path())
+        { }
+
+        template <class F>
+        bool invoke(F&& fn) {
+            return n.safe_invoke(std::forward<F>(fn), shared_from_this());
+        }
+
+        // Handler called next after it returned
+        void resume() override {
+            if (n.err())
+                handle_error();
+            else
+                run();
+        }
+
+        void run()
+        {
+            for (;;) {
+                if (!current && !match())
+                    break;
+
+                // Call param callbacks once per request-response cycle,
+                // even if matched by several routes
+                while (param < values.size()) {
+                    size_t i = param++;
+                    auto& value = values[i];
+                    req.params().emplace(
+                        current->uri.param_name(i).c_str(), value);
+                    auto handler = current->params[i];
+                    if (!handler || !req.param_called(handler))
+                        continue;
+
+                    if (!invoke([&] { (*handler)(req, resp, n, value); }))
+                        return;
+                    if (n.err()) {
+                        handle_error();
+                        return;
+                    }
+                }
+
+                auto& route = *current;
+                current = nullptr;
+
+                if (!invoke([&] {
+                    boost::apply_visitor(visitor(req, resp, n), route.handler); }))
+                    return;
+                if (n.err()) {
+                    handle_error();
+                    return;
+                }
+            }
+
+            req.path(path);
+            done();
+        }
+
+        // Find next matching route. Return false if no more routes.
+        bool match()
+        {
+            while (index < routes.size()) {
+                auto& route = self->routes[routes[index++]];
+
+                // Every route sees the path as it was passed to this router
+                req.path(path);
+
+                boost::string_view uri_match = route.match(req);
+                if (uri_match.empty())
+                    continue;
+
+                // Update request fields
+                req.base_url(uri_match);
+                // Make sure leading '/' is present
+                req.path(req.path().substr(
+                    uri_match.size() == 1 ? 0 : uri_match.size()));
+                if (req.path().empty())
+                    req.path({ "/", 1 });
+
+                current = &route;
+                route.uri.get_values(uri_match, values);
+                param = 0;
+                // Names of params belong to route table, which may be
+                // replaced while request is still in use
+                if (!values.empty())
+                    req.pin(self);
+                return true;
+            }
+            return false;
+        }
+
+        // Error handlers called in order while they call next. Parent
+        // router error handlers called if all handlers called next.
+        void handle_error()
+        {
+            while (error_index < self->errors.size()) {
+                auto& handler = self->errors[error_index++];
+                if (!invoke([&] { handler(n.err(), req, resp, n); }))
+                    return;
+            }
+            done();
+        }
+    };
+
+    void router::handle_request(
+        request& req, response& resp, next& n, std::function<void()> done) const
+    {
+        std::make_shared<dispatch>(table(), req, resp, n, std::move(done))->run();
+    }
+
+} // namespace rest
+
+// end of rest/router.hpp
+
+namespace rest {
+
+    struct json_options {
+        // Maximum body size, larger is responded with 413 Payload Too Large
+        size_t limit = 100 * 1024;
+
+        // Maximum nesting of arrays and objects
+        unsigned max_depth = 64;
+
+        // Media type of requests to parse
+        boost::string_view type { "application/json" };
+    };
+
+    // Validates JSON request body and makes it available as
+    // request::json(). Values are decoded on access, see json_value.
+    struct json {
+    private:
+        const json_options opt;
+
+    public:
+        json(json_options options = { }) noexcept
+        : opt(std::move(options))
+        { }
+
+        void operator()(const request& req, response&, next& n) const
+        {
+            if (!req.is(opt.type) || req.message().body().size() == 0) {
+                n();
+                return;
+            }
+            if (req.message().body().size() > opt.limit) {
+                n(error(http::status::payload_too_large));
+                return;
+            }
+
+            auto body = req.body();
+            auto value = json_value::parse(
+                { static_cast<const char*>(body.data()), body.size() }, opt.max_depth);
+            if (!value) {
+                n(error(http::status::bad_request, "Invalid JSON"));
+                return;
+            }
+            req.json() = value;
+            n();
+        }
+    };
+
+    struct urlencoded_options {
+        // Maximum body size, larger is responded with 413 Payload Too Large
+        size_t limit = 100 * 1024;
+
+        // Maximum number of fields, more is responded with 413
+        size_t parameter_limit = 1000;
+
+        // Media type of requests to parse
+        boost::string_view type { "application/x-www-form-urlencoded" };
+    };
+
+    // Parses form fields of request body into request::form(). Fields
+    // are decoded in place, names and values refer to the body.
+    struct urlencoded {
+    private:
+        const urlencoded_options opt;
+
+        static int hex(char c) noexcept {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            c |= 0x20;
+            return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        }
+
+        // Decode range in place, return end of decoded
+        static char* decode(char* first, char* last) noexcept
+        {
+            auto out = first;
+            for (auto p = first; p != last; ++p) {
+                int hi, lo;
+                if (*p == '+')
+                    *out++ = ' ';
+                else if (*p == '%' && last - p > 2 &&
+                    (hi = hex(p[1])) >= 0 && (lo = hex(p[2])) >= 0)
+                {
+                    *out++ = char(hi << 4 | lo);
+                    p += 2;
+                }
+                else
+                    *out++ = *p;
+            }
+            return out;
+        }
+
+    public:
+        urlencoded(urlencoded_options options = { }) noexcept
+        : opt(std::move(options))
+        { }
+
+        void operator()(const request& req, response&, next& n) const
+        {
+            if (!req.is(opt.type) || req.message().body().size() == 0) {
+                n();
+                return;
+            }
+            if (req.message().body().size() > opt.limit) {
+                n(error(http::status::payload_too_large));
+                return;
+            }
+
+            auto body = req.body();
+            auto first = static_cast<char*>(body.data());
+            auto last = first + body.size();
+
+            // Names are null terminated in place of '=' or '&'. If the
+            // last field has neither, terminate by copy of body.
+            auto tail = std::find(
+                std::reverse_iterator<char*>(last),
+                std::reverse_iterator<char*>(first), '&').base();
+            if (tail != last && std::find(tail, last, '=') == last) {
+                body = req.body(true);
+                first = static_cast<char*>(body.data());
+                last = first + body.size();
+            }
+
+            auto& form = req.form();
+            size_t count = 0;
+            for (auto p = first; p != last; ) {
+                auto amp = std::find(p, last, '&');
+                if (amp != p) {
+                    if (++count > opt.parameter_limit) {
+                        form.clear();
+                        n(error(http::status::payload_too_large, "Too many parameters"));
+                        return;
+                    }
+                    auto eq = std::find(p, amp, '=');
+                    boost::string_view value;
+                    if (eq != amp)
+                        value = { eq + 1, size_t(decode(eq + 1, amp) - eq - 1) };
+                    *decode(p, eq) = 0;
+                    form.emplace(p, value);
+                }
+                p = amp == last ? last : amp + 1;
+            }
+            n();
+        }
+    };
+
+} // namespace rest
+
+// end of rest/body_parser.hpp
+
+// beginning of rest/cache.hpp
+
+#include <boost/beast/core/string.hpp>
+#include <boost/functional/hash.hpp>
+#include <list>
+#include <unordered_map>
+
+namespace rest {
+
+    struct cache_options {
+        // Time for a response to stay in cache
+        std::chrono::steady_clock::duration ttl = std::chrono::seconds(60);
+
+        // Maximum total size of cached responses in bytes
+        size_t max_size = 64 * 1024 * 1024;
+
+        // Request headers that select a response in addition to the url,
+        // ex. "Accept-Encoding"
+        std::vector<std::string> vary;
+    };
+
+    struct cache {
+    private:
+        using clock = std::chrono::steady_clock;
+        using data_ptr = std::shared_ptr<const std::string>;
+
+        static constexpr size_t shard_count = 16;
+
+        struct entry {
+            std::string key;
+            data_ptr data;
+            clock::time_point expires;
+            // Marked public, may be served to authorized requests
+            bool shared;
+        };
+
+        // Least recently used entry is at the back of the list
+        struct shard {
+            std::mutex mtx;
+            std::list<entry> lru;
+            std::unordered_map<boost::string_view, std::list<entry>::iterator,
+                boost::hash<boost::string_view>> index;
+            size_t size = 0;
+
+            void erase(std::list<entry>::iterator it) {
+                size -= it->key.size() + it->data->size();
+                index.erase(it->key);
+                lru.erase(it);
+            }
+
+            data_ptr find(const std::string& key, clock::time_point now,
+                bool authorized)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = index.find(key);
+                if (it == index.end())
+                    return { };
+
+                auto pos = it->second;
+                if (pos->expires <= now) {
+                    erase(pos);
+                    return { };
+                }
+                if (authorized && !pos->shared)
+                    return { };
+                lru.splice(lru.begin(), lru, pos);
+                return pos->data;
+            }
+
+            void insert(std::string&& key, data_ptr&& data,
+                clock::time_point expires, bool shared, size_t max_size)
+            {
+                size_t esize = key.size() + data->size();
+                if (esize > max_size)
+                    return;
+
+                std::lock_guard<std::mutex> lock(mtx);
+                auto it = index.find(key);
+                if (it != index.end())
+                    erase(it->second);
+
+                while (size + esize > max_size)
+                    erase(std::prev(lru.end()));
+
+                lru.push_front({ std::move(key), std::move(data), expires, shared });
+                index.emplace(lru.front().key, lru.begin());
+                size += esize;
+            }
+        };
+
+        struct table {
+            shard shards[shard_count];
+            // Request headers responses are selected by
+            const std::vector<std::string> vary;
+
+            table(std::vector<std::string> v)
+            : vary(std::move(v))
+            { }
+
+            shard& get(const std::string& key) {
+                return shards[std::hash<std::string>()(key) % shard_count];
+            }
+        };
+
+        std::shared_ptr<table> tbl;
+        const cache_options opt;
+
+        std::string make_key(const request& req) const
+        {
+            auto url = req.original_url();
+            std::string key(url.data(), url.size());
+            for (auto& name : tbl->vary) {
+                key.push_back('\0');
+                auto value = req.get(name);
+                if (value)
+                    key.append(value->data(), value->size());
+            }
+            return key;
+        }
+
+        // Return true if pred is true for any token of comma separated
+        // header value, ex. "max-age" of "max-age=60, private"
+        template <class Pred>
+        static bool any_token(boost::string_view value, const Pred& pred)
+        {
+            auto ws = [](char c) { return c == ' ' || c == '\t'; };
+            while (!value.empty()) {
+                size_t end = std::min(value.find(','), value.size());
+                auto token = value.substr(0, end);
+                value.remove_prefix(std::min(end + 1, value.size()));
+
+                // Directive may have argument, ex. private="Set-Cookie"
+                token = token.substr(0, token.find('='));
+                while (!token.empty() && ws(token.front()))
+                    token.remove_prefix(1);
+                while (!token.empty() && ws(token.back()))
+                    token.remove_suffix(1);
+                if (!token.empty() && pred(token))
+                    return true;
+            }
+            return false;
+        }
+
+        static bool has_directive(const response::message_type& msg,
+            boost::string_view name)
+        {
+            auto it = msg.find(http::field::cache_control);
+            return it != msg.end() && any_token(it->value(),
+                [&](boost::string_view t) { return boost::beast::iequals(t, name); });
+        }
+
+        // Only complete successful responses not forbidden to be stored.
+        // Responses setting cookies are personal, so are responses to
+        // authorized requests unless marked public. Responses varying
+        // by headers the key is not made of are not stored either.
+        static bool cacheable(const response::message_type& msg,
+            bool authorized, const std::vector<std::string>& vary)
+        {
+            if (msg.result() != http::status::ok)
+                return false;
+            if (msg.find(http::field::set_cookie) != msg.end())
+                return false;
+
+            // Vary of "*" is never in the list
+            auto known = [&](boost::string_view name) {
+                for (auto& v : vary)
+                    if (boost::beast::iequals(v, name))
+                        return true;
+                return false;
+            };
+            auto it = msg.find(http::field::vary);
+            if (it != msg.end() && any_token(it->value(),
+                [&](boost::string_view name) { return !known(name); }))
+            {
+                return false;
+            }
+
+            if (has_directive(msg, "no-store") || has_directive(msg, "private"))
+                return false;
+            return !authorized || has_directive(msg, "public");
+        }
+
+    public:
+        cache(cache_options options = { })
+        : tbl(std::make_shared<table>(options.vary))
+        , opt(std::move(options))
+        { }
+
+        void operator()(const request& req, response& resp, next& n) const
+        {
+            if (req.method() != http::verb::get) {
+                n();
+                return;
+            }
+
+            auto key = make_key(req);
+            auto& sh = tbl->get(key);
+
+            // Authorized requests are served only public responses
+            bool authorized = !!req.get(http::field::authorization);
+            auto data = sh.find(key, clock::now(), authorized);
+            if (data) {
+                resp.send_raw(std::move(data));
+                return;
+            }
+
+            // Store response produced by the following handlers
+            auto t = tbl;
+            auto ttl = opt.ttl;
+            auto max_size = opt.max_size / shard_count;
+            resp.on_send([t, key, ttl, max_size, authorized](
+                const response::message_type& msg)
+            {
+                if (!cacheable(msg, authorized, t->vary))
+                    return;
+
+                std::ostringstream os;
+                os << msg;
+                auto k = key;
+                t->get(k).insert(std::move(k),
+                    std::make_shared<const std::string>(os.str()),
+                    clock::now() + ttl, has_directive(msg, "public"), max_size);
+            });
+            n();
+        }
+    };
+
+} // namespace rest
+
+// end of rest/cache.hpp
+
+// beginning of rest/coroutine.hpp
+
+#if defined(BOOST_ASIO_HAS_CO_AWAIT)
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+
+namespace rest {
+
+    template <class T = void>
+    using awaitable = boost::asio::awaitable<T>;
+
+    // Make route handler of a coroutine with signature
+    //   awaitable<void>(request, response, next)
+    // Arguments are taken by value to stay valid across suspension points.
+    // The coroutine runs on executor of the connection, the chain of
+    // handlers continues when it calls next. Exception thrown by the
+    // coroutine is passed to error handlers.
+    template <class F>
+    req_resp_next co_handler(F&& fn)
+    {
+        auto f = std::make_shared<typename std::decay<F>::type>(
+            std::forward<F>(fn));
+
+        return [f](const request& req, response& resp, next& n) {
+            next nx = n;
+            boost::asio::co_spawn(req.connection()->get_executor(),
+                (*f)(req, resp, n),
+                [nx](std::exception_ptr ep) mutable {
+                    if (!ep)
+                        return;
+                    try { std::rethrow_exception(ep); }
+                    catch (const std::exception& ex) { nx(ex); }
+                    catch (const boost::system::error_code& ec) { nx(ec); }
+                    catch (...) { nx("unknown error"); }
+                });
+        };
+    }
+
+} // namespace rest
+
+#endif // BOOST_ASIO_HAS_CO_AWAIT
+
+// end of rest/coroutine.hpp
+
+// beginning of rest/hpack.hpp
+
+namespace rest {
+
+    // Header compression of HTTP/2 (RFC 7541)
+    struct hpack {
+    private:
+        struct entry {
+            std::string name;
+            std::string value;
+        };
+
+        struct static_entry {
+            const char* name;
+            const char* value;
+        };
+
+        static const static_entry* static_table() noexcept {
+            static const static_entry t[] = {
+                { ":authority", "" },
+                { ":method", "GET" },
+                { ":method", "POST" },
+                { ":path", "/" },
+                { ":path", "/index.html" },
+                { ":scheme", "http" },
+                { ":scheme", "https" },
+                { ":status", "200" },
+                { ":status", "204" },
+                { ":status", "206" },
+                { ":status", "304" },
+                { ":status", "400" },
+                { ":status", "404" },
+                { ":status", "500" },
+                { "accept-charset", "" },
+                { "accept-encoding", "gzip, deflate" },
+                { "accept-language", "" },
+                { "accept-ranges", "" },
+                { "accept", "" },
+                { "access-control-allow-origin", "" },
+                { "age", "" },
+                { "allow", "" },
+                { "authorization", "" },
+                { "cache-control", "" },
+                { "content-disposition", "" },
+                { "content-encoding", "" },
+                { "content-language", "" },
+                { "content-length", "" },
+                { "content-location", "" },
+                { "content-range", "" },
+                { "content-type", "" },
+                { "cookie", "" },
+                { "date", "" },
+                { "etag", "" },
+                { "expect", "" },
+                { "expires", "" },
+                { "from", "" },
+                { "host", "" },
+                { "if-match", "" },
+                { "if-modified-since", "" },
+                { "if-none-match", "" },
+                { "if-range", "" },
+                { "if-unmodified-since", "" },
+                { "last-modified", "" },
+                { "link", "" },
+                { "location", "" },
+                { "max-forwards", "" },
+                { "proxy-authenticate", "" },
+                { "proxy-authorization", "" },
+                { "range", "" },
+                { "referer", "" },
+                { "refresh", "" },
+                { "retry-after", "" },
+                { "server", "" },
+                { "set-cookie", "" },
+                { "strict-transport-security", "" },
+                { "transfer-encoding", "" },
+                { "user-agent", "" },
+                { "vary", "" },
+                { "via", "" },
+                { "www-authenticate", "" },
+            };
+            return t;
+        }
+
+        static constexpr size_t static_size = 61;
+
+        // Huffman code (right aligned) and its length in bits for every
+        // octet and EOS
+        struct code {
+            uint32_t bits;
+            uint8_t size;
+        };
+
+        static const code* huffman_codes() noexcept {
+            static const code t[257] = {
+            {0x1ff8,13}, {0x7fffd8,23}, {0xfffffe2,28}, {0xfffffe3,28},
+            {0xfffffe4,28}, {0xfffffe5,28}, {0xfffffe6,28}, {0xfffffe7,28},
+            {0xfffffe8,28}, {0xffffea,24}, {0x3ffffffc,30}, {0xfffffe9,28},
+            {0xfffffea,28}, {0x3ffffffd,30}, {0xfffffeb,28}, {0xfffffec,28},
+            {0xfffffed,28}, {0xfffffee,28}, {0xfffffef,28}, {0xffffff0,28},
+            {0xffffff1,28}, {0xffffff2,28}, {0x3ffffffe,30}, {0xffffff3,28},
+            {0xffffff4,28}, {0xffffff5,28}, {0xffffff6,28}, {0xffffff7,28},
+            {0xffffff8,28}, {0xffffff9,28}, {0xffffffa,28}, {0xffffffb,28},
+            {0x14,6}, {0x3f8,10}, {0x3f9,10}, {0xffa,12}, {0x1ff9,13},
+            {0x15,6}, {0xf8,8}, {0x7fa,11}, {0x3fa,10}, {0x3fb,10}, {0xf9,8},
+            {0x7fb,11}, {0xfa,8}, {0x16,6}, {0x17,6}, {0x18,6}, {0x0,5},
+            {0x1,5}, {0x2,5}, {0x19,6}, {0x1a,6}, {0x1b,6}, {0x1c,6}, {0x1d,6},
+            {0x1e,6}, {0x1f,6}, {0x5c,7}, {0xfb,8}, {0x7ffc,15}, {0x20,6},
+            {0xffb,12}, {0x3fc,10}, {0x1ffa,13}, {0x21,6}, {0x5d,7}, {0x5e,7},
+            {0x5f,7}, {0x60,7}, {0x61,7}, {0x62,7}, {0x63,7}, {0x64,7},
+            {0x65,7}, {0x66,7}, {0x67,7}, {0x68,7}, {0x69,7}, {0x6a,7},
+            {0x6b,7}, {0x6c,7}, {0x6d,7}, {0x6e,7}, {0x6f,7}, {0x70,7},
+            {0x71,7}, {0x72,7}, {0xfc,8}, {0x73,7}, {0xfd,8}, {0x1ffb,13},
+            {0x7fff0,19}, {0x1ffc,13}, {0x3ffc,14}, {0x22,6}, {0x7ffd,15},
+            {0x3,5}, {0x23,6}, {0x4,5}, {0x24,6}, {0x5,5}, {0x25,6}, {0x26,6},
+            {0x27,6}, {0x6,5}, {0x74,7}, {0x75,7}, {0x28,6}, {0x29,6},
+            {0x2a,6}, {0x7,5}, {0x2b,6}, {0x76,7}, {0x2c,6}, {0x8,5}, {0x9,5},
+            {0x2d,6}, {0x77,7}, {0x78,7}, {0x79,7}, {0x7a,7}, {0x7b,7},
+            {0x7ffe,15}, {0x7fc,11}, {0x3ffd,14}, {0x1ffd,13}, {0xffffffc,28},
+            {0xfffe6,20}, {0x3fffd2,22}, {0xfffe7,20}, {0xfffe8,20},
+            {0x3fffd3,22}, {0x3fffd4,22}, {0x3fffd5,22}, {0x7fffd9,23},
+            {0x3fffd6,22}, {0x7fffda,23}, {0x7fffdb,23}, {0x7fffdc,23},
+            {0x7fffdd,23}, {0x7fffde,23}, {0xffffeb,24}, {0x7fffdf,23},
+            {0xffffec,24}, {0xffffed,24}, {0x3fffd7,22}, {0x7fffe0,23},
+            {0xffffee,24}, {0x7fffe1,23}, {0x7fffe2,23}, {0x7fffe3,23},
+            {0x7fffe4,23}, {0x1fffdc,21}, {0x3fffd8,22}, {0x7fffe5,23},
+            {0x3fffd9,22}, {0x7fffe6,23}, {0x7fffe7,23}, {0xffffef,24},
+            {0x3fffda,22}, {0x1fffdd,21}, {0xfffe9,20}, {0x3fffdb,22},
+            {0x3fffdc,22}, {0x7fffe8,23}, {0x7fffe9,23}, {0x1fffde,21},
+            {0x7fffea,23}, {0x3fffdd,22}, {0x3fffde,22}, {0xfffff0,24},
+            {0x1fffdf,21}, {0x3fffdf,22}, {0x7fffeb,23}, {0x7fffec,23},
+            {0x1fffe0,21}, {0x1fffe1,21}, {0x3fffe0,22}, {0x1fffe2,21},
+            {0x7fffed,23}, {0x3fffe1,22}, {0x7fffee,23}, {0x7fffef,23},
+            {0xfffea,20}, {0x3fffe2,22}, {0x3fffe3,22}, {0x3fffe4,22},
+            {0x7ffff0,23}, {0x3fffe5,22}, {0x3fffe6,22}, {0x7ffff1,23},
+            {0x3ffffe0,26}, {0x3ffffe1,26}, {0xfffeb,20}, {0x7fff1,19},
+            {0x3fffe7,22}, {0x7ffff2,23}, {0x3fffe8,22}, {0x1ffffec,25},
+            {0x3ffffe2,26}, {0x3ffffe3,26}, {0x3ffffe4,26}, {0x7ffffde,27},
+            {0x7ffffdf,27}, {0x3ffffe5,26}, {0xfffff1,24}, {0x1ffffed,25},
+            {0x7fff2,19}, {0x1fffe3,21}, {0x3ffffe6,26}, {0x7ffffe0,27},
+            {0x7ffffe1,27}, {0x3ffffe7,26}, {0x7ffffe2,27}, {0xfffff2,24},
+            {0x1fffe4,21}, {0x1fffe5,21}, {0x3ffffe8,26}, {0x3ffffe9,26},
+            {0xffffffd,28}, {0x7ffffe3,27}, {0x7ffffe4,27}, {0x7ffffe5,27},
+            {0xfffec,20}, {0xfffff3,24}, {0xfffed,20}, {0x1fffe6,21},
+            {0x3fffe9,22}, {0x1fffe7,21}, {0x1fffe8,21}, {0x7ffff3,23},
+            {0x3fffea,22}, {0x3fffeb,22}, {0x1ffffee,25}, {0x1ffffef,25},
+            {0xfffff4,24}, {0xfffff5,24}, {0x3ffffea,26}, {0x7ffff4,23},
+            {0x3ffffeb,26}, {0x7ffffe6,27}, {0x3ffffec,26}, {0x3ffffed,26},
+            {0x7ffffe7,27}, {0x7ffffe8,27}, {0x7ffffe9,27}, {0x7ffffea,27},
+            {0x7ffffeb,27}, {0xffffffe,28}, {0x7ffffec,27}, {0x7ffffed,27},
+            {0x7ffffee,27}, {0x7ffffef,27}, {0x7fffff0,27}, {0x3ffffee,26},
+            {0x3fffffff,30}
+            };
+            return t;
+        }
+
+        // Binary tree of Huffman codes for decoding. Leaves have negative
+        // children, symbol is stored in the first one.
+        struct node {
+            int child[2];
+        };
+
+        static const std::vector<node>& huffman_tree() {
+            static const std::vector<node> tree = [] {
+                std::vector<node> t(1, node { { 0, 0 } });
+                const code* codes = huffman_codes();
+                for (int sym = 0; sym < 257; ++sym) {
+                    size_t n = 0;
+                    for (int i = codes[sym].size - 1; i >= 0; --i) {
+                        int bit = (codes[sym].bits >> i) & 1;
+                        if (i == 0) {
+                            t[n].child[bit] = -sym - 1;
+                            break;
+                        }
+                        if (t[n].child[bit] == 0) {
+                            t[n].child[bit] = int(t.size());
+                            t.push_back(node { { 0, 0 } });
+                        }
+                        n = t[n].child[bit];
+                    }
+                }
+                return t;
+            }();
+            return tree;
+        }
+
+        // Read integer with N-bit prefix
+        static bool read_int(const uint8_t*& p, const uint8_t* end,
+            unsigned prefix, size_t& value) noexcept
+        {
+            if (p == end)
+                return false;
+            size_t mask = (1u << prefix) - 1;
+            value = *p++ & mask;
+            if (value < mask)
+                return true;
+
+            for (unsigned shift = 0; p != end && shift < 32; shift += 7) {
+                uint8_t b = *p++;
+                value += size_t(b & 0x7f) << shift;
+                if (!(b & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        static bool read_huffman(const uint8_t* p, size_t n, std::string& out)
+        {
+            auto& tree = huffman_tree();
+            size_t state = 0;
+            // Bits read since last symbol and whether they were all ones
+            unsigned pad = 0;
+            bool ones = true;
+
+            for (const uint8_t* end = p + n; p != end; ++p) {
+                for (int i = 7; i >= 0; --i) {
+                    int bit = (*p >> i) & 1;
+                    int next = tree[state].child[bit];
+                    ++pad;
+                    ones = ones && bit;
+                    if (next < 0) {
+                        // EOS must not be encoded
+                        if (next == -257)
+                            return false;
+                        out.push_back(char(-next - 1));
+                        state = 0;
+                        pad = 0;
+                        ones = true;
+                    }
+                    else if (next == 0)
+                        return false;
+                    else
+                        state = next;
+                }
+            }
+            // Padding is a prefix of EOS shorter than an octet
+            return pad < 8 && ones;
+        }
+
+        static bool read_string(const uint8_t*& p, const uint8_t* end,
+            std::string& out)
+        {
+            if (p == end)
+                return false;
+            bool huffman = *p & 0x80;
+            size_t n;
+            if (!read_int(p, end, 7, n) || size_t(end - p) < n)
+                return false;
+
+            out.clear();
+            if (huffman) {
+                if (!read_huffman(p, n, out))
+                    return false;
+            }
+            else
+                out.assign(reinterpret_cast<const char*>(p), n);
+            p += n;
+            return true;
+        }
+
+        static void write_int(std::string& out, uint8_t flags,
+            unsigned prefix, size_t value)
+        {
+            size_t mask = (1u << prefix) - 1;
+            if (value < mask) {
+                out.push_back(char(flags | value));
+                return;
+            }
+            out.push_back(char(flags | mask));
+            for (value -= mask; value >= 0x80; value >>= 7)
+                out.push_back(char(0x80 | (value & 0x7f)));
+            out.push_back(char(value));
+        }
+
+        // Literal without Huffman coding
+        static void write_string(std::string& out, boost::string_view s) {
+            write_int(out, 0, 7, s.size());
+            out.append(s.data(), s.size());
+        }
+
+    public:
+        // Decoder state of a connection
+        struct decoder {
+        private:
+            std::deque<entry> dynamic;
+            size_t size = 0;
+            size_t max_size;
+            size_t limit;
+
+            void evict() {
+                while (size > max_size) {
+                    auto& e = dynamic.back();
+                    size -= e.name.size() + e.value.size() + 32;
+                    dynamic.pop_back();
+                }
+            }
+
+            void insert(const std::string& name, const std::string& value) {
+                size += name.size() + value.size() + 32;
+                dynamic.push_front({ name, value });
+                evict();
+            }
+
+            bool lookup(size_t index, std::string& name, std::string* value) const
+            {
+                if (index == 0)
+                    return false;
+                if (index <= static_size) {
+                    auto& e = static_table()[index - 1];
+                    name = e.name;
+                    if (value)
+                        *value = e.value;
+                    return true;
+                }
+                index -= static_size + 1;
+                if (index >= dynamic.size())
+                    return false;
+                name = dynamic[index].name;
+                if (value)
+                    *value = dynamic[index].value;
+                return true;
+            }
+
+        public:
+            // Limit is the table size advertised in settings
+            decoder(size_t limit = 4096) noexcept
+            : max_size(limit), limit(limit)
+            { }
+
+            // Decode header block calling f(name, value) for each field.
+            // Return false on compression error.
+            template <class F>
+            bool decode(const uint8_t* p, size_t n, F&& f)
+            {
+                const uint8_t* end = p + n;
+                std::string name, value;
+
+                while (p != end) {
+                    uint8_t b = *p;
+                    size_t index;
+
+                    // Indexed field
+                    if (b & 0x80) {
+                        if (!read_int(p, end, 7, index) ||
+                            !lookup(index, name, &value))
+                            return false;
+                        f(name, value);
+                        continue;
+                    }
+
+                    // Dynamic table size update
+                    if ((b & 0xe0) == 0x20) {
+                        if (!read_int(p, end, 5, index) || index > limit)
+                            return false;
+                        max_size = index;
+                        evict();
+                        continue;
+                    }
+
+                    // Literal, with incremental indexing or not
+                    bool indexing = (b & 0xc0) == 0x40;
+                    if (!read_int(p, end, indexing ? 6 : 4, index))
+                        return false;
+                    if (index == 0) {
+                        if (!read_string(p, end, name))
+                            return false;
+                    }
+                    else if (!lookup(index, name, nullptr))
+                        return false;
+                    if (!read_string(p, end, value))
+                        return false;
+
+                    if (indexing)
+                        insert(name, value);
+                    f(name, value);
+                }
+                return true;
+            }
+        };
+
+        // Encode status pseudo header
+        static void encode_status(std::string& out, unsigned status)
+        {
+            auto s = std::to_string(status);
+            // Fully indexed if in static table
+            for (size_t i = 7; i < 14; ++i) {
+                if (s == static_table()[i].value) {
+                    write_int(out, 0x80, 7, i + 1);
+                    return;
+                }
+            }
+            write_int(out, 0, 4, 8);
+            write_string(out, s);
+        }
+
+        // Encode field as literal without indexing, name must be lower case.
+        // Encoder never adds to dynamic table, so no state is needed.
+        static void encode(std::string& out,
+            boost::string_view name, boost::string_view value)
+        {
+            // Name from static table if present
+            for (size_t i = 14; i < static_size; ++i) {
+                if (name == static_table()[i].name) {
+                    write_int(out, 0, 4, i + 1);
+                    write_string(out, value);
+                    return;
+                }
+            }
+            out.push_back(0);
+            write_string(out, name);
+            write_string(out, value);
+        }
+    };
+
+} // namespace rest
+
+// end of rest/hpack.hpp
+
+// beginning of rest/http2.hpp
+
+#include <boost/beast/core/detail/base64.hpp>
+#include <cctype>
+
+namespace rest {
+
+    struct http2_options {
+        // Maximum number of requests in progress on a connection
+        uint32_t max_concurrent_streams = 100;
+
+        // Flow control window of request body, i.e. number of bytes
+        // client may send before the server has read them
+        uint32_t initial_window_size = 65535;
+
+        // Maximum size of request headers
+        uint32_t max_header_list_size = 64 * 1024;
+
+        // Requests with larger body are reset
+        size_t max_body_size = 1024 * 1024;
+    };
+
+    struct http2_connection;
+
+    // Stream (request-response exchange) of HTTP/2 connection. Looks like
+    // a connection of its own to request and response.
+    struct http2_stream : session {
+        std::shared_ptr<http2_connection> owner;
+        const uint32_t id;
+        request_message req;
+
+        bool end_remote = false;   // request received
+        bool headers_sent = false;
+        bool end_pending = false;  // end stream when data is sent
+        bool end_local = false;    // response sent
+        bool reset = false;
+
+        // Response body not yet sent due to flow control
+        std::string data;
+        size_t data_sent = 0;
+        int64_t window;
+
+        // Serialized HTTP/1 header written by send_raw or event_stream
+        std::string raw;
+
+        // Called when stream is reset or connection is lost
+        std::function<void()> disconnected;
+
+        http2_stream(std::shared_ptr<http2_connection> c, uint32_t id,
+            int64_t window) noexcept
+        : owner(std::move(c)), id(id), window(window)
+        { }
+
+        executor_type get_executor() override;
+        tcp::socket* socket() override;
+
+        void async_read(boost::beast::flat_buffer&,
+            request_message&, handler) override;
+        void async_read_some(boost::asio::mutable_buffer, read_handler) override;
+        void async_write(response_message&, handler) override;
+        void async_write(shared_response_message&, handler) override;
+        void async_write(boost::asio::const_buffer, handler) override;
+        void shutdown() override;
+        void on_disconnect(std::function<void()>) override;
+
+        // Stream is dropped, response is not sent
+        void cancel() {
+            reset = true;
+            auto h = std::move(disconnected);
+            disconnected = nullptr;
+            if (h)
+                h();
+        }
+    };
+
+    // HTTP/2 connection without TLS (h2c)
+    struct http2_connection : std::enable_shared_from_this<http2_connection> {
+        using dispatcher = std::function<void(const session_ptr&)>;
+        using strand_type =
+            boost::asio::strand<boost::asio::io_context::executor_type>;
+        using stream_ptr = std::shared_ptr<http2_stream>;
+
+        enum frame_type : uint8_t {
+            data_frame = 0x0,
+            headers_frame = 0x1,
+            priority_frame = 0x2,
+            rst_stream_frame = 0x3,
+            settings_frame = 0x4,
+            push_promise_frame = 0x5,
+            ping_frame = 0x6,
+            goaway_frame = 0x7,
+            window_update_frame = 0x8,
+            continuation_frame = 0x9
+        };
+
+        enum frame_flag : uint8_t {
+            end_stream = 0x1,
+            ack = 0x1,
+            end_headers = 0x4,
+            padded = 0x8,
+            priority = 0x20
+        };
+
+        enum error_code : uint32_t {
+            no_error = 0x0,
+            protocol_error = 0x1,
+            internal_error = 0x2,
+            flow_control_error = 0x3,
+            stream_closed = 0x5,
+            frame_size_error = 0x6,
+            refused_stream = 0x7,
+            cancel = 0x8,
+            compression_error = 0x9
+        };
+
+        // Largest frame payload accepted, the default of protocol
+        static constexpr size_t max_frame_size = 16384;
+        static constexpr int64_t max_window = 0x7fffffff;
+
+        // First bytes sent by client
+        static boost::string_view preface() noexcept {
+            return { "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n", 24 };
+        }
+
+    private:
+        session_ptr conn;
+        strand_type strand;
+        http2_options opt;
+        dispatcher dispatch_request;
+
+        boost::beast::flat_buffer in;
+        bool preface_received = false;
+
+        // Frames to send, all written together by one write operation
+        std::string out;
+        std::string writing;
+        bool write_scheduled = false;
+        bool write_busy = false;
+
+        hpack::decoder decoder;
+        // Header block being received in HEADERS and CONTINUATION frames
+        uint32_t header_stream = 0;
+        uint8_t header_flags = 0;
+        std::string header_block;
+
+        std::map<uint32_t, stream_ptr> streams;
+        uint32_t last_stream = 0;
+
+        // Send flow control set by client
+        int64_t send_window = 65535;
+        int64_t peer_window = 65535;
+        size_t peer_frame_size = max_frame_size;
+
+        bool going_away = false;
+        bool closing = false;
+        bool closed = false;
+
+        friend struct http2_stream;
+
+        static uint32_t read32(const uint8_t* p) noexcept {
+            return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 |
+                uint32_t(p[2]) << 8 | p[3];
+        }
+
+        static void write32(char* p, uint32_t v) noexcept {
+            p[0] = char(v >> 24);
+            p[1] = char(v >> 16);
+            p[2] = char(v >> 8);
+            p[3] = char(v);
+        }
+
+        void frame(uint8_t type, uint8_t flags, uint32_t id,
+            const void* payload, size_t size)
+        {
+            char head[9] = {
+                char(size >> 16), char(size >> 8), char(size),
+                char(type), char(flags) };
+            write32(head + 5, id & 0x7fffffff);
+            out.append(head, 9);
+            out.append(static_cast<const char*>(payload), size);
+
+            // Frames queued in the same handler are written at once
+            if (!write_busy && !write_scheduled) {
+                write_scheduled = true;
+                auto s = shared_from_this();
+                boost::asio::post(strand, [s] {
+                    s->write_scheduled = false;
+                    s->write();
+                });
+            }
+        }
+
+        void write()
+        {
+            if (write_busy)
+                return;
+            if (out.empty()) {
+                if (closing)
+                    close();
+                return;
+            }
+
+            write_busy = true;
+            writing.swap(out);
+            auto s = shared_from_this();
+            conn->async_write(boost::asio::buffer(writing),
+                [s](boost::beast::error_code ec) {
+                    boost::asio::dispatch(s->strand, [s, ec] {
+                        s->write_busy = false;
+                        s->writing.clear();
+                        if (ec) {
+                            s->close();
+                            return;
+                        }
+                        s->write();
+                    });
+                });
+        }
+
+        void read()
+        {
+            auto s = shared_from_this();
+            conn->async_read_some(in.prepare(max_frame_size + 9),
+                [s](boost::beast::error_code ec, size_t n) {
+                    boost::asio::dispatch(s->strand, [s, ec, n] {
+                        if (ec || s->closed) {
+                            s->close();
+                            return;
+                        }
+                        s->in.commit(n);
+                        if (s->process())
+                            s->read();
+                    });
+                });
+        }
+
+        void close()
+        {
+            if (closed)
+                return;
+            closed = true;
+            // Streams still in progress drop their responses
+            auto dropped = std::move(streams);
+            streams.clear();
+            for (auto& st : dropped)
+                st.second->cancel();
+            conn->shutdown();
+        }
+
+        // Connection error, tell the client and stop reading
+        bool fail(error_code code)
+        {
+            char payload[8];
+            write32(payload, last_stream);
+            write32(payload + 4, code);
+            frame(goaway_frame, 0, 0, payload, sizeof(payload));
+            going_away = true;
+            closing = true;
+            return false;
+        }
+
+        // Stream error
+        void reset(uint32_t id, error_code code)
+        {
+            char payload[4];
+            write32(payload, code);
+            frame(rst_stream_frame, 0, id, payload, sizeof(payload));
+
+            auto it = streams.find(id);
+            if (it != streams.end()) {
+                auto st = it->second;
+                streams.erase(it);
+                st->cancel();
+            }
+        }
+
+        void window_update(uint32_t id, uint32_t size)
+        {
+            char payload[4];
+            write32(payload, size);
+            frame(window_update_frame, 0, id, payload, sizeof(payload));
+        }
+
+        void send_settings()
+        {
+            const std::pair<uint16_t, uint32_t> settings[] = {
+                { 0x3, opt.max_concurrent_streams },
+                { 0x4, opt.initial_window_size },
+                { 0x6, opt.max_header_list_size }
+            };
+            char payload[sizeof(settings) / sizeof(settings[0]) * 6];
+            char* p = payload;
+            for (auto& s : settings) {
+                p[0] = char(s.first >> 8);
+                p[1] = char(s.first);
+                write32(p + 2, s.second);
+                p += 6;
+            }
+            frame(settings_frame, 0, 0, payload, sizeof(payload));
+        }
+
+        bool apply_settings(const uint8_t* p, size_t size)
+        {
+            for (; size >= 6; p += 6, size -= 6) {
+                uint16_t id = uint16_t(p[0] << 8 | p[1]);
+                uint32_t value = read32(p + 2);
+
+                switch (id) {
+                case 0x2: // SETTINGS_ENABLE_PUSH
+                    if (value > 1)
+                        return fail(protocol_error);
+                    break;
+                case 0x4: { // SETTINGS_INITIAL_WINDOW_SIZE
+                    if (value > max_window)
+                        return fail(flow_control_error);
+                    int64_t delta = int64_t(value) - peer_window;
+                    peer_window = value;
+                    for (auto& st : streams)
+                        st.second->window += delta;
+                    break;
+                }
+                case 0x5: // SETTINGS_MAX_FRAME_SIZE
+                    if (value < 16384 || value > 16777215)
+                        return fail(protocol_error);
+                    peer_frame_size = value;
+                    break;
+                default:
+                    // Encoder does not use dynamic table, header table
+                    // size does not matter
+                    break;
+                }
+            }
+            return true;
+        }
+
+        // Handle complete frames in input buffer. Return false on
+        // connection error.
+        bool process()
+        {
+            if (!preface_received) {
+                if (in.size() < preface().size())
+                    return true;
+                if (std::memcmp(in.data().data(),
+                    preface().data(), preface().size()) != 0)
+                {
+                    close();
+                    return false;
+                }
+                in.consume(preface().size());
+                preface_received = true;
+            }
+
+            while (in.size() >= 9) {
+                auto p = static_cast<const uint8_t*>(in.data().data());
+                size_t size = size_t(p[0]) << 16 | size_t(p[1]) << 8 | p[2];
+                if (size > max_frame_size)
+                    return fail(frame_size_error);
+                if (in.size() < size + 9)
+                    break;
+
+                bool ok = on_frame(p[3], p[4], read32(p + 5) & 0x7fffffff,
+                    p + 9, size);
+                in.consume(size + 9);
+                if (!ok)
+                    return false;
+            }
+            return !closing;
+        }
+
+        bool on_frame(uint8_t type, uint8_t flags, uint32_t id,
+            const uint8_t* p, size_t size)
+        {
+            // Header block must not be interrupted by other frames
+            if (header_stream && (type != continuation_frame || id != header_stream))
+                return fail(protocol_error);
+
+            switch (type) {
+            case data_frame:
+                return on_data(flags, id, p, size);
+            case headers_frame:
+                return on_headers(flags, id, p, size);
+            case continuation_frame:
+                if (!header_stream)
+                    return fail(protocol_error);
+                header_block.append(reinterpret_cast<const char*>(p), size);
+                if (header_block.size() > opt.max_header_list_size)
+                    return fail(protocol_error);
+                return (flags & end_headers) ? on_header_block() : true;
+            case priority_frame:
+                if (size != 5)
+                    reset(id, frame_size_error);
+                return true;
+            case rst_stream_frame: {
+                if (id == 0 || size != 4)
+                    return fail(id ? frame_size_error : protocol_error);
+                auto it = streams.find(id);
+                if (it != streams.end()) {
+                    auto st = it->second;
+                    streams.erase(it);
+                    st->cancel();
+                }
+                return true;
+            }
+            case settings_frame:
+                if (id != 0)
+                    return fail(protocol_error);
+                if (flags & ack)
+                    return size == 0 || fail(frame_size_error);
+                if (size % 6)
+                    return fail(frame_size_error);
+                if (!apply_settings(p, size))
+                    return false;
+                frame(settings_frame, ack, 0, nullptr, 0);
+                flush_all();
+                return true;
+            case ping_frame:
+                if (id != 0)
+                    return fail(protocol_error);
+                if (size != 8)
+                    return fail(frame_size_error);
+                if (!(flags & ack))
+                    frame(ping_frame, ack, 0, p, size);
+                return true;
+            case goaway_frame:
+                // Finish requests in progress
+                going_away = true;
+                if (streams.empty())
+                    closing = true;
+                return true;
+            case window_update_frame:
+                return on_window_update(id, p, size);
+            case push_promise_frame:
+                return fail(protocol_error);
+            default:
+                // Unknown frames are ignored
+                return true;
+            }
+        }
+
+        // Remove padding and priority fields from payload
+        static bool strip(uint8_t flags, const uint8_t*& p, size_t& size,
+            bool has_priority) noexcept
+        {
+            size_t pad = 0;
+            if (flags & padded) {
+                if (size < 1)
+                    return false;
+                pad = *p++;
+                --size;
+            }
+            if (has_priority && (flags & priority)) {
+                if (size < 5)
+                    return false;
+                p += 5;
+                size -= 5;
+            }
+            if (pad > size)
+                return false;
+            size -= pad;
+            return true;
+        }
+
+        bool on_headers(uint8_t flags, uint32_t id, const uint8_t* p, size_t size)
+        {
+            if (id == 0 || !(id & 1) || !strip(flags, p, size, true))
+                return fail(protocol_error);
+
+            header_stream = id;
+            header_flags = flags;
+            header_block.assign(reinterpret_cast<const char*>(p), size);
+            return (flags & end_headers) ? on_header_block() : true;
+        }
+
+        bool on_header_block()
+        {
+            uint32_t id = header_stream;
+            header_stream = 0;
+
+            stream_ptr st;
+            auto it = streams.find(id);
+            bool trailers = it != streams.end();
+            if (trailers)
+                st = it->second;
+            else if (id <= last_stream)
+                return fail(stream_closed);
+            else {
+                last_stream = id;
+                st = std::make_shared<http2_stream>(
+                    shared_from_this(), id, peer_window);
+            }
+
+            // Block is decoded even if stream is refused to keep
+            // decoder state
+            bool valid = true;
+            bool ok = decoder.decode(
+                reinterpret_cast<const uint8_t*>(header_block.data()),
+                header_block.size(),
+                [&](const std::string& name, const std::string& value) {
+                    if (trailers)
+                        return;
+                    if (name.empty() || name[0] != ':')
+                        st->req.insert(name, value);
+                    else if (name == ":method")
+                        st->req.method_string(value);
+                    else if (name == ":path")
+                        st->req.target(value);
+                    else if (name == ":authority")
+                        st->req.set(http::field::host, value);
+                    else if (name != ":scheme")
+                        valid = false;
+                });
+            header_block.clear();
+            if (!ok)
+                return fail(compression_error);
+
+            if (!trailers) {
+                if (!valid || st->req.target().empty()) {
+                    reset(id, protocol_error);
+                    return true;
+                }
+                if (going_away || streams.size() >= opt.max_concurrent_streams) {
+                    reset(id, refused_stream);
+                    return true;
+                }
+                st->req.version(20);
+                streams.emplace(id, st);
+            }
+            else if (!(header_flags & end_stream)) {
+                reset(id, protocol_error);
+                return true;
+            }
+
+            if (header_flags & end_stream)
+                submit(st);
+            return true;
+        }
+
+        bool on_data(uint8_t flags, uint32_t id, const uint8_t* p, size_t size)
+        {
+            if (id == 0)
+                return fail(protocol_error);
+
+            // Data is consumed right away, give the window back
+            if (size)
+                window_update(0, uint32_t(size));
+
+            uint32_t frame_size = uint32_t(size);
+            if (!strip(flags, p, size, false))
+                return fail(protocol_error);
+
+            auto it = streams.find(id);
+            if (it == streams.end() || it->second->end_remote) {
+                if (id > last_stream)
+                    return fail(protocol_error);
+                reset(id, stream_closed);
+                return true;
+            }
+
+            auto st = it->second;
+            auto& body = st->req.body();
+            if (body.size() + size > opt.max_body_size) {
+                reset(id, cancel);
+                return true;
+            }
+            boost::asio::buffer_copy(body.prepare(size),
+                boost::asio::buffer(p, size));
+            body.commit(size);
+
+            if (flags & end_stream)
+                submit(st);
+            else if (frame_size)
+                window_update(id, frame_size);
+            return true;
+        }
+
+        bool on_window_update(uint32_t id, const uint8_t* p, size_t size)
+        {
+            if (size != 4)
+                return fail(frame_size_error);
+            uint32_t inc = read32(p) & 0x7fffffff;
+
+            if (id == 0) {
+                if (inc == 0)
+                    return fail(protocol_error);
+                send_window += inc;
+                if (send_window > max_window)
+                    return fail(flow_control_error);
+                flush_all();
+                return true;
+            }
+
+            auto it = streams.find(id);
+            if (it == streams.end())
+                return true;
+            auto st = it->second;
+            if (inc == 0 || st->window + inc > max_window) {
+                reset(id, inc ? flow_control_error : protocol_error);
+                return true;
+            }
+            st->window += inc;
+            flush(st);
+            return true;
+        }
+
+        // Request is complete, pass it to router
+        void submit(const stream_ptr& st)
+        {
+            st->end_remote = true;
+            auto& req = st->req;
+            if (req.body().size() && req.find(http::field::content_length) == req.end())
+                req.content_length(req.body().size());
+            dispatch_request(st);
+        }
+
+        template <class Fields>
+        void send_headers(const stream_ptr& st,
+            const http::header<false, Fields>& h, bool end)
+        {
+            std::string block;
+            hpack::encode_status(block, h.result_int());
+            std::string name;
+            for (auto& f : h) {
+                // Connection specific fields are not allowed
+                switch (f.name()) {
+                case http::field::connection:
+                case http::field::keep_alive:
+                case http::field::proxy_connection:
+                case http::field::transfer_encoding:
+                case http::field::upgrade:
+                    continue;
+                default:
+                    break;
+                }
+                auto n = f.name_string();
+                name.assign(n.data(), n.size());
+                std::transform(name.begin(), name.end(), name.begin(),
+                    [](char c) { return char(std::tolower(c)); });
+                hpack::encode(block, name, f.value());
+            }
+
+            // Split block to HEADERS and CONTINUATION frames
+            size_t pos = 0;
+            uint8_t type = headers_frame;
+            uint8_t flags = end ? end_stream : 0;
+            do {
+                size_t size = std::min(block.size() - pos, peer_frame_size);
+                if (pos + size == block.size())
+                    flags |= end_headers;
+                frame(type, flags, st->id, block.data() + pos, size);
+                pos += size;
+                type = continuation_frame;
+                flags = 0;
+            } while (pos < block.size());
+
+            st->headers_sent = true;
+            if (end) {
+                st->end_local = true;
+                finish(st);
+            }
+        }
+
+        // Send as much of response body as flow control allows
+        void flush(stream_ptr st)
+        {
+            while (st->data_sent < st->data.size() || st->end_pending) {
+                size_t left = st->data.size() - st->data_sent;
+                int64_t window = std::min(st->window, send_window);
+                size_t size = std::min(left, peer_frame_size);
+                size = std::min<size_t>(size, std::max<int64_t>(window, 0));
+                if (size == 0 && left > 0)
+                    break;
+
+                bool last = st->end_pending && size == left;
+                frame(data_frame, last ? end_stream : 0, st->id,
+                    st->data.data() + st->data_sent, size);
+                st->data_sent += size;
+                st->window -= size;
+                send_window -= size;
+                if (last) {
+                    st->end_pending = false;
+                    st->end_local = true;
+                }
+            }
+
+            if (st->data_sent == st->data.size()) {
+                st->data.clear();
+                st->data_sent = 0;
+            }
+            finish(st);
+        }
+
+        void flush_all()
+        {
+            for (auto it = streams.begin(); it != streams.end(); ) {
+                auto st = (it++)->second;
+                if (st->data_sent < st->data.size())
+                    flush(st);
+            }
+        }
+
+        // Forget stream when response is sent
+        void finish(const stream_ptr& st)
+        {
+            if (!st->end_local)
+                return;
+            streams.erase(st->id);
+            if (going_away && streams.empty()) {
+                closing = true;
+                write();
+            }
+        }
+
+        // Response of stream
+        void respond(const stream_ptr& st, const response_message& msg)
+        {
+            if (st->reset || st->headers_sent || closed)
+                return;
+
+            bool empty = msg.body().size() == 0;
+            send_headers(st, msg, empty);
+            if (empty)
+                return;
+
+            st->data.reserve(msg.body().size());
+            for (auto b : msg.body().data())
+                st->data.append(static_cast<const char*>(b.data()), b.size());
+            st->end_pending = true;
+            flush(st);
+        }
+
+        // Response of stream with shared body, copied as frames are
+        // flow controlled per stream
+        void respond(const stream_ptr& st, const shared_response_message& msg)
+        {
+            if (st->reset || st->headers_sent || closed)
+                return;
+
+            auto body = msg.body().data();
+            send_headers(st, msg, body.size() == 0);
+            if (body.size() == 0)
+                return;
+
+            st->data.append(static_cast<const char*>(body.data()), body.size());
+            st->end_pending = true;
+            flush(st);
+        }
+
+        // Response of stream written as serialized HTTP/1 message in parts
+        void respond_raw(const stream_ptr& st, boost::string_view chunk)
+        {
+            if (st->reset || st->end_pending || st->end_local || closed)
+                return;
+
+            if (st->headers_sent) {
+                st->data.append(chunk.data(), chunk.size());
+                flush(st);
+                return;
+            }
+
+            st->raw.append(chunk.data(), chunk.size());
+            size_t pos = st->raw.find("\r\n\r\n");
+            if (pos == std::string::npos)
+                return;
+
+            http::response_parser<http::empty_body> parser;
+            boost::beast::error_code ec;
+            parser.put(boost::asio::buffer(st->raw.data(), pos + 4), ec);
+            if (!parser.is_header_done()) {
+                reset(st->id, internal_error);
+                return;
+            }
+            send_headers(st, parser.get(), false);
+            st->data.append(st->raw, pos + 4, std::string::npos);
+            st->raw.clear();
+            flush(st);
+        }
+
+        // End response of stream
+        void end(const stream_ptr& st)
+        {
+            if (st->reset || st->end_pending || st->end_local || closed)
+                return;
+            if (!st->headers_sent) {
+                reset(st->id, internal_error);
+                return;
+            }
+            st->end_pending = true;
+            flush(st);
+        }
+
+    public:
+        http2_connection(const session_ptr& c, const http2_options& o,
+            dispatcher d)
+        : conn(c)
+        , strand(static_cast<boost::asio::io_context&>(
+            boost::asio::query(c->get_executor(),
+                boost::asio::execution::context)).get_executor())
+        , opt(o)
+        , dispatch_request(std::move(d))
+        { }
+
+        // Start connection where client sent the preface right away
+        // (prior knowledge)
+        void start()
+        {
+            auto s = shared_from_this();
+            boost::asio::dispatch(strand, [s] {
+                s->send_settings();
+                s->read();
+            });
+        }
+
+        // Start connection upgraded from HTTP/1.1 request. The request
+        // becomes the first stream. Unread is data received after the
+        // request, settings is value of HTTP2-Settings header.
+        void start(const request_message& req,
+            boost::asio::const_buffer unread, boost::string_view settings)
+        {
+            auto st = std::make_shared<http2_stream>(shared_from_this(), 1, 0);
+            st->req = req;
+            st->req.erase(http::field::upgrade);
+            st->req.erase(http::field::connection);
+            st->req.erase("HTTP2-Settings");
+
+            boost::asio::buffer_copy(in.prepare(unread.size()), unread);
+            in.commit(unread.size());
+
+            // Settings are base64url encoded payload of SETTINGS frame
+            std::string b64(settings.data(), settings.size());
+            std::replace(b64.begin(), b64.end(), '-', '+');
+            std::replace(b64.begin(), b64.end(), '_', '/');
+            std::string payload(
+                boost::beast::detail::base64::decoded_size(b64.size()), '\0');
+            auto n = boost::beast::detail::base64::decode(
+                &payload[0], b64.data(), b64.size());
+            payload.resize(n.first);
+
+            auto s = shared_from_this();
+            boost::asio::dispatch(strand, [s, st, payload] {
+                static const char switching[] =
+                    "HTTP/1.1 101 Switching Protocols\r\n"
+                    "Connection: Upgrade\r\n"
+                    "Upgrade: h2c\r\n\r\n";
+                s->out.append(switching, sizeof(switching) - 1);
+                s->send_settings();
+
+                if (payload.size() % 6) {
+                    s->fail(protocol_error);
+                    return;
+                }
+                if (!s->apply_settings(
+                    reinterpret_cast<const uint8_t*>(payload.data()),
+                    payload.size()))
+                    return;
+
+                st->window = s->peer_window;
+                s->last_stream = 1;
+                s->streams.emplace(1, st);
+                s->submit(st);
+
+                if (s->process())
+                    s->read();
+            });
+        }
+    };
+
+    inline http2_stream::executor_type http2_stream::get_executor() {
+        return owner->strand;
+    }
+
+    inline tcp::socket* http2_stream::socket() {
+        return owner->conn->socket();
+    }
+
+    inline void http2_stream::async_read(boost::beast::flat_buffer&,
+        request_message& msg, handler h)
+    {
+        // Request is already received by connection
+        msg = std::move(req);
+        boost::asio::post(owner->strand, [h] { h({ }); });
+    }
+
+    inline void http2_stream::async_read_some(
+        boost::asio::mutable_buffer, read_handler h)
+    {
+        boost::asio::post(owner->strand, [h] {
+            h(boost::asio::error::operation_not_supported, 0);
+        });
+    }
+
+    inline void http2_stream::async_write(response_message& msg, handler h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st, &msg, h] {
+            st->owner->respond(st, msg);
+            h({ });
+        });
+    }
+
+    inline void http2_stream::async_write(shared_response_message& msg, handler h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st, &msg, h] {
+            st->owner->respond(st, msg);
+            h({ });
+        });
+    }
+
+    inline void http2_stream::async_write(boost::asio::const_buffer buf, handler h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        std::string chunk(static_cast<const char*>(buf.data()), buf.size());
+        boost::asio::dispatch(owner->strand, [st, chunk, h] {
+            st->owner->respond_raw(st, chunk);
+            h({ });
+        });
+    }
+
+    inline void http2_stream::shutdown()
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st] {
+            st->owner->end(st);
+        });
+    }
+
+    inline void http2_stream::on_disconnect(std::function<void()> h)
+    {
+        auto st = std::static_pointer_cast<http2_stream>(shared_from_this());
+        boost::asio::dispatch(owner->strand, [st, h] {
+            if (st->reset)
+                h();
+            else
+                st->disconnected = h;
+        });
+    }
+
+} // namespace rest
+
+// end of rest/http2.hpp
+
+// beginning of rest/mime_type.hpp
+
+namespace rest {
+
+    struct mime_type {
+        using table_type =
+            std::map<boost::string_view, boost::string_view, boost::beast::iless>;
+
+    private:
+        struct entry {
+            const char* ext;
+            const char* type;
+        };
+
+        struct slot {
+            boost::string_view ext;
+            boost::string_view type;
+        };
+
+        template <size_t...>
+        struct sequence { };
+
+        template <size_t N, size_t... I>
+        struct make_sequence : make_sequence<N - 1, N - 1, I...> { };
+
+        template <size_t... I>
+        struct make_sequence<0, I...> {
+            using type = sequence<I...>;
+        };
+
+        // Built-in types, extensions without dot in lower case. Placed
+        // in a table of slots by hash at compile time. When adding a type
+        // the hash may need new factors to stay free of collisions.
+        template <class = void>
+        struct builtin {
+            static constexpr entry list[] = {
+                { "bmp",   "image/bmp" },
+                { "css",   "text/css" },
+                { "flv",   "video/x-flv" },
+                { "gif",   "image/gif" },
+                { "htm",   "text/html" },
+                { "html",  "text/html" },
+                { "ico",   "image/vnd.microsoft.icon" },
+                { "jpe",   "image/jpeg" },
+                { "jpeg",  "image/jpeg" },
+                { "jpg",   "image/jpeg" },
+                { "js",    "application/javascript" },
+                { "json",  "application/json" },
+                { "php",   "text/html" },
+                { "png",   "image/png" },
+                { "svg",   "image/svg+xml" },
+                { "svgz",  "image/svg+xml" },
+                { "swf",   "application/x-shockwave-flash" },
+                { "tif",   "image/tiff" },
+                { "tiff",  "image/tiff" },
+                { "txt",   "text/plain" },
+                { "xml",   "application/xml" },
+            };
+            static constexpr size_t size = sizeof(list) / sizeof(list[0]);
+            static constexpr size_t slots = 32;
+
+            static constexpr char lower(char c) noexcept {
+                return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
+            }
+
+            static constexpr size_t length(const char* s) noexcept {
+                return *s ? 1 + length(s + 1) : 0;
+            }
+
+            // Case-insensitive, extension of at least 2 characters
+            static constexpr size_t hash(const char* s, size_t n) noexcept {
+                return (size_t(lower(s[0])) * 6 + size_t(lower(s[1])) * 14 +
+                    size_t(lower(s[n - 1])) * 15 + n * 7) % slots;
+            }
+
+            static constexpr size_t hash(size_t i) noexcept {
+                return hash(list[i].ext, length(list[i].ext));
+            }
+
+            // Number of extensions with hash h
+            static constexpr size_t count(size_t h, size_t i = 0) noexcept {
+                return i == size ? 0 : (hash(i) == h) + count(h, i + 1);
+            }
+
+            static constexpr bool perfect(size_t h = 0) noexcept {
+                return h == slots || (count(h) <= 1 && perfect(h + 1));
+            }
+
+            // Index of extension with hash h, size if none
+            static constexpr size_t find(size_t h, size_t i = 0) noexcept {
+                return i == size || hash(i) == h ? i : find(h, i + 1);
+            }
+
+            static constexpr slot make(size_t i) noexcept {
+                return i == size ? slot { { }, { } } : slot {
+                    { list[i].ext, length(list[i].ext) },
+                    { list[i].type, length(list[i].type) } };
+            }
+
+            template <size_t... H>
+            static const slot* table(sequence<H...>) noexcept {
+                static const slot t[] = { make(find(H))... };
+                return t;
+            }
+
+            static const slot* table() noexcept {
+                static_assert(perfect(), "collision in hash of mime types");
+                return table(typename make_sequence<slots>::type());
+            }
+        };
+
+        // Extension of file name including dot, empty if none
+        static boost::string_view extension(const fs::path& filename) noexcept
+        {
+            boost::string_view name(filename.native());
+            auto slash = name.rfind('/');
+            if (slash != boost::string_view::npos)
+                name.remove_prefix(slash + 1);
+            if (name == "." || name == "..")
+                return { };
+            auto dot = name.rfind('.');
+            return dot == boost::string_view::npos ?
+                boost::string_view() : name.substr(dot);
+        }
+
+    public:
+        // Types added or replaced by user, checked before the built-in
+        // ones. Lookup is case-insensitive.
+        // Extend example:
+        //   rest::mime_type::table().emplace(".mp4", "video/mp4");
+        // Modify example:
+        //   rest::mime_type::table()[".js"] = "text/javascript";
+        static table_type& table() noexcept {
+            static table_type t;
+            return t;
+        }
+
+        // Default type to be returned on no match. Change it by
+        // assigning, example:
+        //   rest::mime_type::default_type() = "text/plain";
+        static boost::string_view& default_type() noexcept {
+            static boost::string_view t { "application/octet-stream" };
+            return t;
+        }
+
+        // Return a reasonable mime type based on the extension of a file
+        static const boost::string_view& resolve(const fs::path& filename) noexcept
+        {
+            auto ext = extension(filename);
+            if (ext.empty())
+                return default_type();
+
+            const table_type& t = table();
+            if (!t.empty()) {
+                auto it = t.find(ext);
+                if (it != t.end())
+                    return it->second;
+            }
+
+            ext.remove_prefix(1);
+            if (ext.size() >= 2) {
+                auto& s = builtin<>::table()[builtin<>::hash(ext.data(), ext.size())];
+                if (boost::beast::iequals(s.ext, ext))
+                    return s.type;
+            }
+            return default_type();
+        }
+
+        // Pre-initialize static structures (optional)
+        mime_type() noexcept {
+            table();
+            default_type();
+            builtin<>::table();
+        }
+    };
+
+    template <class T>
+    constexpr mime_type::entry mime_type::builtin<T>::list[];
+
+} // namespace rest
+
+// end of rest/mime_type.hpp
+
+// beginning of rest/offload.hpp
+
+#include <boost/asio/thread_pool.hpp>
+#include <thread>
+
+namespace rest {
+
+    // Bounded pool of worker threads for CPU heavy handlers
+    struct offload_pool {
+    private:
+        boost::asio::thread_pool pool;
+        // Jobs waiting for a worker thread, running ones not counted
+        std::atomic<size_t> queued { 0 };
+        const size_t max_queued;
+
+    public:
+        offload_pool(size_t threads = std::thread::hardware_concurrency(),
+            size_t max_queue = 1024)
+        : pool(threads ? threads : 1)
+        , max_queued(max_queue)
+        { }
+
+        // Queue a job. Return false if there are already max_queue
+        // jobs waiting for a worker thread.
+        bool post(std::function<void()> job) {
+            if (queued.fetch_add(1) >= max_queued) {
+                --queued;
+                return false;
+            }
+            boost::asio::post(pool, [this, job] {
+                --queued;
+                job();
+            });
+            return true;
+        }
+
+        // Number of jobs waiting for a worker thread
+        size_t size() const noexcept {
+            return queued;
+        }
+
+        // Wait for all jobs to complete, pool can not be used after this
+        void join() {
+            pool.join();
+        }
+
+        // Default pool with a thread per core
+        static offload_pool& instance() {
+            static offload_pool p;
+            return p;
+        }
+    };
+
+    // Run handler on a worker thread of pool instead of the connection
+    // thread. The response may be sent from the handler, it is written
+    // on the connection executor. Calling next (synchronously) continues
+    // the chain on connection executor as well. If pool queue is full
+    // the request is responded with "503 Service Unavailable".
+    inline req_resp_next offload(
+        req_resp_next handler, offload_pool& pool = offload_pool::instance())
+    {
+        auto h = std::make_shared<req_resp_next>(std::move(handler));
+        auto p = &pool;
+
+        return [h, p](const request& req, response& resp, next& n) {
+            request rq = req;
+            response rs = resp;
+            next parent = n;
+
+            bool queued = p->post([h, rq, rs, parent]() mutable {
+                // Client went away while job was queued
+                if (rq.cancelled())
+                    return;
+
+                next local;
+                bool proceed = local.safe_invoke([&] { (*h)(rq, rs, local); });
+                if (!proceed)
+                    return;
+
+                error err = local.err();
+                boost::asio::post(rq.connection()->get_executor(),
+                    [parent, err]() mutable {
+                        if (err)
+                            parent(std::move(err));
+                        else
+                            parent();
+                    });
+            });
+
+            if (!queued)
+                resp.status(503).send();
+        };
+    }
+
+    inline req_resp_next offload(
+        req_resp handler, offload_pool& pool = offload_pool::instance())
+    {
+        return offload(req_resp_next(
+            [handler](const request& req, response& resp, next&) {
+                handler(req, resp);
+            }), pool);
+    }
+
+} // namespace rest
+
+// end of rest/offload.hpp
+
+// beginning of rest/rate_limit.hpp
+
+#include <stdexcept>
+#include <string>
+
+namespace rest {
+
+    struct rate_limit_options {
+        // Tokens added to client bucket per second, i.e. sustained
+        // number of requests per second. Must be greater than 0.
+        double rate = 10;
+
+        // Bucket size, i.e. number of requests allowed in a burst.
+        // Maximum is 65535.
+        unsigned burst = 20;
+
+        // Header holding client key (ex. API key). If empty or header is
+        // not present in request the remote address is used.
+        std::string header;
+
+        // Maximum number of clients tracked at the same time. Memory is
+        // allocated once, 16 bytes per client.
+        size_t capacity = 65536;
+    };
+
+    struct rate_limit {
+    private:
+        // Bucket state is packed in one 64-bit word to be updated with
+        // compare-and-swap:
+        //   bits 63..24 - time of last update in ms since table creation
+        //   bits 23..0  - tokens in 1/256 units
+        // Zero state means unused (full) bucket.
+        struct slot {
+            std::atomic<uint64_t> key;
+            std::atomic<uint64_t> state;
+        };
+
+        // Slots probed for a key, one cache line
+        static constexpr size_t probe_size = 4;
+        static constexpr uint64_t token = 256;
+
+        struct table {
+            using clock = std::chrono::steady_clock;
+
+            const clock::time_point epoch = clock::now();
+            const size_t mask;
+            std::unique_ptr<slot[]> slots;
+
+            table(size_t capacity)
+            : mask(round_up(capacity) - 1)
+            , slots(new slot[mask + 1]())
+            { }
+
+            static size_t round_up(size_t n) {
+                size_t p = probe_size;
+                while (p < n)
+                    p <<= 1;
+                return p;
+            }
+
+            // Milliseconds since table creation, never 0
+            uint64_t now() const {
+                return std::chrono::duration_cast<std::chrono::milliseconds>(
+                    clock::now() - epoch).count() + 1;
+            }
+
+            // Find slot of the key or take a free one. A slot of other
+            // key is reused (evicted) if its bucket is full again or if
+            // it is the least recently used one among probed slots.
+            slot& find(uint64_t key, uint64_t now, uint64_t idle_ms)
+            {
+                slot* group = &slots[key & mask & ~(probe_size - 1)];
+                slot* victim = nullptr;
+                uint64_t oldest = ~uint64_t(0);
+
+                for (size_t i = 0; i < probe_size; ++i) {
+                    slot& s = group[i];
+                    uint64_t k = s.key.load(std::memory_order_acquire);
+                    if (k == key)
+                        return s;
+
+                    // Another thread may have stored a time later than now
+                    uint64_t ts = s.state.load(std::memory_order_relaxed) >> 24;
+                    if (k == 0 || now - std::min(now, ts) >= idle_ms)
+                        ts = 0;
+                    if (ts < oldest) {
+                        oldest = ts;
+                        victim = &s;
+                    }
+                }
+
+                uint64_t k = victim->key.load(std::memory_order_relaxed);
+                if (victim->key.compare_exchange_strong(k, key))
+                    victim->state.store(0, std::memory_order_release);
+                // Another thread took the slot at the same time, share
+                // it rather than probe again
+                return *victim;
+            }
+        };
+
+        std::shared_ptr<table> tbl;
+        const rate_limit_options opt;
+
+        static uint64_t hash(const void* data, size_t size) noexcept {
+            // FNV-1a
+            uint64_t h = 14695981039346656037ull;
+            auto p = static_cast<const unsigned char*>(data);
+            for (size_t i = 0; i < size; ++i)
+                h = (h ^ p[i]) * 1099511628211ull;
+            return h ? h : 1;
+        }
+
+        uint64_t client_key(const request& req) const
+        {
+            if (!opt.header.empty()) {
+                auto value = req.get(boost::string_view(opt.header));
+                if (value)
+                    return hash(value->data(), value->size());
+            }
+
+            // Clients of Unix domain socket share one bucket
+            auto sock = req.socket();
+            if (!sock)
+                return hash(nullptr, 0);
+
+            boost::system::error_code ec;
+            auto addr = sock->remote_endpoint(ec).address();
+            if (addr.is_v4()) {
+                auto bytes = addr.to_v4().to_bytes();
+                return hash(bytes.data(), bytes.size());
+            }
+            auto bytes = addr.to_v6().to_bytes();
+            return hash(bytes.data(), bytes.size());
+        }
+
+    public:
+        rate_limit(rate_limit_options options = { })
+        : tbl(std::make_shared<table>(options.capacity))
+        , opt(std::move(options))
+        {
+            if (!(opt.rate > 0))
+                throw std::invalid_argument("rate_limit: rate must be greater than 0");
+        }
+
+        // Take a token from bucket of the key. Return 0 if request is
+        // allowed, otherwise number of milliseconds until next token.
+        uint64_t take(uint64_t key) const
+        {
+            const uint64_t burst = std::min(opt.burst, 65535u) * token;
+            const double per_ms = opt.rate * token / 1000;
+            // Time for empty bucket to become full
+            const uint64_t idle_ms = uint64_t(burst / per_ms) + 1;
+
+            uint64_t now = tbl->now();
+            slot& s = tbl->find(key, now, idle_ms);
+
+            uint64_t state = s.state.load(std::memory_order_acquire);
+            for (;;) {
+                uint64_t tokens = burst;
+                if (state) {
+                    uint64_t elapsed = now - std::min(now, state >> 24);
+                    tokens = std::min(burst,
+                        (state & 0xffffff) + uint64_t(elapsed * per_ms));
+                }
+
+                if (tokens < token)
+                    return uint64_t(std::ceil((token - tokens) / per_ms));
+
+                uint64_t desired = (now << 24) | (tokens - token);
+                if (s.state.compare_exchange_weak(state, desired))
+                    return 0;
+            }
+        }
+
+        void operator()(const request& req, response& resp, next& n) const
+        {
+            uint64_t wait_ms = take(client_key(req));
+            if (!wait_ms) {
+                n();
+                return;
+            }
+
+            resp.set(http::field::retry_after,
+                std::to_string((wait_ms + 999) / 1000));
+            resp.status(429).send();
+        }
+    };
+
+} // namespace rest
+
+// end of rest/rate_limit.hpp
+
+// beginning of rest/server.hpp
+
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+#include <boost/asio/read.hpp>
+#include <cerrno>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+#endif
+
+namespace rest {
+
+    struct server_options {
+        // Maximum number of connections accepted at once when the
+        // listening socket becomes ready
+        size_t accept_batch = 16;
+
+        // Disable Nagle's algorithm on accepted TCP connections
+        bool no_delay = true;
+
+        // Seconds to wait for the first data of client before the
+        // connection is accepted (Linux TCP_DEFER_ACCEPT). Idle connects
+        // do not take a session. 0 disables.
+        int defer_accept = 0;
+
+        // Length of queue of pending TCP Fast Open requests, allowing
+        // data in SYN of returning clients. 0 disables.
+        int fast_open = 0;
+
+        // Size of socket buffers of TCP connections, 0 is system default
+        int receive_buffer_size = 0;
+        int send_buffer_size = 0;
+    };
+
+    struct server : router {
+    private:
+        boost::asio::io_context& ioc;
+        boost::asio::io_context& session_ioc;
+        const server_options opt;
+        std::list<tcp::acceptor> acceptors;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        std::list<local::stream_protocol::acceptor> local_acceptors;
+
+        // Environment variable telling descriptor of handover socket
+        static const char* handover_env() noexcept {
+            return "REST_HANDOVER_FD";
+        }
+#endif
+        // Not null if HTTP/2 is enabled
+        std::shared_ptr<const http2_options> h2;
+
+        // Loop accepting new connections until acceptor is closed
+        template <class Acceptor>
+        void accept(Acceptor& acceptor) {
+            // Batch is taken with non-blocking accept
+            if (accept_batch() > 1)
+                acceptor.non_blocking(true);
+            acceptor.async_accept(session_ioc,
+                [this, &acceptor](boost::beast::error_code ec,
+                    typename Acceptor::protocol_type::socket sock)
+                {
+                    if (ec == boost::asio::error::operation_aborted)
+                        return;
+                    if (!ec) {
+                        accepted(sock);
+                        start(std::move(sock));
+                        // Take other pending connections without waiting
+                        // for readiness again
+                        for (size_t i = 1; i < accept_batch(); ++i) {
+                            typename Acceptor::protocol_type::socket
+                                next(session_ioc);
+                            if (acceptor.accept(next, ec))
+                                break;
+                            accepted(next);
+                            start(std::move(next));
+                        }
+                    }
+                    accept(acceptor);
+                });
+        }
+
+        // With io_uring every accept is a submitted operation, there
+        // is no readiness to save
+        size_t accept_batch() const noexcept {
+#if defined(REST_IO_URING)
+            return 1;
+#else
+            return opt.accept_batch;
+#endif
+        }
 
-            void operator()(req_resp& cb) const {
-                cb(req, resp);
+        // Set options of listening socket before listen, accepted
+        // sockets inherit buffer sizes
+        void configure(tcp::acceptor& acceptor)
+        {
+            if (opt.receive_buffer_size > 0) {
+                acceptor.set_option(tcp::socket::receive_buffer_size(
+                    opt.receive_buffer_size));
             }
-            void operator()(req_resp_next& cb) const {
-                cb(req, resp, n);
+            if (opt.send_buffer_size > 0) {
+                acceptor.set_option(tcp::socket::send_buffer_size(
+                    opt.send_buffer_size));
             }
-            void operator()(router& r) const {
-                r.handle_request(req, resp, n);
+#if defined(TCP_DEFER_ACCEPT)
+            if (opt.defer_accept > 0) {
+                acceptor.set_option(boost::asio::detail::socket_option::integer<
+                    IPPROTO_TCP, TCP_DEFER_ACCEPT>(opt.defer_accept));
             }
-        };
+#endif
+#if defined(TCP_FASTOPEN)
+            if (opt.fast_open > 0) {
+                acceptor.set_option(boost::asio::detail::socket_option::integer<
+                    IPPROTO_TCP, TCP_FASTOPEN>(opt.fast_open));
+            }
+#endif
+        }
 
-        struct impl {
-            std::vector<route> routes;
-            std::vector<error_handler> errors;
-            std::map<std::string, param_handler> params;
-        };
+        void accepted(tcp::socket& sock) {
+            boost::system::error_code ec;
+            if (opt.no_delay)
+                sock.set_option(tcp::no_delay(true), ec);
+        }
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        void accepted(local::stream_protocol::socket&) { }
+#endif
 
-        std::shared_ptr<impl> self;
+    protected:
+        // Start session on accepted connection
+        virtual void start(tcp::socket&& sock) {
+            auto conn = std::make_shared<tcp_session>(std::move(sock));
+            if (h2)
+                detect_protocol(conn);
+            else
+                process_client(conn);
+        }
 
-        void handle_error(request&, response&, next&);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        virtual void start(local::stream_protocol::socket&& sock) {
+            auto conn = std::make_shared<unix_session>(std::move(sock));
+            if (h2)
+                detect_protocol(conn);
+            else
+                process_client(conn);
+        }
+#endif
 
-    protected:
-        void handle_request(request&, response&, next&);
+        // Receive and process a request
+        void process_client(const session_ptr& conn)
+        {
+            request::receive(conn, [this](request& req) {
+                if (h2 && upgrade_http2(req))
+                    return;
 
-    public:
-        router() noexcept
-        : self(std::make_shared<impl>())
-        { }
+                req.app(this);
+                req.path(req.original_url());
+                req.watch();
 
-        virtual ~router() { }
+                response resp(req);
+                next n;
 
-        // Error handler called on next(error) or in case of exception
-        void use(error_handler&& handler) noexcept {
-            self->errors.emplace_back(std::forward<error_handler>(handler));
+                handle_request(req, resp, n, [this, req, resp, n]() mutable {
+                    finish(req, resp, n);
+                });
+            });
         }
 
-        // Matches all HTTP methods and any path
-        void use(route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::use, std::forward<route_handler>(handler));
+    private:
+        // Tell HTTP/2 preface from HTTP/1 request by peeking at the first
+        // bytes of connection, no HTTP/1 method starts with "PRI"
+        template <class Session>
+        void detect_protocol(const std::shared_ptr<Session>& conn)
+        {
+            conn->stream.async_wait(Session::stream_type::wait_read,
+                [this, conn](boost::beast::error_code ec) {
+                    if (ec)
+                        return;
+                    char buf[3];
+                    size_t n = conn->stream.receive(boost::asio::buffer(buf),
+                        Session::stream_type::message_peek, ec);
+                    if (ec || n == 0)
+                        return;
+
+                    auto preface = http2_connection::preface();
+                    if (std::memcmp(buf, preface.data(), n) != 0)
+                        process_client(conn);
+                    else if (n == sizeof(buf))
+                        std::make_shared<http2_connection>(
+                            conn, *h2, stream_dispatcher())->start();
+                    else {
+                        // Wait for more data
+                        auto t = std::make_shared<boost::asio::steady_timer>(
+                            conn->get_executor(), std::chrono::milliseconds(1));
+                        t->async_wait([this, conn, t](boost::beast::error_code) {
+                            detect_protocol(conn);
+                        });
+                    }
+                });
         }
 
-        // Matches all HTTP methods on specified mount (leading) path
-        void use(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::use,
-                std::forward<route_handler>(handler),
-                path);
+        // Switch to HTTP/2 if requested by "Upgrade: h2c". Not available
+        // over TLS.
+        bool upgrade_http2(const request& req)
+        {
+            auto& conn = req.connection();
+            bool plain = std::dynamic_pointer_cast<tcp_session>(conn) != nullptr;
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+            plain = plain || std::dynamic_pointer_cast<unix_session>(conn);
+#endif
+            auto upgrade = req.get(http::field::upgrade);
+            auto settings = req.get("HTTP2-Settings");
+            if (!plain || !upgrade || !settings ||
+                !http::token_list(*upgrade).exists("h2c"))
+                return false;
+
+            std::make_shared<http2_connection>(conn, *h2, stream_dispatcher())
+                ->start(req.message(), req.unread(), *settings);
+            return true;
         }
 
-        // Matches all HTTP methods (verbs). Same as 'use' but matches path exactly.
-        void all(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::all,
-                std::forward<route_handler>(handler),
-                path);
+        // Requests of HTTP/2 streams are processed as any other
+        http2_connection::dispatcher stream_dispatcher() {
+            return [this](const session_ptr& stream) {
+                process_client(stream);
+            };
         }
 
-        // Matches HTTP GET
-        void get(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::get);
+        // Respond to request that fell through all routes without
+        // being completed
+        void finish(const request& req, response& resp, const next& n)
+        {
+            if (resp.is_sent())
+                return;
+
+            if (n.err()) {
+                auto status = n.err().status();
+                resp.status(status != http::status::unknown ?
+                    static_cast<unsigned>(status) : 500).send();
+                return;
+            }
+
+            // Path exists but not for this method
+            auto allow = allowed(req);
+            if (!allow.empty()) {
+                resp.set(http::field::allow, allow);
+                resp.status(405).send();
+                return;
+            }
+            resp.status(404).send();
         }
 
-        // Matches HTTP PUT
-        void put(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::put);
+    public:
+        server(boost::asio::io_context& ioc,
+            server_options options = { }) noexcept
+        : ioc(ioc)
+        , session_ioc(ioc)
+        , opt(std::move(options))
+        { }
+
+        // Accept on ioc, run sessions (connections) on session_ioc
+        server(boost::asio::io_context& ioc,
+            boost::asio::io_context& session_ioc,
+            server_options options = { }) noexcept
+        : ioc(ioc)
+        , session_ioc(session_ioc)
+        , opt(std::move(options))
+        { }
+
+        // Accept HTTP/2 without TLS (h2c) besides HTTP/1.1. Connection
+        // is HTTP/2 if it starts with the preface (prior knowledge) or
+        // is upgraded by "Upgrade: h2c" request.
+        void http2(const http2_options& options = { }) {
+            h2 = std::make_shared<const http2_options>(options);
         }
 
-        // Matches HTTP POST
-        void post(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::post);
+        // Listen may be called several times to accept on more than
+        // one endpoint
+        void listen(tcp::endpoint endp) {
+            acceptors.emplace_back(ioc);
+            auto& acceptor = acceptors.back();
+            acceptor.open(endp.protocol());
+            acceptor.set_option(tcp::acceptor::reuse_address(true));
+            configure(acceptor);
+            acceptor.bind(endp);
+            acceptor.listen();
+            accept(acceptor);
         }
 
-        // Matches HTTP DELETE
-        void del(boost::string_view path, route_handler&& handler) noexcept {
-            self->routes.emplace_back(
-                route_type::method,
-                std::forward<route_handler>(handler),
-                path,
-                http::verb::delete_);
+        void listen(uint16_t port) {
+            listen(tcp::endpoint(boost::asio::ip::address(), port));
         }
 
-        // Parameteter handler called whenever triggered path contains
-        // matched named parameter
-        void param(std::string name, param_handler&& handler) noexcept {
-            self->params.emplace(
-                std::move(name), std::forward<param_handler>(handler));
+        void listen(uint16_t port, const char* ip) {
+            listen(tcp::endpoint(boost::asio::ip::make_address(ip), port));
         }
-    };
 
-    struct route
-    {
-        route_type type;
-        http::verb method; // used only for route_type::method
-        path uri;
-        route_handler handler;
+        // Stop accepting new connections. Connections in progress are
+        // served until done.
+        void close()
+        {
+            boost::asio::dispatch(ioc, [this] {
+                boost::system::error_code ec;
+                for (auto& a : acceptors)
+                    a.close(ec);
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+                for (auto& a : local_acceptors)
+                    a.close(ec);
+#endif
+            });
+        }
 
-        route(route_type rt, route_handler&& rh,
-            boost::string_view u = "/", http::verb mtd = http::verb::unknown) noexcept
-        : type(rt)
-        , method(mtd)
-        , uri(u)
-        , handler(std::forward<route_handler>(rh))
-        { }
+#if defined(BOOST_ASIO_HAS_LOCAL_SOCKETS)
+        // Listen on Unix domain socket. Socket file left by previous
+        // run is removed.
+        void listen(const local::stream_protocol::endpoint& endp) {
+            boost::system::error_code ec;
+            if (fs::status(endp.path(), ec).type() == fs::socket_file)
+                fs::remove(endp.path(), ec);
 
-        boost::string_view match(const request& req) const {
-            // Check method if handler type is method
-            if (type == route_type::method && method != req.method())
-                return { };
+            local_acceptors.emplace_back(ioc, endp);
+            accept(local_acceptors.back());
+        }
 
-            std::cmatch cm;
-            if (!uri.match(req.path(), cm))
-                return { };
+        // Listen on an already bound socket, e.g. inherited from parent
+        // process. TCP and Unix domain sockets are supported.
+        // Options of the listening socket are left as set by its owner.
+        void listen_fd(int fd)
+        {
+            sockaddr_storage addr;
+            socklen_t size = sizeof(addr);
+            if (::getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &size) != 0) {
+                throw boost::system::system_error(
+                    errno, boost::system::system_category(), "getsockname");
+            }
 
-            size_t msize = cm.length(0);
-            if (type != route_type::use && msize != req.path().size()) {
-                // For non-use routes uri must match exactly
-                return { };
+            int listening = 0;
+            size = sizeof(listening);
+            ::getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &size);
+
+            if (addr.ss_family == AF_UNIX) {
+                local_acceptors.emplace_back(ioc, local::stream_protocol(), fd);
+                if (!listening)
+                    local_acceptors.back().listen();
+                accept(local_acceptors.back());
+                return;
             }
 
-            return req.path().substr(0, msize);
+            acceptors.emplace_back(ioc,
+                addr.ss_family == AF_INET6 ? tcp::v6() : tcp::v4(), fd);
+            if (!listening)
+                acceptors.back().listen();
+            accept(acceptors.back());
         }
-    };
 
-    void router::handle_error(request& req, response& resp, next& next)
-    {
-        for (auto& handler : self->errors) {
-            if (!next.safe_invoke([&] { handler(next.err(), req, resp, next); }))
-                break;
+        // Listen on sockets passed by service manager (systemd socket
+        // activation, LISTEN_FDS). Return number of sockets.
+        size_t listen_activated()
+        {
+            const char* pid = std::getenv("LISTEN_PID");
+            const char* fds = std::getenv("LISTEN_FDS");
+            if (!pid || !fds || std::atol(pid) != long(::getpid()))
+                return 0;
+
+            // Passed sockets start after stdin, stdout and stderr
+            int n = std::atoi(fds);
+            for (int fd = 3; fd < 3 + n; ++fd)
+                listen_fd(fd);
+            return n > 0 ? size_t(n) : 0;
         }
-    }
 
-    void router::handle_request(request& req, response& resp, next& next)
-    {
-        for (auto& route : self->routes) {
-            boost::string_view uri_match = route.match(req);
-            if (uri_match.empty())
-                continue;
+        using restart_handler = std::function<void(boost::system::error_code)>;
 
-            // Update request fields
-            req.base_url(uri_match);
-            // Make sure leading '/' is present
-            req.path(req.path().substr(
-                uri_match.size() == 1 ? 0 : uri_match.size()));
-            if (req.path().empty())
-                req.path({ "/", 1 });
-
-            // Add params to request
-            for (auto& p : route.uri.get_params(uri_match)) {
-                if (req.params().emplace(p).second) {
-                    // The insertion took place, use this fact to call param
-                    // callback once per request-response cycle
-                    auto it = self->params.find(p.first);
-                    if (it != self->params.end()) {
-                        if (!next.safe_invoke([&] {
-                            it->second(req, resp, next, p.second); }))
-                            return;
-                        if (next.err()) {
-                            handle_error(req, resp, next);
-                            return;
-                        }
+        // Start program (usually a new version of this one) and hand
+        // listening sockets over to it. The new process takes them with
+        // listen_handover(). When it is ready this server stops accepting
+        // and finishes connections in progress. Sockets stay open during
+        // the handover, no connection is refused. Handler is called when
+        // the new process took over or failed to.
+        void hot_restart(const std::string& program,
+            const std::vector<std::string>& args, restart_handler handler = { })
+        {
+            int sv[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+                throw boost::system::system_error(
+                    errno, boost::system::system_category(), "socketpair");
+            }
+
+            std::vector<char*> argv;
+            argv.push_back(const_cast<char*>(program.c_str()));
+            for (auto& a : args)
+                argv.push_back(const_cast<char*>(a.c_str()));
+            argv.push_back(nullptr);
+
+            // Environment of this process with handover socket, which is
+            // descriptor 3 of child. Built before fork, environment of
+            // this process is not modified.
+            std::string handover = std::string(handover_env()) + "=3";
+            std::vector<char*> envp;
+            for (char** e = environ; *e; ++e) {
+                if (std::strncmp(*e, handover.c_str(), handover.size() - 1) != 0)
+                    envp.push_back(*e);
+            }
+            envp.push_back(const_cast<char*>(handover.c_str()));
+            envp.push_back(nullptr);
+
+            rlimit lim;
+            int max_fd = ::getrlimit(RLIMIT_NOFILE, &lim) == 0 &&
+                lim.rlim_cur != RLIM_INFINITY ? int(lim.rlim_cur) : 65536;
+
+            pid_t pid = ::fork();
+            if (pid == 0) {
+                // Child keeps only standard streams and handover socket,
+                // other descriptors are not inherited
+                if (sv[1] == 3)
+                    ::fcntl(3, F_SETFD, 0);
+                else
+                    ::dup2(sv[1], 3);
+#if defined(SYS_close_range)
+                if (::syscall(SYS_close_range, 4u, ~0u, 0u) != 0)
+#endif
+                for (int fd = 4; fd < max_fd; ++fd)
+                    ::close(fd);
+                ::execve(program.c_str(), argv.data(), envp.data());
+                ::_exit(127);
+            }
+            ::close(sv[1]);
+            if (pid < 0) {
+                ::close(sv[0]);
+                throw boost::system::system_error(
+                    errno, boost::system::system_category(), "fork");
+            }
+
+            // Send descriptors of listening sockets
+            std::vector<int> fds;
+            for (auto& a : acceptors)
+                if (a.is_open())
+                    fds.push_back(a.native_handle());
+            for (auto& a : local_acceptors)
+                if (a.is_open())
+                    fds.push_back(a.native_handle());
+
+            char data = 'h';
+            iovec iov { &data, 1 };
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * fds.size()));
+            msghdr msg { };
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            if (!fds.empty()) {
+                msg.msg_control = control.data();
+                msg.msg_controllen = control.size();
+                cmsghdr* c = CMSG_FIRSTHDR(&msg);
+                c->cmsg_level = SOL_SOCKET;
+                c->cmsg_type = SCM_RIGHTS;
+                c->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+                std::memcpy(CMSG_DATA(c), fds.data(), sizeof(int) * fds.size());
+            }
+            ssize_t sent;
+            do
+                sent = ::sendmsg(sv[0], &msg, MSG_NOSIGNAL);
+            while (sent < 0 && errno == EINTR);
+            if (sent != 1) {
+                // New process did not get the sockets, do not leave it
+                // waiting for them
+                int err = errno;
+                ::close(sv[0]);
+                ::kill(pid, SIGKILL);
+                ::waitpid(pid, nullptr, 0);
+                throw boost::system::system_error(
+                    err, boost::system::system_category(), "sendmsg");
+            }
+
+            // Wait for the new process to accept
+            auto sock = std::make_shared<local::stream_protocol::socket>(
+                ioc, local::stream_protocol(), sv[0]);
+            auto ack = std::make_shared<char>();
+            boost::asio::async_read(*sock, boost::asio::buffer(ack.get(), 1),
+                [this, sock, ack, pid, handler](boost::system::error_code ec, size_t) {
+                    if (!ec) {
+                        close();
+                        // Reap the new process if it exits while this one
+                        // still runs, without keeping io_context busy
+                        std::thread([pid] { ::waitpid(pid, nullptr, 0); }).detach();
                     }
+                    else if (ec != boost::asio::error::operation_aborted) {
+                        // New process failed to take over, make sure it
+                        // does not serve the sockets too, and reap it
+                        ::kill(pid, SIGKILL);
+                        ::waitpid(pid, nullptr, 0);
+                    }
+                    if (handler)
+                        handler(ec);
+                });
+        }
+
+        // Listen on sockets handed over by hot_restart of previous
+        // process. Return number of sockets, 0 if process was not
+        // started by hot_restart.
+        size_t listen_handover()
+        {
+            const char* env = std::getenv(handover_env());
+            if (!env)
+                return 0;
+            int sock = std::atoi(env);
+            ::unsetenv(handover_env());
+
+            char data;
+            iovec iov { &data, 1 };
+            // Room for as many descriptors as Linux passes in a message
+            std::vector<char> control(CMSG_SPACE(sizeof(int) * 253));
+            msghdr msg { };
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            msg.msg_control = control.data();
+            msg.msg_controllen = control.size();
+
+            ssize_t received = ::recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+            if (received != 1) {
+                int err = received < 0 ? errno : ECONNRESET;
+                ::close(sock);
+                throw boost::system::system_error(
+                    err, boost::system::system_category(), "recvmsg");
+            }
+
+            std::vector<int> fds;
+            for (cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+                if (c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+                    continue;
+                size_t n = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (size_t i = 0; i < n; ++i) {
+                    int fd;
+                    std::memcpy(&fd, CMSG_DATA(c) + i * sizeof(int), sizeof(int));
+                    fds.push_back(fd);
                 }
             }
 
-            if (!next.safe_invoke([&] {
-                boost::apply_visitor(visitor(req, resp, next), route.handler); }))
-                return;
-            if (next.err()) {
-                handle_error(req, resp, next);
-                return;
+            // Some descriptors were dropped, do not serve only part of
+            // the sockets. Previous process keeps serving them.
+            if (msg.msg_flags & MSG_CTRUNC) {
+                for (int fd : fds)
+                    ::close(fd);
+                ::close(sock);
+                throw boost::system::system_error(
+                    EMSGSIZE, boost::system::system_category(), "recvmsg");
             }
+
+            for (int fd : fds)
+                listen_fd(fd);
+
+            // Previous process stops accepting
+            ::send(sock, &data, 1, MSG_NOSIGNAL);
+            ::close(sock);
+            return fds.size();
         }
-    }
+#endif
+    };
 
 } // namespace rest
 
-// end of rest/router.hpp
+// end of rest/server.hpp
 
-// beginning of rest/server.hpp
+// beginning of rest/static_bundle.hpp
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 namespace rest {
 
-    struct server : router {
+    struct static_bundle_options {
+        // Sends the specified directory index file. Set to empty to
+        // disable directory indexing.
+        boost::string_view index { "index.html" };
+
+        // Value of Cache-Control header, not set if empty
+        std::string cache_control;
+    };
+
+    // Serves files from a bundle made by make_bundle.py. The bundle is
+    // memory-mapped once, requests are served without touching the
+    // filesystem.
+    struct static_bundle {
     private:
-        tcp::acceptor acceptor;
-        tcp::socket socket;
-
-        // Loop forever accepting new connections
-        void accept() {
-            acceptor.async_accept(socket,
-                [this](boost::beast::error_code ec) {
-                    if (!ec)
-                        process_client();
-                    accept();
-                });
+        struct file {
+            boost::string_view data;
+            // Precompressed content, empty if none
+            boost::string_view gzip;
+            boost::string_view type;
+            std::string etag;
+            // Tag of precompressed content, differs from the one of
+            // identity content
+            std::string gzip_etag;
+        };
+
+        struct string_view_hash {
+            size_t operator()(const boost::string_view& s) const noexcept {
+                return boost::hash_range(s.begin(), s.end());
+            }
+        };
+
+        struct impl {
+            boost::interprocess::file_mapping mapping;
+            boost::interprocess::mapped_region region;
+            std::vector<file> files;
+            std::unordered_map<boost::string_view, const file*, string_view_hash> paths;
+            // Index file paths of directories
+            std::vector<std::string> dirs;
+        };
+
+        std::shared_ptr<impl> self;
+        const static_bundle_options opt;
+
+        static uint64_t read(const char* p, size_t n) noexcept {
+            uint64_t v = 0;
+            for (size_t i = n; i-- > 0; )
+                v = v << 8 | static_cast<unsigned char>(p[i]);
+            return v;
         }
 
-        // Receive and process a request
-        void process_client()
+        void load(const fs::path& bundle)
         {
-            auto sock = std::make_shared<tcp::socket>(std::move(socket));
-            request::receive(sock, [this](request& req) {
-                req.app(this);
-                req.path(req.original_url());
+            namespace ipc = boost::interprocess;
+            self->mapping = ipc::file_mapping(bundle.c_str(), ipc::read_only);
+            self->region = ipc::mapped_region(self->mapping, ipc::read_only);
+
+            const char* base = static_cast<const char*>(self->region.get_address());
+            const uint64_t size = self->region.get_size();
+            auto bad = [&] {
+                return std::runtime_error("invalid bundle " + bundle.string());
+            };
 
-                response resp(req);
-                next n;
+            const uint64_t header = 16, entry = 56;
+            if (size < header || std::memcmp(base, "RSTBNDL1", 8) != 0)
+                throw bad();
+            const uint64_t count = read(base + 8, 4);
+            if (count > (size - header) / entry)
+                throw bad();
+
+            auto view = [&](uint64_t offset, uint64_t n) {
+                if (offset > size || n > size - offset)
+                    throw bad();
+                return boost::string_view(base + offset, n);
+            };
 
-                handle_request(req, resp, n);
-            });
+            self->files.reserve(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                const char* e = base + header + i * entry;
+                auto path = view(read(e, 8), read(e + 8, 4));
+                file f;
+                f.data = view(read(e + 16, 8), read(e + 24, 8));
+                f.gzip = view(read(e + 32, 8), read(e + 40, 8));
+                f.type = mime_type::resolve(fs::path(path.begin(), path.end()));
+
+                char etag[22];
+                auto hash = static_cast<unsigned long long>(read(e + 48, 8));
+                std::snprintf(etag, sizeof(etag), "\"%016llx\"", hash);
+                f.etag = etag;
+                std::snprintf(etag, sizeof(etag), "\"%016llx-gz\"", hash);
+                f.gzip_etag = etag;
+
+                self->files.push_back(std::move(f));
+                self->paths.emplace(path, &self->files.back());
+            }
+
+            if (opt.index.empty())
+                return;
+            // Directory paths, with and without trailing slash, serve
+            // their index file
+            std::vector<std::pair<std::string, const file*>> indexes;
+            for (auto& p : self->paths) {
+                auto& name = p.first;
+                if (name.size() <= opt.index.size() ||
+                    !name.ends_with(opt.index) ||
+                    name[name.size() - opt.index.size() - 1] != '/')
+                    continue;
+                auto dir = name.substr(0, name.size() - opt.index.size());
+                indexes.emplace_back(dir.to_string(), p.second);
+                if (dir.size() > 1)
+                    indexes.emplace_back(dir.substr(0, dir.size() - 1).to_string(), p.second);
+            }
+            self->dirs.reserve(indexes.size());
+            for (auto& d : indexes) {
+                self->dirs.push_back(std::move(d.first));
+                self->paths.emplace(self->dirs.back(), d.second);
+            }
         }
 
-    public:
-        server(boost::asio::io_context& ioc) noexcept
-        : acceptor(ioc)
-        , socket(ioc)
-        { }
+        static bool accepts_gzip(const request& req)
+        {
+            auto ae = req.get(http::field::accept_encoding);
+            if (!ae)
+                return false;
+            for (auto& enc : http::ext_list(*ae)) {
+                if (!boost::beast::iequals(enc.first, "gzip"))
+                    continue;
+                for (auto& param : enc.second) {
+                    if (param.first == "q" && (param.second == "0" ||
+                        param.second == "0.0" || param.second == "0.00" ||
+                        param.second == "0.000"))
+                        return false;
+                }
+                return true;
+            }
+            return false;
+        }
 
-        void listen(tcp::endpoint endp) {
-            acceptor.open(endp.protocol());
-            acceptor.set_option(tcp::acceptor::reuse_address(true));
-            acceptor.bind(endp);
-            acceptor.listen();
-            accept();
+        // Check if If-None-Match list has etag, or is "*". Tags are
+        // compared weakly, W/ prefix is ignored.
+        static bool etag_matches(boost::string_view list, boost::string_view etag)
+        {
+            for (;;) {
+                while (!list.empty() && (list.front() == ' ' ||
+                    list.front() == '\t' || list.front() == ','))
+                    list.remove_prefix(1);
+                if (list.empty())
+                    return false;
+                if (list.front() == '*')
+                    return true;
+                if (list.starts_with("W/"))
+                    list.remove_prefix(2);
+                if (list.empty() || list.front() != '"')
+                    return false;
+
+                size_t end = list.find('"', 1);
+                if (end == boost::string_view::npos)
+                    return false;
+                if (list.substr(0, end + 1) == etag)
+                    return true;
+                list.remove_prefix(end + 1);
+            }
         }
 
-        void listen(uint16_t port) {
-            listen(tcp::endpoint(boost::asio::ip::address(), port));
+    public:
+        // Throws if bundle can not be opened or is malformed
+        static_bundle(const fs::path& bundle, static_bundle_options options = { })
+        : self(std::make_shared<impl>())
+        , opt(std::move(options))
+        {
+            load(bundle);
         }
 
-        void listen(uint16_t port, const char* ip) {
-            listen(tcp::endpoint(boost::asio::ip::make_address(ip), port));
+        // Number of files in bundle
+        size_t size() const noexcept {
+            return self->files.size();
+        }
+
+        void operator()(const request& req, response& resp, next& parent_next) const
+        {
+            if (req.method() != http::verb::get)
+                return parent_next();
+
+            auto it = self->paths.find(req.path());
+            if (it == self->paths.end())
+                return parent_next();
+            auto& f = *it->second;
+
+            // Each representation has its own tag
+            bool gzip = !f.gzip.empty() && accepts_gzip(req);
+            auto& etag = gzip ? f.gzip_etag : f.etag;
+
+            resp.set(http::field::etag, etag);
+            if (!f.gzip.empty())
+                resp.set(http::field::vary, "Accept-Encoding");
+            if (!opt.cache_control.empty())
+                resp.set(http::field::cache_control, opt.cache_control);
+
+            auto inm = req.get(http::field::if_none_match);
+            if (inm && etag_matches(*inm, etag)) {
+                resp.status(304).send();
+                return;
+            }
+
+            resp.set(http::field::content_type, f.type);
+            if (gzip) {
+                resp.set(http::field::content_encoding, "gzip");
+                resp.send(shared_buffer(self, { f.gzip.data(), f.gzip.size() }));
+                return;
+            }
+            resp.send(shared_buffer(self, { f.data.data(), f.data.size() }));
         }
     };
 
 } // namespace rest
 
-// end of rest/server.hpp
+// end of rest/static_bundle.hpp
 
 // beginning of rest/static_files.hpp
 
+#include <fstream>
+
 namespace rest {
 
     struct static_files_options {
@@ -795,35 +6254,129 @@ namespace rest {
             [](response& r, const fs::path& f, const fs::file_status&) {
                 r.set(http::field::content_type, mime_type::resolve(f));
             }};
+
+        // Time a request path is resolved to a file (or to no file)
+        // without looking at the filesystem again. 0 disables caching.
+        std::chrono::steady_clock::duration cache_ttl = std::chrono::seconds(1);
+
+        // Maximum number of cached paths
+        size_t cache_size = 4096;
     };
 
     struct static_files {
     private:
+        // Request path resolved to file
+        struct entry {
+            std::string key;
+            // Empty if there is no such file
+            fs::path file;
+            fs::file_status stat;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        using entry_ptr = std::shared_ptr<const entry>;
+
+        struct cache {
+            std::mutex mtx;
+            // Keys refer to entry::key
+            std::unordered_map<boost::string_view, entry_ptr,
+                boost::hash<boost::string_view>> entries;
+        };
+
         const fs::path fpath;
         const static_files_options opt;
+        std::shared_ptr<cache> files;
+
+        entry_ptr resolve(const boost::string_view& rp) const
+        {
+            auto e = std::make_shared<entry>();
+            e->key = rp.to_string();
+            e->expires = std::chrono::steady_clock::now() + opt.cache_ttl;
+
+            auto fname = fpath / fs::path(rp.begin(), rp.end());
+            auto stat = status(fname);
+
+            if (fs::is_directory(stat)) {
+                if (opt.index.empty())
+                    return e;
+                fname.append(opt.index.begin(), opt.index.end());
+                stat = status(fname);
+            }
+            if (fs::exists(stat)) {
+                e->file = std::move(fname);
+                e->stat = stat;
+            }
+            return e;
+        }
+
+        entry_ptr lookup(const boost::string_view& rp) const
+        {
+            if (opt.cache_ttl <= std::chrono::steady_clock::duration::zero())
+                return resolve(rp);
+
+            auto now = std::chrono::steady_clock::now();
+            {
+                std::lock_guard<std::mutex> lock(files->mtx);
+                auto it = files->entries.find(rp);
+                if (it != files->entries.end() && it->second->expires > now)
+                    return it->second;
+            }
+
+            auto e = resolve(rp);
+            std::lock_guard<std::mutex> lock(files->mtx);
+            auto& entries = files->entries;
+            entries.erase(rp);
+            // Start over rather than track age of entries
+            if (entries.size() >= opt.cache_size)
+                entries.clear();
+            entries.emplace(e->key, e);
+            return e;
+        }
+
+        // Drop entry of a file no longer there
+        void forget(const entry_ptr& e) const
+        {
+            std::lock_guard<std::mutex> lock(files->mtx);
+            auto it = files->entries.find(e->key);
+            if (it != files->entries.end() && it->second == e)
+                files->entries.erase(it);
+        }
+
+        // Path must not leave the served directory
+        static bool is_safe(const boost::string_view& rp) noexcept
+        {
+            for (size_t pos = 0; pos < rp.size(); ) {
+                size_t end = rp.find('/', pos);
+                if (end == boost::string_view::npos)
+                    end = rp.size();
+                if (rp.substr(pos, end - pos) == "..")
+                    return false;
+                pos = end + 1;
+            }
+            return true;
+        }
 
     public:
         static_files(fs::path filepath, static_files_options options = { }) noexcept
         : fpath(std::move(filepath))
         , opt(std::move(options))
+        , files(std::make_shared<cache>())
         { }
 
         void operator()(const request& req, response& resp, next& parent_next) const
         {
-            if (req.method() == http::verb::get) {
-                const auto& rp = req.path();
-                auto fname = fpath / fs::path(rp.begin(), rp.end());
-                auto stat = status(fname);
-
-                if (fs::is_directory(stat)) {
-                    fname.append(opt.index.begin(), opt.index.end());
-                    stat = status(fname);
-                }
-
-                if (fs::exists(stat)) {
-                    opt.set_headers(resp, fname, stat);
-                    resp.send_file(fname);
-                    return;
+            if (req.method() == http::verb::get && is_safe(req.path())) {
+                auto e = lookup(req.path());
+                if (!e->file.empty()) {
+                    // Opened before headers are set, the file may be gone
+                    // since it was cached
+                    std::ifstream f(e->file.native(), std::ios::binary);
+                    if (f.is_open()) {
+                        opt.set_headers(resp, e->file, e->stat);
+                        resp.send(f.rdbuf());
+                        return;
+                    }
+                    forget(e);
                 }
             }
             // Call next if method not matched or file not found